@@ -444,6 +444,7 @@ class PrependWords {
 		prependwords.add("EC_GROUP");
 		prependwords.add("PRNG_CTX");
 		prependwords.add("AES_GCM");
+		prependwords.add("AES_CCM");
 		prependwords.add("DSA_SIG");
 		prependwords.add("EC_KEY");
 		prependwords.add("BIGNUM");
@@ -40,6 +40,7 @@ unsigned int fips_loops();
 #endif
 
 #include "TRNG/entropy_to_NRBGi.h"
+#include "TRNG/TRNG_ALT.h"
 /* Wrong prototype but it should cope with NULL,NULL inputs */
 extern void iccDoKnownAnswer(void *iccLib, void *icc_stat);
 extern void SetFatalError(const char *msg, const char *file, int line);
@@ -56,6 +57,8 @@ extern int FIPS_mode(); /* In OpenSSL, gets set by ICC during startup */
 static const unsigned int E_GuarTo_Ein[9] = {100,100,50,50,25,25,25,25,25};
 static const char * TRNG_IMPLtag = "TRNG_IMPL";
 static const char * TRNG_CONDtag = "TRNG_COND";
+/*! Conditioner new TRNG's use, TRNG_COND_HMAC or TRNG_COND_SHA256 */
+static int cond_mode = TRNG_COND_HMAC;
 static const char * TRNGtag = "TRNG_t";
 static const char * TRNG_ESRCtag = "E_SOURCE";
 
@@ -263,6 +266,21 @@ void checkTRNGAlias(char **trngname) {
 */
 
 extern unsigned icc_failure; /*!< Trigger for induced failure tests */
+int SetTRNGConditioner(const char *name)
+{
+  int rv = 0;
+  if (NULL != name) {
+    if (0 == strcasecmp(name, "HMAC")) {
+      cond_mode = TRNG_COND_HMAC;
+      rv = 1;
+    } else if (0 == strcasecmp(name, "SHA256")) {
+      cond_mode = TRNG_COND_SHA256;
+      rv = 1;
+    }
+  }
+  return rv;
+}
+
 int SetTRNGName(char *trngname)
 {
   if (NULL != trngname) {
@@ -335,8 +353,24 @@ static TRNG_ERRORS TRNG_CondInit(TRNG_COND *c,const EVP_MD *md)
       HMAC_Update(c->hctx, c->rdata, sizeof(c->rdata));
       HMAC_Final(c->hctx, c->key, &mlen);
       HMAC_CTX_reset(c->hctx);
-      c->id = TRNG_CONDtag;
-      rv = TRNG_OK;
+      /* The key is fixed from here on. Key the context once and keep it
+         keyed, each conditioning block restarts from the keyed state
+         with HMAC_Init_ex(hctx,NULL,0,NULL,NULL) rather than redoing
+         the key setup.
+      */
+      if (1 == HMAC_Init_ex(c->hctx, c->key, sizeof(c->key), md, NULL)) {
+        c->id = TRNG_CONDtag;
+        rv = TRNG_OK;
+      }
+    }
+    c->mode = cond_mode;
+    if ((TRNG_OK == rv) && (TRNG_COND_SHA256 == c->mode)) {
+      if (NULL == c->mctx) {
+        c->mctx = EVP_MD_CTX_new();
+      }
+      if (NULL == c->mctx) {
+        rv = TRNG_INIT;
+      }
     }
   }
   return rv;
@@ -350,6 +384,10 @@ static void TRNG_CondCleanup(TRNG_COND *c)
       c->hctx = NULL;
       c->id = NULL;
     }
+    if (NULL != c->mctx) {
+      EVP_MD_CTX_free(c->mctx);
+      c->mctx = NULL;
+    }
   }
 }
 /* 
@@ -636,6 +674,21 @@ void TRNG_free(TRNG *T) {
   }
 }
 
+int TRNG_Size(TRNG *T) {
+  int rv = 0;
+  if (NULL != T) {
+    /* The estimator state proper is inside the TRNG */
+    rv = (int)sizeof(TRNG) + EntropyEstimatorSize(T) - (int)sizeof(E_MEASURE);
+    if (NULL != T->econd.abuf) {
+      rv += ALT_BUFLEN;
+    }
+    if (NULL != T->econd.psub) {
+      rv += T->econd.pn * ((int)sizeof(E_SOURCE) + E_ESTB_BUFLEN);
+    }
+  }
+  return rv;
+}
+
 /*!
  @brief
   This is the code path ICC uses INTERNALLY for seeds, i.e. ones
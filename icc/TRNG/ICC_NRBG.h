@@ -34,6 +34,13 @@ TRNG_TYPE GetDefaultTrng(void);
 
 TRNG_TYPE SetDefaultTrng(TRNG_TYPE trng);
 
+/*!
+  @brief Select the conditioning function for TRNG's created from now on
+  @param name "HMAC" (the default) or "SHA256", case insensitive
+  @return 1 if name was recognized, 0 otherwise
+*/
+int SetTRNGConditioner(const char *name);
+
 /*!
   @brief Return the name of the TRNG given the TRNG_TYPE
   @param trng TRNG enum
@@ -99,6 +106,14 @@ TRNG_ERRORS TRNG_TRNG_Init(TRNG *T,TRNG_TYPE type);
 */
 void TRNG_free(TRNG *T);
 
+/*!
+  @brief
+  Memory held by a TRNG context
+  @param T the context, may be NULL
+  @return bytes, the context, entropy estimator and source buffers
+*/
+int TRNG_Size(TRNG *T);
+
 /*!
   @brief return the type of a TRNG 
   @return the TRNG type
@@ -69,6 +69,7 @@ SP800_90STATE TRNG_Inst_Type(PRNG_CTX *ctx,
     tctx->trng = NULL;
   }
   tctx->trng = TRNG_new(type);
+  tctx->shared = 0; /* Test taps always drive their own TRNG */
   if((NULL ==  tctx->trng) ) {
     tctx->state = SP800_90CRIT;
     tctx->error_reason = ERRAT(SP800_90_NOT_INIT);
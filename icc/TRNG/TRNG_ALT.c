@@ -29,6 +29,7 @@
 #undef WIN32_NO_STATUS
 #endif
 
+#include "platform_api.h"
 #include "TRNG/nist_algs.h"
 #include "TRNG/TRNG_ALT.h"
 #include "induced.h"
@@ -37,9 +38,36 @@
 #include <bcrypt.h>
 #include "ntstatus.h"
 #endif
+#if defined(__linux__)
+#include <errno.h>
+#include <sys/syscall.h>
+#if defined(SYS_getrandom)
+/* getrandom() exists from Linux 3.17, use the syscall directly as older
+   glibc's don't have the wrapper. No fd is needed so this also works
+   in chroot and seccomp sandboxes that lack /dev/urandom
+*/
+#define ALT_GETRANDOM
+/* From linux/random.h, which older distributions don't ship */
+#if !defined(GRND_NONBLOCK)
+#define GRND_NONBLOCK 0x0001
+#endif
+#endif
+#endif
 
-
+/*
+  fd_alt
+  -1 no source
+  -3 Windows BCryptGenRandom()
+  -4 Linux getrandom()
+  >= 0 fd for /dev/(u)random
+*/
 static int fd_alt = -1;
+#if defined(ALT_GETRANDOM)
+/* /dev/urandom, used when getrandom() would block (early boot,
+   before the kernel CRNG is seeded) or is no longer permitted
+*/
+static int fd_urandom = -1;
+#endif
 #if defined(_WIN32)
 static BCRYPT_ALG_HANDLE hProvider = NULL;
 #endif
@@ -72,6 +100,79 @@ int ALT_Avail()
   return (fd_alt != -1);
 }
 
+#if !defined(_WIN32)
+/*! @brief
+  Read from a /dev/(u)random fd
+  @param fd the fd
+  @param buffer the buffer to fill
+  @param n the number of bytes to read
+  @return TRNG_OK or TRNG_REQ_SIZE on error
+*/
+static TRNG_ERRORS alt_readfd(int fd,unsigned char *buffer,int n)
+{
+  TRNG_ERRORS rv = TRNG_OK;
+  int i = 0,k = n;
+
+  /* Some OS's limit the size of reads from /dev/(u)random ==> HPUX */
+  while(k > 0) {
+    i = read(fd,buffer,k);
+    k -= i;
+    if((i > 0) && (k != 0) ) {
+      buffer += i;
+      continue;
+    } else {
+      rv = TRNG_REQ_SIZE;
+      break;
+    }
+  }
+  return rv;
+}
+#endif
+
+#if defined(ALT_GETRANDOM)
+/*! @brief
+  Read from getrandom(), retrying on interrupted or partial reads
+  @param buffer the buffer to fill
+  @param n the number of bytes to read
+  @return TRNG_OK or TRNG_REQ_SIZE on error
+  @note GRND_NONBLOCK, so early in boot we don't stall the caller
+  until the kernel CRNG is seeded. /dev/urandom serves the request
+  then (EAGAIN) and if the syscall is later filtered (ENOSYS),
+  as it did before getrandom() was used. Only if /dev/urandom
+  couldn't be opened do we wait for the CRNG.
+*/
+static TRNG_ERRORS alt_getrandom(unsigned char *buffer,int n)
+{
+  TRNG_ERRORS rv = TRNG_OK;
+  long i = 0;
+  int flags = GRND_NONBLOCK;
+
+  while(n > 0) {
+    i = syscall(SYS_getrandom,buffer,(size_t)n,flags);
+    if(i > 0) {
+      buffer += i;
+      n -= (int)i;
+    } else if((i < 0) && (EINTR == errno)) {
+      continue;
+    } else if((i < 0) && ((EAGAIN == errno) || (ENOSYS == errno))) {
+      if(-1 != fd_urandom) {
+        rv = alt_readfd(fd_urandom,buffer,n);
+        break;
+      } else if((EAGAIN == errno) && (0 != flags)) {
+        flags = 0;
+        continue;
+      }
+      rv = TRNG_REQ_SIZE;
+      break;
+    } else {
+      rv = TRNG_REQ_SIZE;
+      break;
+    }
+  }
+  return rv;
+}
+#endif
+
 
 /*! @brief
   Fill our I/O buffer 
@@ -81,9 +182,6 @@ int ALT_Avail()
 static int alt_read(unsigned char *buffer,int n)
 {
   TRNG_ERRORS rv = TRNG_OK;
-#if !defined(_WIN32)
-  int i = 0,k = n;
-#endif
 
   memset(buffer,0,n); /* If all else fails, return 0's */
   switch(fd_alt) {
@@ -98,22 +196,16 @@ static int alt_read(unsigned char *buffer,int n)
       rv = TRNG_REQ_SIZE; /* One of the parameters was likely not correct, or bad provider */
     }
     }
+#endif
+    break;
+  case -4:
+#if defined(ALT_GETRANDOM)
+    rv = alt_getrandom(buffer,n);
 #endif
     break;
   default:
 #if !defined(_WIN32)
-  /* Some OS's limit the size of reads from /dev/(u)random ==> HPUX */
-   while(k > 0) {
-    i = read(fd_alt,buffer,k);
-    k -= i;
-    if((i > 0) && (k != 0) ) {
-      buffer += i;
-      continue;
-    } else {
-      rv = TRNG_REQ_SIZE;
-      break;
-    }
-  }
+    rv = alt_readfd(fd_alt,buffer,n);
 #endif
     break;
   }
@@ -142,12 +234,43 @@ TRNG_ERRORS ALT_Init(E_SOURCE *E, unsigned char *pers, int perl)
     }
 #else
     /* On Unix .... */
-    fd_alt = open("/dev/urandom",O_RDONLY);
-    if(-1 == fd_alt) {
-      fd_alt = open("/dev/random",O_RDONLY);
+#if defined(ALT_GETRANDOM)
+    /* Probe with a small read, ENOSYS on pre 3.17 kernels or where
+       the sandbox filters it, then we fall back to /dev/urandom.
+       EAGAIN means it's there but the CRNG isn't seeded yet, keep
+       /dev/urandom open for those requests
+    */
+    {
+      unsigned char probe[16];
+      long i = syscall(SYS_getrandom,probe,sizeof(probe),GRND_NONBLOCK);
+      if((sizeof(probe) == i) || ((i < 0) && (EAGAIN == errno))) {
+        fd_alt = -4;
+        if(-1 == fd_urandom) {
+          fd_urandom = open("/dev/urandom",O_RDONLY);
+        }
+      }
+      memset(probe,0,sizeof(probe));
+    }
+    if(-1 == fd_alt)
+#endif
+    {
+      fd_alt = open("/dev/urandom",O_RDONLY);
+      if(-1 == fd_alt) {
+        fd_alt = open("/dev/random",O_RDONLY);
+      }
     }
 #endif
   }
+#if defined(ALT_GETRANDOM)
+  /* Per source buffer so we make one syscall per ALT_BUFLEN bytes
+     rather than one per request
+  */
+  if((NULL != E) && (-4 == fd_alt) && (NULL == E->abuf)) {
+    E->abuf = (unsigned char *)ICC_Calloc(1,ALT_BUFLEN,__FILE__,__LINE__);
+    E->acnt = 0;
+    E->apid = ICC_GetProcessId();
+  }
+#endif
   /* If there's no /dev/ source, we'll return an error */
   if(-1 == fd_alt) {
     rv = TRNG_INIT;
@@ -174,16 +297,46 @@ TRNG_ERRORS ALT_Init(E_SOURCE *E, unsigned char *pers, int perl)
  @param len size of buffer
  @return status 
  @note
- - we do know reading one byte at a time is inefficient, but it gives 
- us more variation in the timebase counter we mix in for extra security.
+ - with getrandom() requests are served from a per source buffer
+   refilled ALT_BUFLEN bytes at a time, bytes are scrubbed as they are used.
  - if the external source is unavailable, we return 0's, this is detected
    at a higher level
 */
 TRNG_ERRORS ALT_getbytes(E_SOURCE *E,unsigned char *buffer, int len)
 {
   TRNG_ERRORS rv = TRNG_OK;
-
-  rv = alt_read(buffer,len); /* Read from the primary source */
+  unsigned char *p = buffer;
+  int n = len;
+  int k = 0;
+
+  if((NULL != E) && (NULL != E->abuf) && (len <= ALT_BUFLEN)) {
+    /* A fork()ed child has a copy of it's parent's buffer, never
+       hand out the same bytes in both processes
+    */
+    if(E->apid != (unsigned long)ICC_GetProcessId()) {
+      memset(E->abuf,0,ALT_BUFLEN);
+      E->acnt = 0;
+      E->apid = ICC_GetProcessId();
+    }
+    while((TRNG_OK == rv) && (n > 0)) {
+      if(0 == E->acnt) {
+        rv = alt_read(E->abuf,ALT_BUFLEN);
+        E->acnt = (TRNG_OK == rv) ? ALT_BUFLEN : 0;
+      }
+      /* Take from the end and scrub what we used */
+      k = (n < E->acnt) ? n : E->acnt;
+      E->acnt -= k;
+      memcpy(p,E->abuf + E->acnt,k);
+      memset(E->abuf + E->acnt,0,k);
+      p += k;
+      n -= k;
+    }
+    if(TRNG_OK != rv) {
+      memset(buffer,0,len);
+    }
+  } else {
+    rv = alt_read(buffer,len); /* Read from the primary source */
+  }
 
   /*! \induced 221. TRNG_ALT. Fake the failure condition 
 	  from the OS RNG source
@@ -206,6 +359,13 @@ TRNG_ERRORS ALT_Cleanup(E_SOURCE *E)
 
   TRNG_ERRORS rv = TRNG_OK;
 
+  if((NULL != E) && (NULL != E->abuf)) {
+    memset(E->abuf,0,ALT_BUFLEN);
+    ICC_Free(E->abuf);
+    E->abuf = NULL;
+    E->acnt = 0;
+  }
+
   return rv;
 }
 
@@ -222,5 +382,11 @@ void ALT_Final()
     close(fd_alt);
     fd_alt = -1;
   }
+#if defined(ALT_GETRANDOM)
+  if(fd_urandom >= 0) {
+    close(fd_urandom);
+    fd_urandom = -1;
+  }
+#endif
 #endif
 }
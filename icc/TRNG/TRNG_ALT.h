@@ -16,6 +16,8 @@
 
 #include "noise_to_entropy.h"
 
+/*! Bytes fetched from getrandom() per syscall, held per E_SOURCE */
+#define ALT_BUFLEN 4096
 
 
 void ALT_preinit(int reinit);
@@ -14,12 +14,334 @@
 *************************************************************************/
 
 #include "platform.h"
+#include "platform_api.h"
 #include "TRNG/TRNG_FIPS.h"
 #include "TRNG/timer_entropy.h"
 #include "induced.h"
 
 int getbytes(unsigned char *buffer,int n);
 
+extern int shift_done; /* Have we run CalcShift() */
+
+/*
+  Parallel sampling.
+  With samplers > 1 each TRNG_FIPS source owns (samplers - 1) extra
+  sub-sources, each with it's own filter state and health tests. When
+  we need a block all of them collect one at once on their own threads
+  and the spare blocks are queued for the following requests.
+  - Each stream is independently filtered and health tested exactly as
+    the single sampler case, blocks are never mixed before that.
+  - Blocks are handed out once and scrubbed, a fork()ed child discards
+    any it inherited.
+  - The sampler threads are started on first use and then wait for the
+    next collection, they are stopped when the source is cleaned up.
+    A fork()ed child starts it's own.
+  - The tuned loop count in timer_fips.c belongs to the calling thread's
+    sampler, the others tune privately (T_FILTER sub) starting from
+    where that one was.
+*/
+static int fips_samplers = 1;
+
+int SetTRNGSamplers(int n)
+{
+  int rv = 0;
+  if((n >= 1) && (n <= TRNG_SAMPLERS_MAX)) {
+    fips_samplers = n;
+    rv = 1;
+  }
+  return rv;
+}
+
+int GetTRNGSamplers(void)
+{
+  return fips_samplers;
+}
+
+struct FIPS_WORKERS_t;
+
+typedef struct {
+  E_SOURCE *E;
+  unsigned char *out;
+  int ok;
+  int idx;
+  struct FIPS_WORKERS_t *w;
+} FIPS_JOB;
+
+/*! @brief the sampler threads of one TRNG_FIPS source */
+typedef struct FIPS_WORKERS_t {
+  FIPS_JOB job[TRNG_SAMPLERS_MAX];
+  int n;                             /*!< Threads running */
+  int stop;                          /*!< Set to stop the threads */
+#if defined(_WIN32)
+  HANDLE tid[TRNG_SAMPLERS_MAX];
+  HANDLE go[TRNG_SAMPLERS_MAX];      /*!< Start a collection */
+  HANDLE done[TRNG_SAMPLERS_MAX];    /*!< Collection finished */
+#else
+  pthread_t tid[TRNG_SAMPLERS_MAX];
+  pthread_mutex_t mtx;
+  pthread_cond_t go_cv;
+  pthread_cond_t done_cv;
+  unsigned int round;                /*!< Bumped to start a collection */
+  int pending;                       /*!< Threads still collecting */
+#endif
+} FIPS_WORKERS;
+
+#if defined(_WIN32)
+static DWORD WINAPI fips_worker(LPVOID arg)
+{
+  FIPS_JOB *job = (FIPS_JOB *)arg;
+  FIPS_WORKERS *w = job->w;
+
+  while((WAIT_OBJECT_0 == WaitForSingleObject(w->go[job->idx],INFINITE)) &&
+        !w->stop) {
+    job->ok = (E_ESTB_BUFLEN == FIPS_getbytes(job->E,job->out,E_ESTB_BUFLEN));
+    SetEvent(w->done[job->idx]);
+  }
+  return 0;
+}
+#else
+static void *fips_worker(void *arg)
+{
+  FIPS_JOB *job = (FIPS_JOB *)arg;
+  FIPS_WORKERS *w = job->w;
+  unsigned int seen = 0;
+
+  pthread_mutex_lock(&w->mtx);
+  for(;;) {
+    while(!w->stop && (seen == w->round)) {
+      pthread_cond_wait(&w->go_cv,&w->mtx);
+    }
+    if(w->stop) {
+      break;
+    }
+    seen = w->round;
+    pthread_mutex_unlock(&w->mtx);
+    job->ok = (E_ESTB_BUFLEN == FIPS_getbytes(job->E,job->out,E_ESTB_BUFLEN));
+    pthread_mutex_lock(&w->mtx);
+    if(0 == --w->pending) {
+      pthread_cond_signal(&w->done_cv);
+    }
+  }
+  pthread_mutex_unlock(&w->mtx);
+  return NULL;
+}
+#endif
+
+/*!
+  @brief start a thread for each extra sampler
+  @param E the parent source
+  @return the thread set or NULL, in which case the calling
+          thread's sampler is the only one used
+*/
+static FIPS_WORKERS *fips_workers_start(E_SOURCE *E)
+{
+  FIPS_WORKERS *w = NULL;
+  int i;
+
+  w = (FIPS_WORKERS *)ICC_Calloc(1,sizeof(FIPS_WORKERS),__FILE__,__LINE__);
+  if(NULL == w) {
+    return NULL;
+  }
+  for(i = 0; i < E->pn; i++) {
+    w->job[i].E = &(E->psub[i]);
+    w->job[i].out = E->pbuf + i * E_ESTB_BUFLEN;
+    w->job[i].idx = i;
+    w->job[i].w = w;
+  }
+#if defined(_WIN32)
+  for(i = 0; i < E->pn; i++) {
+    w->go[i] = CreateEvent(NULL,FALSE,FALSE,NULL);
+    w->done[i] = CreateEvent(NULL,FALSE,FALSE,NULL);
+    if((NULL != w->go[i]) && (NULL != w->done[i])) {
+      w->tid[i] = CreateThread(NULL,0,fips_worker,&(w->job[i]),0,NULL);
+    }
+    if(NULL == w->tid[i]) {
+      if(NULL != w->go[i]) {
+        CloseHandle(w->go[i]);
+      }
+      if(NULL != w->done[i]) {
+        CloseHandle(w->done[i]);
+      }
+      break;
+    }
+    w->n++;
+  }
+#else
+  pthread_mutex_init(&w->mtx,NULL);
+  pthread_cond_init(&w->go_cv,NULL);
+  pthread_cond_init(&w->done_cv,NULL);
+  for(i = 0; i < E->pn; i++) {
+    if(0 != pthread_create(&(w->tid[i]),NULL,fips_worker,&(w->job[i]))) {
+      break;
+    }
+    w->n++;
+  }
+#endif
+  return w;
+}
+
+/*!
+  @brief stop and release the sampler threads
+  @param E the parent source
+  @param owner 0 in a fork()ed child where the threads don't exist,
+         their bookkeeping is simply dropped
+*/
+static void fips_workers_stop(E_SOURCE *E,int owner)
+{
+  FIPS_WORKERS *w = E->pw;
+  int i;
+
+  if(NULL == w) {
+    return;
+  }
+  if(owner) {
+#if defined(_WIN32)
+    w->stop = 1;
+    for(i = 0; i < w->n; i++) {
+      SetEvent(w->go[i]);
+    }
+    for(i = 0; i < w->n; i++) {
+      WaitForSingleObject(w->tid[i],INFINITE);
+      CloseHandle(w->tid[i]);
+      CloseHandle(w->go[i]);
+      CloseHandle(w->done[i]);
+    }
+#else
+    pthread_mutex_lock(&w->mtx);
+    w->stop = 1;
+    pthread_cond_broadcast(&w->go_cv);
+    pthread_mutex_unlock(&w->mtx);
+    for(i = 0; i < w->n; i++) {
+      pthread_join(w->tid[i],NULL);
+    }
+    pthread_cond_destroy(&w->done_cv);
+    pthread_cond_destroy(&w->go_cv);
+    pthread_mutex_destroy(&w->mtx);
+#endif
+  }
+  memset(w,0,sizeof(FIPS_WORKERS));
+  ICC_Free(w);
+  E->pw = NULL;
+}
+
+/*!
+  @brief release the parallel samplers, scrubbing everything
+  @param E the parent source
+*/
+static void fips_sub_free(E_SOURCE *E)
+{
+  int i;
+  fips_workers_stop(E,(E->ppid == (unsigned long)ICC_GetProcessId()));
+  if(NULL != E->psub) {
+    for(i = 0; i < E->pn; i++) {
+      T_FILTER_Init(&(E->psub[i].tf));
+    }
+    memset(E->psub,0,E->pn * sizeof(E_SOURCE));
+    ICC_Free(E->psub);
+    E->psub = NULL;
+  }
+  if(NULL != E->pbuf) {
+    memset(E->pbuf,0,E->pn * E_ESTB_BUFLEN);
+    ICC_Free(E->pbuf);
+    E->pbuf = NULL;
+  }
+  E->pn = 0;
+  E->pcnt = 0;
+}
+
+/*!
+  @brief get one health tested block, from the queue or by running
+  all the samplers at once
+  @param E the parent source
+  @param ibuf E_ESTB_BUFLEN buffer for the data
+  @return 1 on sucess, 0 on failure
+*/
+static int fips_block(E_SOURCE *E,unsigned char *ibuf)
+{
+  FIPS_WORKERS *w = NULL;
+  int ok = 0;
+  int n = 0;
+  int i,j;
+
+  if(0 == E->pn) {
+    return (E_ESTB_BUFLEN == FIPS_getbytes(E,ibuf,E_ESTB_BUFLEN));
+  }
+  /* Blocks queued before a fork() belong to the parent, as do the threads */
+  if(E->ppid != (unsigned long)ICC_GetProcessId()) {
+    memset(E->pbuf,0,E->pn * E_ESTB_BUFLEN);
+    E->pcnt = 0;
+    fips_workers_stop(E,0);
+    E->ppid = (unsigned long)ICC_GetProcessId();
+  }
+  if(E->pcnt > 0) {
+    E->pcnt--;
+    memcpy(ibuf,E->pbuf + E->pcnt * E_ESTB_BUFLEN,E_ESTB_BUFLEN);
+    memset(E->pbuf + E->pcnt * E_ESTB_BUFLEN,0,E_ESTB_BUFLEN);
+    return 1;
+  }
+  /* CalcShift() sets globals the samplers share, do it once up front */
+  if(!shift_done) {
+    CalcShift(0);
+    shift_done = 1;
+  }
+  if(NULL == E->pw) {
+    E->pw = fips_workers_start(E);
+  }
+  w = E->pw;
+  if(NULL != w) {
+    n = w->n;
+    for(i = 0; i < n; i++) {
+      w->job[i].ok = 0;
+      /* Untuned samplers start where this thread's one is */
+      if(!E->psub[i].tf.done) {
+        E->psub[i].tf.lindex = E->tf.lindex;
+      }
+    }
+#if defined(_WIN32)
+    for(i = 0; i < n; i++) {
+      SetEvent(w->go[i]);
+    }
+#else
+    pthread_mutex_lock(&w->mtx);
+    w->pending = n;
+    w->round++;
+    pthread_cond_broadcast(&w->go_cv);
+    pthread_mutex_unlock(&w->mtx);
+#endif
+  }
+  /* This thread is a sampler too */
+  ok = (E_ESTB_BUFLEN == FIPS_getbytes(E,ibuf,E_ESTB_BUFLEN));
+  if(n > 0) {
+#if defined(_WIN32)
+    WaitForMultipleObjects(n,w->done,TRUE,INFINITE);
+#else
+    pthread_mutex_lock(&w->mtx);
+    while(w->pending > 0) {
+      pthread_cond_wait(&w->done_cv,&w->mtx);
+    }
+    pthread_mutex_unlock(&w->mtx);
+#endif
+  }
+  for(i = 0; i < n; i++) {
+    E->htretry += E->psub[i].htretry;
+    E->psub[i].htretry = 0;
+  }
+  /* Queue the good ones, failed samplers just contribute nothing */
+  for(i = j = 0; i < n; i++) {
+    if(w->job[i].ok) {
+      if(i != j) {
+        memcpy(E->pbuf + j * E_ESTB_BUFLEN,w->job[i].out,E_ESTB_BUFLEN);
+        memset(w->job[i].out,0,E_ESTB_BUFLEN);
+      }
+      j++;
+    } else {
+      memset(w->job[i].out,0,E_ESTB_BUFLEN);
+    }
+  }
+  E->pcnt = j;
+  return ok;
+}
+
 int TRNG_FIPS_Avail()
 {
   return 1;
@@ -42,8 +364,31 @@ void TRNG_FIPS_preinit(int reinit)
 TRNG_ERRORS TRNG_FIPS_Init(E_SOURCE *E, unsigned char *pers, int perl)
 {
   TRNG_ERRORS rv = TRNG_OK;
+  int i;
   T_FILTER_Init(&(E->tf));
 
+  E->psub = NULL;
+  E->pbuf = NULL;
+  E->pn = 0;
+  E->pcnt = 0;
+  E->pw = NULL;
+  if(fips_samplers > 1) {
+    E->psub = (E_SOURCE *)ICC_Calloc(fips_samplers - 1,sizeof(E_SOURCE),__FILE__,__LINE__);
+    E->pbuf = (unsigned char *)ICC_Calloc(fips_samplers - 1,E_ESTB_BUFLEN,__FILE__,__LINE__);
+    E->pn = fips_samplers - 1;
+    if((NULL == E->psub) || (NULL == E->pbuf)) {
+      /* Not fatal, we just collect serially */
+      fips_sub_free(E);
+    } else {
+      for(i = 0; i < E->pn; i++) {
+        memcpy(&(E->psub[i].impl),&(E->impl),sizeof(E->impl));
+        ht_Init(&(E->psub[i].hti),E->hti.H);
+        T_FILTER_Init(&(E->psub[i].tf));
+        E->psub[i].tf.sub = 1;
+      }
+      E->ppid = (unsigned long)ICC_GetProcessId();
+    }
+  }
   return rv;
 }
 
@@ -57,6 +402,7 @@ TRNG_ERRORS TRNG_FIPS_Init(E_SOURCE *E, unsigned char *pers, int perl)
   makes sure it has a large enough buffer and:
   Either fills and discards excess if the request is smaller than the local buffer
   Or repeatedly calls FIPS_getbytes until the request is fullfilled
+  With parallel samplers the blocks may come from any of them
 */
 TRNG_ERRORS TRNG_FIPS_getbytes(E_SOURCE *E,unsigned char *buffer,int len)
 {
@@ -65,7 +411,7 @@ TRNG_ERRORS TRNG_FIPS_getbytes(E_SOURCE *E,unsigned char *buffer,int len)
   unsigned char ibuf[E_ESTB_BUFLEN];
   if(NULL != E) {
     while(len > 0) {
-     if(E_ESTB_BUFLEN != FIPS_getbytes(E,ibuf,E_ESTB_BUFLEN)) {
+     if(!fips_block(E,ibuf)) {
         rv = TRNG_REQ_SIZE;
         break;
       }       
@@ -92,6 +438,7 @@ TRNG_ERRORS TRNG_FIPS_Cleanup(E_SOURCE *E)
 {
   if(NULL != E ) {
     T_FILTER_Init(&(E->tf));
+    fips_sub_free(E);
   }
    return TRNG_OK;
 }
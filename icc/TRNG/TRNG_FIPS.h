@@ -25,5 +25,22 @@ TRNG_ERRORS TRNG_FIPS_Init(E_SOURCE *E, unsigned char *pers, int perl);
 TRNG_ERRORS TRNG_FIPS_getbytes(E_SOURCE *E,unsigned char *buf,int len);
 TRNG_ERRORS TRNG_FIPS_Cleanup(E_SOURCE *E);
 
+/*! @brief Most noise samplers per TRNG_FIPS source */
+#define TRNG_SAMPLERS_MAX 16
+
+/*!
+  @brief set the number of threads collecting noise for each TRNG_FIPS
+  source, 1 (the default) is serial collection
+  @param n the number of samplers 1-TRNG_SAMPLERS_MAX
+  @return 1 on sucess, 0 otherwise
+  @note applies to TRNG_FIPS sources created after the call
+*/
+int SetTRNGSamplers(int n);
+
+/*!
+  @brief return the number of noise samplers per TRNG_FIPS source
+*/
+int GetTRNGSamplers(void);
+
 
 #endif
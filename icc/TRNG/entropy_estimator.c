@@ -21,16 +21,23 @@
 #include "induced.h"
 static const char * TRNG_E_MEASUREtag = "E_MEASURE";
 
+/*! Estimator new TRNG instances use */
+static int est_mode = TRNG_EST_DEFLATE;
+
 /*!
   @brief zlib compatable calloc wrapper 
-  @param opaque - apparently just that
+  @param opaque the E_MEASURE the stream belongs to
   @param items number of blocks
   @param size size of each block
   @return Z_NULL or a valid pointer  
 */
 static void *izcalloc(void *opaque,unsigned items, unsigned size)
 {
-  return ICC_Calloc(items,size,__FILE__,__LINE__);
+  void *ptr = ICC_Calloc(items,size,__FILE__,__LINE__);
+  if((NULL != ptr) && (NULL != opaque)) {
+    ((E_MEASURE *)opaque)->zmem += (int)(items * size);
+  }
+  return ptr;
 }
 
 static void izfree(void *opaque,void *ptr)
@@ -38,6 +45,145 @@ static void izfree(void *opaque,void *ptr)
   ICC_Free(ptr);
 }
 
+int SetEntropyEstimator(const char *name)
+{
+  int rv = 0;
+  if(NULL != name) {
+    if(0 == strcasecmp(name,"DEFLATE")) {
+      est_mode = TRNG_EST_DEFLATE;
+      rv = 1;
+    } else if(0 == strcasecmp(name,"MCV")) {
+      est_mode = TRNG_EST_MCV;
+      rv = 1;
+    }
+  }
+  return rv;
+}
+
+int GetEntropyEstimator(void)
+{
+  return est_mode;
+}
+
+int EntropyEstimatorSize(TRNG *T)
+{
+  int rv = 0;
+  if(NULL != T) {
+    rv = (int)sizeof(E_MEASURE);
+    if(TRNG_EST_DEFLATE == T->e.mode) {
+      rv += EST_OUTLEN + T->e.zmem;
+    }
+  }
+  return rv;
+}
+
+/*!
+  @brief log2(x) in 8 bit fixed point
+  @param x value, > 0
+  @return log2(x) * 256
+*/
+static int log2q8(ICC_UINT64 x)
+{
+  int r = 0;
+  int i;
+  ICC_UINT64 m = x;
+
+  while(m >= 2) {
+    m >>= 1;
+    r++;
+  }
+  /* Normalize to 1.30 fixed point, then square to get the fraction bits */
+  m = (r > 30) ? (x >> (r - 30)) : (x << (30 - r));
+  r <<= 8;
+  for(i = 7; i >= 0; i--) {
+    m = (m * m) >> 30;
+    if(m >= ((ICC_UINT64)2 << 30)) {
+      m >>= 1;
+      r |= (1 << i);
+    }
+  }
+  return r;
+}
+
+/*!
+  @brief Most common value estimate over the MCV window, SP800-90B 6.3.1
+  @param e the estimator state, the window must be full
+  @return min-entropy as a % of the 4 bit sample size, 0-100
+  @note the upper 99% confidence bound on the most common value count
+  ku = k + 2.576 * sqrt(k * (L - k) / (L - 1)) 
+  min-entropy = log2(L / ku) bits per sample.
+  All integer, counts are scaled by 1000.
+*/
+static int mcv_estimate(E_MEASURE *e)
+{
+  const ICC_UINT64 L = EST_WIN * 2;
+  ICC_UINT64 k = 0;
+  ICC_UINT64 v = 0;
+  ICC_UINT64 z = 0;
+  ICC_UINT64 b = 0;
+  int h = 0;
+  int i;
+
+  for(i = 0; i < 16; i++) {
+    if(e->cnt[i] > k) {
+      k = e->cnt[i];
+    }
+  }
+  /* z = isqrt(2576^2 * k * (L - k) / (L - 1)) */
+  v = (k * (L - k) * 6635776) / (L - 1);
+  for(b = (ICC_UINT64)1 << 62; b > v; b >>= 2);
+  for( ; b != 0; b >>= 2) {
+    if(v >= (z + b)) {
+      v -= z + b;
+      z = (z >> 1) + b;
+    } else {
+      z >>= 1;
+    }
+  }
+  k = (k * 1000) + z;
+  if(k > (L * 1000)) {
+    k = L * 1000;
+  }
+  h = log2q8(L * 1000) - log2q8(k);
+  /* bits/sample * 256 -> % of 4 bits */
+  return (h * 25) / 256;
+}
+
+/*!
+  @brief streaming most common value estimator
+  @param e the estimator state
+  @param data the input data
+  @param n the number of input bytes
+  @note constant work per byte, the counts track a sliding window
+  of the last EST_WIN bytes (2 * EST_WIN 4 bit samples). The estimate
+  is refreshed after every call once the window has filled.
+*/
+static void mcv_update(E_MEASURE *e,const unsigned char *data,int n)
+{
+  int i;
+  unsigned char c;
+
+  for(i = 0; i < n; i++) {
+    if(e->wfill < EST_WIN) {
+      e->wfill++;
+    } else {
+      c = e->win[e->wpos];
+      e->cnt[c & 0x0f]--;
+      e->cnt[c >> 4]--;
+    }
+    c = data[i];
+    e->win[e->wpos] = c;
+    e->cnt[c & 0x0f]++;
+    e->cnt[c >> 4]++;
+    if(++e->wpos >= EST_WIN) {
+      e->wpos = 0;
+    }
+  }
+  if(EST_WIN == e->wfill) {
+    e->EntropyEstimate = mcv_estimate(e);
+  }
+}
+
 /*!
   @brief our entropy estimator function
   This uses the zlib compressor on streaming data on the smallest possible
@@ -61,6 +207,9 @@ static void izfree(void *opaque,void *ptr)
   we flush/reset it every n bytes so that we can measure the compression ratio
   reliably. 
   - Life is full of compromises - but this will reliably detect a TRNG failure.
+  - TRNG_EST_MCV replaces the compressor with a streaming most common 
+  value estimate, far less state and per byte work, 
+  see mcv_update().
   \FIPS This is the FIPS 140-3 TRNG entropy estimator
 */
 
@@ -69,6 +218,14 @@ int EntropyEstimator(TRNG *trng,unsigned char *data,int n)
   int rv = 0; 
   int i,j;
 
+  if(TRNG_EST_MCV == trng->e.mode) {
+    /* Induced failure 201, as below */
+    if( 201 == icc_failure) {
+      memset(data,0xA5,n);
+    }
+    mcv_update(&(trng->e),data,n);
+    return rv;
+  }
   do {
     i = n;
     j = trng->e.Tbytesin - 1024;
@@ -90,13 +247,13 @@ int EntropyEstimator(TRNG *trng,unsigned char *data,int n)
     trng->e.Tbytesin += i;
     if(trng->e.Tbytesin >= 1024) {
       deflate(&(trng->e.strm),Z_SYNC_FLUSH);
-      memset(trng->e.out,0,sizeof(trng->e.out)); /* Don't use the compressed data, so zero this now */
-      trng->e.Tbytesout = 2048 - trng->e.strm.avail_out;
+      memset(trng->e.out,0,EST_OUTLEN); /* Don't use the compressed data, so zero this now */
+      trng->e.Tbytesout = EST_OUTLEN - trng->e.strm.avail_out;
       /* recalc the entropy - we have ~ 47 bytes overhead with uncompressable data */
       trng->e.EntropyEstimate = ((trng->e.Tbytesout - 48) * 100)/trng->e.Tbytesin;
       trng->e.Tbytesin = 0;
       trng->e.Tbytesout = 0;
-      trng->e.strm.avail_out = 2048;
+      trng->e.strm.avail_out = EST_OUTLEN;
       trng->e.strm.next_out = &(trng->e.out[0]);
     }
     n -= i;
@@ -162,17 +319,41 @@ TRNG_ERRORS InitEntropyEstimator(TRNG *trng)
 {
   TRNG_ERRORS rv = TRNG_OK;
   if(NULL != trng) {
-    trng->e.strm.zalloc = izcalloc;
-    trng->e.strm.zfree = izfree;
-    trng->e.strm.opaque = Z_NULL;
-    deflateInit2(&trng->e.strm,Z_DEFAULT_COMPRESSION,Z_DEFLATED,9,1,Z_DEFAULT_STRATEGY);
-    trng->e.strm.avail_out = 2048;
-    trng->e.strm.next_out = &(trng->e.out[0]);
+    /* Re-init, possibly in a different mode, release any live
+       compressor first or zlib's state leaks
+    */
+    if((1 == trng->e.EntropyState) && (TRNG_EST_DEFLATE == trng->e.mode)) {
+      deflateEnd(&trng->e.strm);
+      trng->e.zmem = 0;
+    }
+    trng->e.mode = est_mode;
+    if(TRNG_EST_MCV == trng->e.mode) {
+      memset(trng->e.win,0,sizeof(trng->e.win));
+      memset(trng->e.cnt,0,sizeof(trng->e.cnt));
+      trng->e.wpos = 0;
+      trng->e.wfill = 0;
+    } else if(NULL == trng->e.out) {
+      trng->e.out = (Bytef *)ICC_Calloc(1,EST_OUTLEN,__FILE__,__LINE__);
+      if(NULL == trng->e.out) {
+        rv = TRNG_INIT;
+      }
+    }
+  } else {
+    rv = TRNG_INIT;
+  }
+  if(TRNG_OK == rv) {
+    if(TRNG_EST_DEFLATE == trng->e.mode) {
+      trng->e.zmem = 0;
+      trng->e.strm.zalloc = izcalloc;
+      trng->e.strm.zfree = izfree;
+      trng->e.strm.opaque = &(trng->e);
+      deflateInit2(&trng->e.strm,Z_DEFAULT_COMPRESSION,Z_DEFLATED,9,1,Z_DEFAULT_STRATEGY);
+      trng->e.strm.avail_out = EST_OUTLEN;
+      trng->e.strm.next_out = &(trng->e.out[0]);
+    }
     trng->e.EntropyState = 1;
     trng->e.EntropyEstimate = 100; /* Until we have better information ... */
     trng->e.id = TRNG_E_MEASUREtag;
-  } else {
-    rv = TRNG_INIT;
   }
   return rv;
 }
@@ -182,6 +363,17 @@ TRNG_ERRORS InitEntropyEstimator(TRNG *trng)
 void CleanupEntropyEstimator(TRNG *trng)
 {
 
-  deflateEnd(&trng->e.strm);
+  if(TRNG_EST_MCV == trng->e.mode) {
+    memset(trng->e.win,0,sizeof(trng->e.win));
+    memset(trng->e.cnt,0,sizeof(trng->e.cnt));
+  } else {
+    deflateEnd(&trng->e.strm);
+    trng->e.zmem = 0;
+  }
+  if(NULL != trng->e.out) {
+    memset(trng->e.out,0,EST_OUTLEN);
+    ICC_Free(trng->e.out);
+    trng->e.out = NULL;
+  }
   trng->e.EntropyState = 0;
 }
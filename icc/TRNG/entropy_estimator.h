@@ -10,6 +10,19 @@
 #define ENTROPY_ESTIMATOR_H
 #include "noise_to_entropy.h"
 
+/* Long term entropy estimators */
+#define TRNG_EST_DEFLATE 0 /*!< zlib compression ratio, the default */
+#define TRNG_EST_MCV 1     /*!< Sliding window most common value, SP800-90B 6.3.1 */
+
+/*! @brief select the estimator used by TRNG's created from now on
+  @param name "DEFLATE" or "MCV" (case insensitive)
+  @return 1 if name was recognized, 0 otherwise
+*/
+int SetEntropyEstimator(const char *name);
+/*! @brief the estimator new TRNG's will use, TRNG_EST_DEFLATE or TRNG_EST_MCV */
+int GetEntropyEstimator(void);
+/*! @brief bytes of estimator state held by a TRNG, including heap */
+int EntropyEstimatorSize(TRNG *T);
 int GetDesignEntropy(TRNG *T);
 int GetEntropy(TRNG *T);
 int EntropyOK(TRNG *T);
@@ -0,0 +1,278 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: Background harvested entropy for seeding
+//
+*************************************************************************/
+
+/*
+  Gathering entropy inline means the caller waits while we collect
+  raw noise, health test and condition it. The harvester does the same
+  work ahead of time with it's own TRNG instance and parks the
+  conditioned output in a bounded reservoir. DRBG seed requests take
+  from there and fall back to inline collection when it runs dry.
+
+  - Data in the reservoir has passed exactly the same health tests,
+    conditioning, long term entropy and duplicate checks as inline data
+    from the same TRNG type, it's simply produced earlier.
+  - Only requests for the TRNG type the harvester runs are served.
+    Other types, or a default changed after startup, gather inline.
+  - Direct TRNG output (the TRNG_* RNG types) never comes from here,
+    that's what those types exist to exercise.
+  - Bytes are removed as they are taken and the space scrubbed so nothing
+    is handed out twice.
+  - A fork()ed child never uses the reservoir, it shares the contents
+    with it's parent and has no harvester thread.
+  - res_mtx is created once and never destroyed, takers check the
+    reservoir is still running under it, so TRNG_ReservoirStop() can't
+    free the buffer out from under one.
+*/
+
+#include <stdio.h>
+#include "icclib.h"
+#include "platform.h"
+#include "platform_api.h"
+#include "tracer.h"
+#include "TRNG/ICC_NRBG.h"
+#include "TRNG/entropy_to_NRBGi.h"
+#include "TRNG/entropy_reservoir.h"
+#if !defined(_WIN32)
+#include <time.h>
+#endif
+
+#define RES_CHUNK 64    /*!< Bytes harvested per pass */
+#define RES_POLL_MS 50  /*!< Harvester idle poll interval */
+
+static unsigned int res_size = 0;    /*!< Configured size, 0 == off */
+static unsigned char *res_buf = NULL;/*!< The reservoir */
+static unsigned int res_avail = 0;   /*!< Bytes available in res_buf */
+static ICC_Mutex res_mtx;            /*!< Protects res_buf/res_avail/res_running */
+static int res_mtx_valid = 0;        /*!< res_mtx exists, it's never destroyed */
+static TRNG *res_trng = NULL;        /*!< The harvester's entropy source */
+static TRNG_TYPE res_type;           /*!< and it's type */
+static int res_running = 0;          /*!< Harvester started */
+static int res_failed = 0;           /*!< Harvester has stopped on error */
+static DWORD res_pid = 0;            /*!< Process the harvester runs in */
+#if defined(_WIN32)
+static HANDLE res_tid = NULL;
+static HANDLE res_evt = NULL;        /*!< Signalled to stop the harvester */
+#else
+static pthread_t res_tid;
+static pthread_mutex_t res_cmtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t res_cv = PTHREAD_COND_INITIALIZER;
+static int res_stop = 0;             /*!< Set to stop the harvester */
+#endif
+
+int SetTRNGReservoir(int bytes)
+{
+  int rv = 0;
+  if (!res_running && (bytes >= 0) && (bytes <= RESERVOIR_MAX)) {
+    res_size = (unsigned int)bytes;
+    rv = 1;
+  }
+  return rv;
+}
+
+int GetTRNGReservoir(void)
+{
+  return (int)res_size;
+}
+
+/*!
+  @brief harvest one chunk into the reservoir
+  @return 1 if data was added, 0 if the reservoir is full or
+          the harvester has failed
+*/
+static int res_fill(void)
+{
+  int rv = 0;
+  unsigned int k = 0;
+  unsigned char chunk[RES_CHUNK];
+
+  if (!res_failed) {
+    ICC_LockMutex(&res_mtx);
+    k = res_size - res_avail;
+    ICC_UnlockMutex(&res_mtx);
+    if (k > 0) {
+      /* Errors are already reported by the TRNG, just stop supplying data
+         and let inline collection hit the same failure
+      */
+      if (TRNG_OK != Entropy_to_TRNG(res_trng, chunk, RES_CHUNK)) {
+        res_failed = 1;
+      } else {
+        ICC_LockMutex(&res_mtx);
+        k = res_size - res_avail;
+        if (k > RES_CHUNK) {
+          k = RES_CHUNK;
+        }
+        memcpy(res_buf + res_avail, chunk, k);
+        res_avail += k;
+        ICC_UnlockMutex(&res_mtx);
+        rv = 1;
+      }
+      memset(chunk, 0, sizeof(chunk));
+    }
+  }
+  return rv;
+}
+
+/*!
+  @brief harvester thread, fills the reservoir until told to stop
+*/
+#if defined(_WIN32)
+static DWORD WINAPI res_main(LPVOID arg)
+{
+  DWORD wait = 0;
+  while (WAIT_TIMEOUT == WaitForSingleObject(res_evt, wait)) {
+    wait = res_fill() ? 0 : RES_POLL_MS;
+  }
+  return 0;
+}
+#else
+static void *res_main(void *arg)
+{
+  struct timespec ts;
+  int filled = 0;
+
+  pthread_mutex_lock(&res_cmtx);
+  while (!res_stop) {
+    pthread_mutex_unlock(&res_cmtx);
+    filled = res_fill();
+    pthread_mutex_lock(&res_cmtx);
+    if (!filled && !res_stop) {
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ts.tv_nsec += (RES_POLL_MS % 1000) * 1000000L;
+      ts.tv_sec += RES_POLL_MS / 1000 + ts.tv_nsec / 1000000000L;
+      ts.tv_nsec %= 1000000000L;
+      pthread_cond_timedwait(&res_cv, &res_cmtx, &ts);
+    }
+  }
+  pthread_mutex_unlock(&res_cmtx);
+  return NULL;
+}
+#endif
+
+int TRNG_ReservoirStart(void)
+{
+  int ok = 0;
+
+  if ((0 != res_size) && !res_running) {
+    res_avail = 0;
+    res_failed = 0;
+    res_buf = (unsigned char *)ICC_Calloc(1, res_size, __FILE__, __LINE__);
+    res_type = GetDefaultTrng();
+    res_trng = TRNG_new(res_type);
+    if (!res_mtx_valid && (0 == ICC_CreateMutex(&res_mtx))) {
+      res_mtx_valid = 1;
+    }
+    if ((NULL != res_buf) && (NULL != res_trng) && res_mtx_valid) {
+#if defined(_WIN32)
+      res_evt = CreateEvent(NULL, TRUE, FALSE, NULL);
+      if (NULL != res_evt) {
+        res_tid = CreateThread(NULL, 0, res_main, NULL, 0, NULL);
+        if (NULL != res_tid) {
+          ok = 1;
+        } else {
+          CloseHandle(res_evt);
+          res_evt = NULL;
+        }
+      }
+#else
+      res_stop = 0;
+      if (0 == pthread_create(&res_tid, NULL, res_main, NULL)) {
+        ok = 1;
+      }
+#endif
+    }
+    if (ok) {
+      res_pid = ICC_GetProcessId();
+      ICC_LockMutex(&res_mtx);
+      res_running = 1;
+      ICC_UnlockMutex(&res_mtx);
+      MARK("TRNG reservoir started", "");
+    } else {
+      if (NULL != res_trng) {
+        TRNG_free(res_trng);
+        res_trng = NULL;
+      }
+      if (NULL != res_buf) {
+        ICC_Free(res_buf);
+        res_buf = NULL;
+      }
+    }
+  }
+  return ok;
+}
+
+void TRNG_ReservoirStop(void)
+{
+  if (res_running) {
+    /* The thread only exists in the process that started it */
+    if (ICC_GetProcessId() == res_pid) {
+#if defined(_WIN32)
+      SetEvent(res_evt);
+      WaitForSingleObject(res_tid, INFINITE);
+#else
+      pthread_mutex_lock(&res_cmtx);
+      res_stop = 1;
+      pthread_cond_signal(&res_cv);
+      pthread_mutex_unlock(&res_cmtx);
+      pthread_join(res_tid, NULL);
+#endif
+    }
+#if defined(_WIN32)
+    CloseHandle(res_tid);
+    CloseHandle(res_evt);
+    res_tid = NULL;
+    res_evt = NULL;
+#endif
+    /* Takers check res_running under the lock, once it's clear
+       none can be using the buffer. A fork()ed child may have
+       inherited the lock held, it has no takers to fence off
+    */
+    if (ICC_GetProcessId() == res_pid) {
+      ICC_LockMutex(&res_mtx);
+      res_running = 0;
+      ICC_UnlockMutex(&res_mtx);
+    } else {
+      res_running = 0;
+    }
+    TRNG_free(res_trng);
+    res_trng = NULL;
+    memset(res_buf, 0, res_size);
+    ICC_Free(res_buf);
+    res_buf = NULL;
+    res_avail = 0;
+  }
+}
+
+int TRNG_ReservoirTake(TRNG_TYPE type, unsigned char *out, unsigned int n)
+{
+  int rv = 0;
+
+  /* A child of fork() holds a copy of it's parent's reservoir,
+     never use that, and don't touch the lock, the harvester
+     may have held it when we forked
+  */
+  if (res_mtx_valid && (0 != n) && (ICC_GetProcessId() == res_pid)) {
+    ICC_LockMutex(&res_mtx);
+    if (res_running && (type == res_type) && (res_avail >= n)) {
+      res_avail -= n;
+      memcpy(out, res_buf + res_avail, n);
+      memset(res_buf + res_avail, 0, n);
+      rv = 1;
+    }
+    ICC_UnlockMutex(&res_mtx);
+#if !defined(_WIN32)
+    /* Wake the harvester early rather than waiting for it's poll */
+    pthread_cond_signal(&res_cv);
+#endif
+  }
+  return rv;
+}
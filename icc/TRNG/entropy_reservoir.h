@@ -0,0 +1,60 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: Background harvested entropy for seeding
+//
+*************************************************************************/
+
+#ifndef ENTROPY_RESERVOIR_H
+#define ENTROPY_RESERVOIR_H
+
+/*! @brief Largest reservoir we'll allocate (bytes) */
+#define RESERVOIR_MAX (64 * 1024)
+
+/*!
+  @brief set the size of the entropy reservoir
+  @param bytes reservoir size, 0 disables it (the default)
+  @return 1 on sucess, 0 otherwise
+  @note this must be called before the first ICC_Attach()
+*/
+int SetTRNGReservoir(int bytes);
+
+/*!
+  @brief return the configured entropy reservoir size
+*/
+int GetTRNGReservoir(void);
+
+/*!
+  @brief start the harvester thread if a reservoir is configured
+  @return 1 if it's running, 0 otherwise
+  @note Failure isn't fatal, seeding is then done inline
+*/
+int TRNG_ReservoirStart(void);
+
+/*!
+  @brief stop the harvester thread and scrub the reservoir
+*/
+void TRNG_ReservoirStop(void);
+
+/*!
+  @brief take DRBG seed data from the reservoir
+  @param type the TRNG type the caller would otherwise gather from
+  @param out the buffer to fill
+  @param n the number of bytes wanted
+  @return 1 if the request was filled, 0 if the caller must gather
+          entropy inline
+  @note bytes are removed from the reservoir as they are taken,
+        nothing is handed out twice
+  @note only the TRNG type that filled the reservoir is served, and only
+        DRBG seeding should call this, direct TRNG output is always
+        gathered inline
+*/
+int TRNG_ReservoirTake(TRNG_TYPE type, unsigned char *out, unsigned int n);
+
+#endif
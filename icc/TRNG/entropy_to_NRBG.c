@@ -35,11 +35,60 @@ static void printbin( char *s,int l)
 void xcompress(TRNG *T,unsigned char outbuf[SHA_DIGEST_SIZE],unsigned char *in, int len)
 {
   unsigned int mlen = SHA_DIGEST_SIZE;
-  HMAC_Init(T->cond.hctx,T->cond.key,sizeof(T->cond.key),T->md);
+  /* Restart from the keyed state TRNG_CondInit() left in hctx */
+  HMAC_Init_ex(T->cond.hctx,NULL,0,NULL,NULL);
   HMAC_Update(T->cond.hctx,outbuf,SHA_DIGEST_SIZE);   
   HMAC_Update(T->cond.hctx,in,len);
   HMAC_Final(T->cond.hctx,outbuf,&mlen);
-  HMAC_CTX_cleanup(T->cond.hctx);
+}
+
+/*! @brief SHA-256 compression step, TRNG_COND_SHA256
+  @param T TRNG parameters
+  @param outbuf buffer for compressed data
+  @param len amount of data required
+  @note SP800-90B vetted hash conditioning. Each pass hashes the residual
+  data and the whole pass of raw data, guarantee * SHA_DIGEST_SIZE bytes, 
+  read from the noise source in blocks of TRNG_COND_RAWBLK. That's roughly
+  half the compressions the HMAC conditioner needs for the same output
+  as there's no zero padding to hash and no outer hash.
+*/
+static int cond_sha(TRNG *T, unsigned char* outbuf, unsigned len)
+{
+  unsigned int n = 0;
+  unsigned int i = 0;
+  unsigned int j = 0;
+  unsigned int k = 0;
+  unsigned int raw = 0;
+  unsigned int mlen = SHA_DIGEST_SIZE;
+  int rv = 0;
+  unsigned char tbuf[SHA_DIGEST_SIZE];
+  unsigned char rbuf[TRNG_COND_RAWBLK];
+
+  raw = TRNG_guarantee(T) * SHA_DIGEST_SIZE;
+  while( n < len) {
+    EVP_DigestInit_ex(T->cond.mctx,T->md,NULL);
+    EVP_DigestUpdate(T->cond.mctx,T->cond.rdata,sizeof(T->cond.rdata));
+    for(j = 0; j < raw; j += k) {
+      k = ((raw - j) < sizeof(rbuf)) ? (raw - j) : sizeof(rbuf);
+      if( 0 != trng_raw(&(T->econd),rbuf,k) ) {
+        rv = SetRNGError("Insufficient entropy",__FILE__,__LINE__);
+        if(TRNG_OK != rv) {
+          break;
+        }          
+      }
+      EVP_DigestUpdate(T->cond.mctx,rbuf,k);
+    }
+    EVP_DigestFinal_ex(T->cond.mctx,tbuf,&mlen);
+    if(TRNG_OK != rv) {
+      break;
+    }
+    for(i = 0; (i < mlen) && (n < len); ) {
+      outbuf[n++] = tbuf[i++];
+    }
+  }
+  memset(rbuf,0,sizeof(rbuf));
+  memset(tbuf,0,sizeof(tbuf));
+  return rv;
 }
 /*! @brief HMAC compression step 
   @param T TRNG parameters
@@ -58,17 +107,20 @@ int conditioner(TRNG *T, unsigned char* outbuf, unsigned len)
   unsigned mlen = SHA_DIGEST_SIZE;
   int rv = 0;
   unsigned char tbuf[SHA_DIGEST_SIZE *2];
+  if(TRNG_COND_SHA256 == T->cond.mode) {
+    return cond_sha(T,outbuf,len);
+  }
   memset(tbuf,0,SHA_DIGEST_SIZE *2);  
   guarantee = TRNG_guarantee(T);
   while( n < len) {
-    HMAC_Init(T->cond.hctx,T->cond.key,sizeof(T->cond.key),T->md);
+    /* Restart from the keyed state TRNG_CondInit() left in hctx */
+    HMAC_Init_ex(T->cond.hctx,NULL,0,NULL,NULL);
     /* personalization data */
     HMAC_Update(T->cond.hctx,T->cond.rdata,sizeof(T->cond.rdata));
     for(j = 0; j < guarantee; j++) { 
       if( 0 != trng_raw(&(T->econd),tbuf,SHA_DIGEST_SIZE) ) {
         rv = SetRNGError("Insufficient entropy",__FILE__,__LINE__);
         if(TRNG_OK != rv) {
-          HMAC_CTX_cleanup(T->cond.hctx);
           return rv;
         }          
       }
@@ -82,7 +134,7 @@ int conditioner(TRNG *T, unsigned char* outbuf, unsigned len)
     }
     
   }
-  HMAC_CTX_cleanup(T->cond.hctx);
+  memset(tbuf,0,sizeof(tbuf));
   /* Update our "IV"
   for(i = 0; i < sizeof(T->cond.rdata); i++) {
       T->cond.rdata[i] ^= tbuf[i];
@@ -123,6 +175,7 @@ TRNG_ERRORS Entropy_to_TRNG(TRNG *T, unsigned char *data, unsigned int len)
         }
         e = pmax4(buffer,SHA_DIGEST_SIZE);
         if(e < 50) {
+          T->cretry++;
           break;
         }
         k = (len - i) < SHA_DIGEST_SIZE ? (len - i) : SHA_DIGEST_SIZE;
@@ -170,6 +223,7 @@ TRNG_ERRORS Entropy_to_TRNG(TRNG *T, unsigned char *data, unsigned int len)
     } else { /* FAIL, round we go again after checking for repeat failures */
       i = 0;
       m++;
+      T->cretry++;
       if(m > 5) {
         rv = SetRNGError("Repeated duplicate seeds from TRNG", __FILE__, __LINE__);
         if (TRNG_OK != rv) {
@@ -50,6 +50,13 @@ typedef int (*TRNG_GET_MEASURE_F)();
 
 
 
+/* Conditioning functions */
+#define TRNG_COND_HMAC 0   /*!< HMAC keyed with the conditioning key, the default */
+#define TRNG_COND_SHA256 1 /*!< SHA-256 over a whole pass of raw data */
+
+/*! @brief Raw bytes fed to one SHA-256 conditioning pass are read in blocks of up to this */
+#define TRNG_COND_RAWBLK (SHA_DIGEST_SIZE * 4)
+
 /*! @brief Collected data structures for noise conditioning 
     Note that in theory we could use the HMAC or CMAC conditioner
     Our HMAC code is faster, so we use that.
@@ -57,7 +64,9 @@ typedef int (*TRNG_GET_MEASURE_F)();
 typedef struct TRNG_COND_t {
   unsigned char key[SHA_DIGEST_SIZE];   /*!< HMAC/CMAC key */
   unsigned char rdata[SHA_DIGEST_SIZE]; /*!< Residual personalization data/IV for the conditioner */              
-  HMAC_CTX *hctx;                       /*!< Conditioning/compression key */
+  HMAC_CTX *hctx;                       /*!< Conditioning/compression key, kept keyed with key */
+  EVP_MD_CTX *mctx;                     /*!< Digest context, TRNG_COND_SHA256 only */
+  int mode;                             /*!< TRNG_COND_HMAC or TRNG_COND_SHA256 */
   const char *id;                       /*!< Debug */
 } TRNG_COND;
 
@@ -34,14 +34,23 @@
 #endif
 
 
+#define EST_OUTLEN 2048  /*!< Deflate estimator output buffer size */
+#define EST_WIN 256      /*!< MCV estimator window in bytes, 2 samples/byte */
+
 /*! @brief Collected data structure for our long term entropy measuring routine */
 typedef struct E_MEASURE_t {
   z_stream strm;         /*!< The compression structure used by the estimator */
+  int mode;              /*!< TRNG_EST_DEFLATE or TRNG_EST_MCV */
   int EntropyState;      /*!< Initialization state of the estimator */
   int EntropyEstimate;   /*!< The current entropy estimate from this PRNG instance */
   int Tbytesin;          /*!< Byte count in for this estimator */
   int Tbytesout;         /*!< Byte count out for this estimator */
-  Bytef out[2048]; 	     /*!< Compression buffer */
+  int zmem;              /*!< Bytes zlib has allocated for strm */
+  Bytef *out;            /*!< Compression buffer, EST_OUTLEN, deflate only */
+  unsigned char win[EST_WIN]; /*!< MCV, the last EST_WIN bytes seen */
+  unsigned short cnt[16];     /*!< MCV, nibble counts over win */
+  unsigned short wpos;        /*!< MCV, next byte to replace in win */
+  unsigned short wfill;       /*!< MCV, bytes in win, EST_WIN once full */
   const char *id;        /*!< Debug */
 } E_MEASURE;
 
@@ -66,6 +75,7 @@ struct TRNG_t {
   EVP_MD_CTX *md_ctx;   /*!< Working digest CTX for CRNG test */
   const EVP_MD *md;     /*!< Digest we are using */
   int type;             /*!< Type of TRNG instantiated */
+  unsigned int cretry;  /*!< Conditioned blocks regenerated (low entropy/duplicate), diagnostics only */
   const char *id;             /*!< Debug */
 };
 
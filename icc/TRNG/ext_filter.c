@@ -21,6 +21,18 @@ int ChkMem(T_FILTER *TF,unsigned char c)
 {
     return 1;
 } 
+static int filter_mem(T_FILTER *TF,const ICC_UINT64 *in,int n,
+                      unsigned char *out,int room)
+{
+   int i;
+   if(n > room) {
+      n = room;
+   }
+   for(i = 0; i < n; i++) {
+      out[i] = (unsigned char)(in[i] & 0xff);
+   }
+   return n;
+}
 #endif
 
 
@@ -187,4 +199,46 @@ void proc_mem(T_FILTER *tf,unsigned char v)
    proc_mem_nocheck(tf,v);
 }
 
+/*! @brief ChkMem()/proc_mem() over a batch of samples
+   @param tf pointer to a T_FILTER struct
+   @param in timer samples, the low byte of each is the candidate
+   @param n number of samples
+   @param out where accepted bytes are stored
+   @param room space left in out
+   @return the number of bytes stored
+   @note identical results to calling ChkMem()/proc_mem() per byte, 
+   each accepted byte must update the window before the next is checked
+   so this can't be vectorized, but the per byte call overhead and the
+   initialization and done checks drop out of the loop. The FIFO index
+   wrap check stays in, proc_mem_nocheck() steps the index past the end.
+*/
+static int filter_mem(T_FILTER *tf,const ICC_UINT64 *in,int n,
+                      unsigned char *out,int room)
+{
+   int i;
+   int count = 0;
+   int chk = 0;
+   unsigned char c;
+
+   if((n > 0) && (room > 0)) {
+      if(!tf->fifo_init) {
+         prefill(tf);
+         tf->fifo_init = 1;
+      }
+      chk = (1 == tf->done);
+      for(i = 0; (count < room) && (i < n); i++) {
+         c = (unsigned char)(in[i] & 0xff);
+         if(chk && (tf->arry[c] >= TOO_HIGH)) {
+            continue;
+         }
+         out[count++] = c;
+         if((tf->idx >= HISTSZ) || (tf->idx < 0)) {
+            tf->idx = 0;
+         }
+         proc_mem_nocheck(tf,c);
+      }
+   }
+   return count;
+}
+
 #endif
@@ -66,6 +66,171 @@ static unsigned int ilog2(unsigned int v)
   }
   return r;
 }
+
+/*
+  The block tests run on every E_ESTB_BUFLEN refill of raw noise so the
+  histogram and repeat scans are worth vectorizing.
+  The scalar versions are the reference, the vector kernels in nist_simd.h
+  return identical results. 
+  x86_64 builds an AVX2 and a baseline (SSE2) instance, aarch64 a
+  baseline (NEON) instance, anything else uses the scalar code.
+*/
+#if !defined(NIST_NO_SIMD) && (defined(__x86_64__) || defined(__aarch64__)) && \
+  (defined(__clang__) || (defined(__GNUC__) && (__GNUC__ >= 5)))
+#define NIST_SIMD 1
+#endif
+
+/*!
+  @brief largest bin in the byte histogram of data, scalar reference
+  @param data the samples
+  @param len number of samples
+  @return the count in the fullest bin
+*/
+static unsigned int hist_max_c(const unsigned char *data,int len)
+{
+  unsigned int syms[256];
+  unsigned int k = 0;
+  int i = 0;
+
+  memset(syms, 0, sizeof(syms));
+  for (i = 0; i < len; i++) {
+    syms[data[i]]++;
+  }
+  for (i = 0; i < 256; i++) {
+    if (syms[i] > k) {
+      k = syms[i];
+    }
+  }
+  return k;
+}
+
+/*!
+  @brief check a block for limit+1 identical consecutive samples, 
+  scalar reference
+  @param bk the samples
+  @param len number of samples
+  @param limit the repeat count limit
+  @return 1 if such a run exists, 0 otherwise
+*/
+static int run_chk_c(const unsigned char *bk,int len,int limit)
+{
+  int rv = 0;
+  int B = 0;
+  int i;
+  int c = -1;
+
+  for (i = 0; i < len; i++) {
+    if (c == bk[i]) {
+      B++;
+    } else {
+      c = bk[i];
+      B = 0;
+    }
+    if (B >= limit) {
+      rv = 1;
+      break;
+    }
+  }
+  return rv;
+}
+
+#if defined(NIST_SIMD)
+#define NS_CAT_(a,b) a##b
+#define NS_CAT(a,b) NS_CAT_(a,b)
+
+#define NS_SFX base
+#define NS_ATTR
+#define NS_W 16
+#include "TRNG/nist_simd.h"
+#undef NS_SFX
+#undef NS_ATTR
+#undef NS_W
+
+#if defined(__x86_64__)
+#define NS_SFX avx2
+#define NS_ATTR __attribute__((target("avx2")))
+#define NS_W 32
+#include "TRNG/nist_simd.h"
+#undef NS_SFX
+#undef NS_ATTR
+#undef NS_W
+#endif
+#endif
+
+/*! 0 scalar, 1 baseline vectors, 2 AVX2, -1 not yet probed */
+static int nist_simd = -1;
+
+static int nist_level(void)
+{
+  if (nist_simd < 0) {
+#if defined(NIST_SIMD) && defined(__x86_64__)
+    nist_simd = __builtin_cpu_supports("avx2") ? 2 : 1;
+#elif defined(NIST_SIMD)
+    nist_simd = 1;
+#else
+    nist_simd = 0;
+#endif
+  }
+  return nist_simd;
+}
+
+/*!
+  @brief largest bin in the byte histogram of data
+  @param data the samples
+  @param len number of samples
+  @return the count in the fullest bin
+*/
+static unsigned int hist_max(const unsigned char *data,int len)
+{
+  unsigned int k = 0;
+
+  switch ((len <= 65535) ? nist_level() : 0) {
+#if defined(NIST_SIMD)
+#if defined(__x86_64__)
+  case 2:
+    k = hist_max_avx2(data,len);
+    break;
+#endif
+  case 1:
+    k = hist_max_base(data,len);
+    break;
+#endif
+  default:
+    k = hist_max_c(data,len);
+    break;
+  }
+  return k;
+}
+
+/*!
+  @brief check a block for limit+1 identical consecutive samples
+  @param bk the samples
+  @param len number of samples
+  @param limit the repeat count limit
+  @return 1 if such a run exists, 0 otherwise
+*/
+static int run_chk(const unsigned char *bk,int len,int limit)
+{
+  int rv = 0;
+
+  switch ((len <= E_ESTB_BUFLEN && limit < 32) ? nist_level() : 0) {
+#if defined(NIST_SIMD)
+#if defined(__x86_64__)
+  case 2:
+    rv = run_chk_avx2(bk,len,limit);
+    break;
+#endif
+  case 1:
+    rv = run_chk_base(bk,len,limit);
+    break;
+#endif
+  default:
+    rv = run_chk_c(bk,len,limit);
+    break;
+  }
+  return rv;
+}
+
 /*!
   @brief Entropy estimate based on Appendix C.3 SP800-90
   Returns entropic bits out/200 bits in
@@ -85,30 +250,15 @@ unsigned int pmaxLGetEnt(unsigned char *data, int len)
   double p = 0.0, log2p = 0.0;
   double hmin = 0.0;
 #endif
-  int i = 0;
   int k = 0;
   int ip = 0;
   int ilog2p = 0;
-  unsigned int syms[256];
   unsigned int est = 0;
 
 
   if (len >= 512)
   {
-    memset(syms, 0, sizeof(syms));
-
-    for (i = 0; i < len; i++)
-    {
-      syms[data[i]]++;
-    }
-    k = 0;
-    for (i = 0; i < 256; i++)
-    {
-      if (syms[i] > k)
-      {
-        k = syms[i];
-      }
-    }
+    k = hist_max(data, len);
 
     /* 
        Convert the most common value to a probability
@@ -261,12 +411,9 @@ int pmax4(unsigned char *data,int len)
 int APtestBK(int N, unsigned char data[512])
 {
   int rv = 0; 
-  unsigned int cnt[256];
   static int h[5] = {311,177,62,23,13};
   int C = 0;
-  int i = 0;
   int maxc = 0;
-  unsigned char t;
 
   /* Check that N is one of the allowed values 12,25,50,75,100
      pick the appropriate table
@@ -293,18 +440,7 @@ int APtestBK(int N, unsigned char data[512])
     C = 0; /* Estimator wil fail */
     break;
   }
-  memset(cnt,0,sizeof(cnt));
-  for(i = 0; i < E_ESTB_BUFLEN; i++) {
-    t = data[i];
-    cnt[t]++;
-  }
-
-  for(i = 0; i < 256; i++)
-  {
-    if(cnt[i] > maxc) {
-      maxc = cnt[i];
-    }
-  }
+  maxc = hist_max(data,E_ESTB_BUFLEN);
   /* printf("C = %d, maxc = %d\n",C,maxc); */
 
   if (maxc >= C)
@@ -320,10 +456,7 @@ int RCtestBK(int H,unsigned char bk[512])
   static int RCTable[3] = {16,9,6};
   int rv = 0;
   int Hi;
-  int limit;
-  int B = 0;
-  int i;
-  int c = -1;
+  int limit = 0;
 
   switch (H)
   {
@@ -339,23 +472,7 @@ int RCtestBK(int H,unsigned char bk[512])
   }
   if (0 == rv)
   {
-    for (i = 0; i < 512; i++)
-    {
-      if (c == bk[i])
-      {
-        B++;
-      }
-      else
-      {
-        c = bk[i];
-        B = 0;
-      }
-      if (B >= limit)
-      {
-        rv = 1;
-        break;
-      }
-    }
+    rv = run_chk(bk,512,limit);
   }
   return rv;
 }
@@ -857,6 +974,95 @@ void testiLog2()
 #if defined(STANDALONE)
 unsigned int icc_failure = 0;
 
+#if defined(NIST_BENCH)
+#include <time.h>
+/*
+  Cost of the block health tests per KB of noise, scalar vs vector.
+  Also cross checks the two on random and deliberately low entropy 
+  blocks.
+  Build with "make nist_bench" in this directory.
+*/
+#define NB_BLOCKS 1024
+
+static void nb_fill(unsigned char *buf,int len,int mode)
+{
+  int i;
+  for(i = 0; i < len; i++) {
+    switch(mode) {
+    case 0: /* noise */
+      buf[i] = (unsigned char)(rand() >> 7);
+      break;
+    case 1: /* few symbols */
+      buf[i] = (unsigned char)((rand() >> 7) & 0x03);
+      break;
+    default: /* long runs */
+      buf[i] = (i && (rand() % 24)) ? buf[i-1] : (unsigned char)(rand() >> 7);
+      break;
+    }
+  }
+}
+
+/*! @brief pass over the buffer as trng_raw()/ht() do per refill */
+static double nb_time(unsigned char *buf,int level)
+{
+  clock_t t0,t1;
+  int i,r;
+  unsigned int sink = 0;
+
+  nist_simd = level;
+  t0 = clock();
+  for(r = 0; r < 64; r++) {
+    for(i = 0; i < NB_BLOCKS; i++) {
+      sink += pmaxLGetEnt(buf + i * E_ESTB_BUFLEN,E_ESTB_BUFLEN);
+      sink += APtestBK(50,buf + i * E_ESTB_BUFLEN);
+      sink += RCtestBK(50,buf + i * E_ESTB_BUFLEN);
+    }
+  }
+  t1 = clock();
+  if(0 == sink) {
+    printf("!");
+  }
+  /* ns per KB */
+  return ((double)(t1 - t0) / CLOCKS_PER_SEC) * 1e9 / 
+    (64.0 * NB_BLOCKS * E_ESTB_BUFLEN / 1024.0);
+}
+
+int main(int argc, char *argv[])
+{
+  static unsigned char buf[NB_BLOCKS * E_ESTB_BUFLEN];
+  int i,m,lim,vec;
+  int bad = 0;
+  double ts,tv;
+
+  srand(1);
+  vec = nist_level();
+  for(m = 0; m < 3; m++) {
+    nb_fill(buf,sizeof(buf),m);
+    for(i = 0; i < NB_BLOCKS; i++) {
+      const unsigned char *b = buf + i * E_ESTB_BUFLEN;
+      if(hist_max_c(b,E_ESTB_BUFLEN) != hist_max(b,E_ESTB_BUFLEN)) {
+        bad++;
+      }
+      for(lim = 1; lim <= 16; lim++) {
+        if(run_chk_c(b,E_ESTB_BUFLEN,lim) != run_chk(b,E_ESTB_BUFLEN,lim)) {
+          bad++;
+        }
+      }
+    }
+  }
+  printf("vector level %d, %d mismatches\n",vec,bad);
+  nb_fill(buf,sizeof(buf),0);
+  ts = nb_time(buf,0);
+  tv = nb_time(buf,vec);
+  printf("scalar %8.0f ns/KB\nvector %8.0f ns/KB (%.2fx)\n",ts,tv,ts/tv);
+  if(vec > 1) {
+    tv = nb_time(buf,1);
+    printf("base   %8.0f ns/KB (%.2fx)\n",tv,ts/tv);
+  }
+  return bad ? 1 : 0;
+}
+
+#else
 int main(int argc, char *argv[])
 {
 #if 0
@@ -886,3 +1092,4 @@ int main(int argc, char *argv[])
 
 #endif
 
+#endif
@@ -0,0 +1,130 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: Vector kernels for the block health tests
+//              Included by nist_algs.c once per instruction set
+//
+*************************************************************************/
+
+/*
+  Expects
+  NS_SFX   name suffix for this instance
+  NS_ATTR  function attributes selecting the instruction set (may be empty)
+  NS_W     vector width in bytes, 16 or 32, the native register width.
+           Wider generic vectors than the hardware has are split by the
+           compiler and run slower than scalar code.
+  Results are identical to hist_max_c()/run_chk_c(), only the
+  order of the work differs.
+*/
+
+#define NS_V8 NS_CAT(ns_v8_,NS_SFX)
+#define NS_V16 NS_CAT(ns_v16_,NS_SFX)
+
+typedef unsigned char NS_V8 __attribute__((vector_size(NS_W)));
+typedef unsigned short NS_V16 __attribute__((vector_size(NS_W)));
+
+/*!
+  @brief largest bin in the byte histogram of data
+  @param data the samples
+  @param len number of samples, <= 65535 so 16 bit counts can't wrap
+  @return the count in the fullest bin
+  @note four interleaved tables so runs of one value don't serialize
+  on a single counter, merged and scanned NS_W/2 bins at a time
+*/
+static NS_ATTR unsigned int NS_CAT(hist_max_,NS_SFX)(const unsigned char *data,int len)
+{
+  unsigned short h[4][256];
+  unsigned short mx[NS_W / 2];
+  NS_V16 s,t,m,gt;
+  unsigned int k = 0;
+  int i = 0;
+
+  memset(h,0,sizeof(h));
+  for(i = 0; (i + 4) <= len; i += 4) {
+    h[0][data[i]]++;
+    h[1][data[i+1]]++;
+    h[2][data[i+2]]++;
+    h[3][data[i+3]]++;
+  }
+  for( ; i < len; i++) {
+    h[0][data[i]]++;
+  }
+  memset(&m,0,sizeof(m));
+  for(i = 0; i < 256; i += (NS_W / 2)) {
+    memcpy(&s,&h[0][i],sizeof(s));
+    memcpy(&t,&h[1][i],sizeof(t));
+    s += t;
+    memcpy(&t,&h[2][i],sizeof(t));
+    s += t;
+    memcpy(&t,&h[3][i],sizeof(t));
+    s += t;
+    gt = (NS_V16)(s > m);
+    m = (s & gt) | (m & ~gt);
+  }
+  memcpy(mx,&m,sizeof(mx));
+  for(i = 0; i < (NS_W / 2); i++) {
+    if(mx[i] > k) {
+      k = mx[i];
+    }
+  }
+  return k;
+}
+
+/*!
+  @brief check a block for limit+1 identical consecutive samples
+  @param bk the samples
+  @param len number of samples, <= E_ESTB_BUFLEN
+  @param limit the repeat count limit (< 32)
+  @return 1 if such a run exists, 0 otherwise
+  @note e[i] starts as bk[i] == bk[i+1], each pass ANDs it with e[i+s]
+  so it covers a run twice as long until it covers limit repeats
+*/
+static NS_ATTR int NS_CAT(run_chk_,NS_SFX)(const unsigned char *bk,int len,int limit)
+{
+  unsigned char e[E_ESTB_BUFLEN + 64];
+  unsigned long long z[NS_W / 8];
+  NS_V8 a,b,acc;
+  int i = 0;
+  int w = 0;
+  int s = 0;
+
+  memset(e,0,sizeof(e));
+  for(i = 0; (i + NS_W + 1) <= len; i += NS_W) {
+    memcpy(&a,bk + i,sizeof(a));
+    memcpy(&b,bk + i + 1,sizeof(b));
+    a = (NS_V8)(a == b);
+    memcpy(e + i,&a,sizeof(a));
+  }
+  for( ; i < (len - 1); i++) {
+    e[i] = (bk[i] == bk[i+1]) ? 0xff : 0;
+  }
+  /* In place is safe, we only read at or ahead of what we write */
+  for(w = 1; w < limit; w += s) {
+    s = ((limit - w) < w) ? (limit - w) : w;
+    for(i = 0; i < len; i += NS_W) {
+      memcpy(&a,e + i,sizeof(a));
+      memcpy(&b,e + i + s,sizeof(b));
+      a &= b;
+      memcpy(e + i,&a,sizeof(a));
+    }
+  }
+  memset(&acc,0,sizeof(acc));
+  for(i = 0; i < len; i += NS_W) {
+    memcpy(&a,e + i,sizeof(a));
+    acc |= a;
+  }
+  memcpy(z,&acc,sizeof(z));
+  for(i = 1; i < (NS_W / 8); i++) {
+    z[0] |= z[i];
+  }
+  return (0 != z[0]) ? 1 : 0;
+}
+
+#undef NS_V8
+#undef NS_V16
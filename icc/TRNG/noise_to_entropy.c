@@ -100,6 +100,7 @@ int trng_raw(E_SOURCE *E,
       e = pmaxLGetEnt(E->nbuf, E_ESTB_BUFLEN); /* So just do an entropy check here for all modes, equivalent to AP anyway */
       if(e < (50*2) ) { /* The entropy estimator uses integer maths, number back is 2x real entropy so we can handle 12.5, 87.5 etc */
        failcount++;
+       E->htretry++;
         E->cnt = 0;
 
       }
@@ -167,6 +167,7 @@ typedef struct T_FILTER_t {
     int fifo_init;          /* FIFO has been initialized */
     unsigned int totl;      /* number of entries accumulated in history. Maximum is HISTSZ */
     const char *id;         /* ID tag, used for debug */
+    int sub;                /* A parallel sampler, tunes privately and leaves the shared loop count alone */
 } T_FILTER;
  
 
@@ -185,6 +186,16 @@ struct E_SOURCE_t {
   unsigned char nbuf[E_ESTB_BUFLEN]; /*!< I'd rather not do this, but there's a mismatch between what the NIST algs need and what we need later */
   int cnt;              /*!< Number of bytes left in the buffer */
   const char *id;       /*!< Debug string */
+  unsigned char *abuf;  /*!< TRNG_ALT, batched OS entropy, NULL if unbuffered */
+  int acnt;             /*!< TRNG_ALT, unused bytes left in abuf */
+  unsigned long apid;   /*!< TRNG_ALT, process abuf was filled in */
+  struct E_SOURCE_t *psub; /*!< TRNG_FIPS, extra samplers run in parallel, NULL if serial */
+  int pn;               /*!< TRNG_FIPS, number of extra samplers */
+  unsigned char *pbuf;  /*!< TRNG_FIPS, health tested blocks from the extra samplers */
+  int pcnt;             /*!< TRNG_FIPS, blocks left in pbuf */
+  unsigned long ppid;   /*!< TRNG_FIPS, process pbuf was filled in */
+  struct FIPS_WORKERS_t *pw; /*!< TRNG_FIPS, threads running the extra samplers, NULL until first used */
+  unsigned int htretry; /*!< Noise blocks discarded by the health tests, diagnostics only */
 };
 
 
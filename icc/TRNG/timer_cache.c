@@ -0,0 +1,234 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: Persisted timer calibration (shift/loops) for the TRNG
+//
+*************************************************************************/
+
+/*
+  CalcShift() and the TRNG_FIPS loop tuner sample the cycle counter
+  many thousands of times the first time entropy is needed, which
+  short lived processes pay for on every run. The results only depend
+  on the hardware and OS so they can be saved and reused.
+
+  The file is plain text
+
+  # ICC timer calibration cache, regenerate with TimerCal
+  key=<cpu model>|<machine>|<OS> <kernel release>|<ICC version>
+  shift=<n>
+  loops=<n>
+  sum=<FNV-1a of the three lines above>
+
+  - A key mismatch (new CPU, kernel update, new ICC) or a bad sum
+    means the file is ignored and we calibrate as before.
+  - The values are only a starting point. CalcShift() still spot checks
+    the counter and the loop tuner still adapts, and all the health
+    tests are unchanged, a stale or hostile file can at worst cost
+    us the time it was meant to save.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if !defined(_WIN32)
+#include <sys/utsname.h>
+#endif
+#include "iccversion.h"
+#include "TRNG/timer_cache.h"
+
+#define TC_LINELEN 512
+#define TC_HEADER "# ICC timer calibration cache, regenerate with TimerCal\n"
+
+static char tc_path[TIMER_CACHE_PATHLEN] = "";
+
+int SetTimerCache(const char *path)
+{
+  int rv = 0;
+  if (NULL == path) {
+    tc_path[0] = '\0';
+    rv = 1;
+  } else if (strlen(path) < sizeof(tc_path)) {
+    strcpy(tc_path, path);
+    rv = 1;
+  }
+  return rv;
+}
+
+const char *GetTimerCache(void)
+{
+  return ('\0' != tc_path[0]) ? tc_path : NULL;
+}
+
+/*!
+  @brief strip trailing white space and leading "name :"
+  @param s the line, modified in place
+  @return the value part of the line
+*/
+static char *tc_value(char *s)
+{
+  char *p = NULL;
+  int n = 0;
+
+  p = strchr(s, ':');
+  p = (NULL != p) ? p + 1 : s;
+  while ((' ' == *p) || ('\t' == *p)) {
+    p++;
+  }
+  n = (int)strlen(p);
+  while ((n > 0) && ((unsigned char)p[n - 1] <= ' ')) {
+    p[--n] = '\0';
+  }
+  return p;
+}
+
+/*!
+  @brief find a CPU model string
+  @param buf buffer for the model
+  @param len size of buf
+  @note /proc/cpuinfo field names differ by architecture,
+  x86 "model name", Power "cpu", s390 "processor 0", Arm "CPU part"
+*/
+static void tc_cpu(char *buf, int len)
+{
+#if defined(__linux__)
+  static const char *tags[] = {"model name", "cpu\t", "cpu model",
+                               "processor 0", "CPU part", NULL};
+  FILE *fp = NULL;
+  char line[TC_LINELEN];
+  int i = 0;
+
+  fp = fopen("/proc/cpuinfo", "r");
+  if (NULL != fp) {
+    while (('\0' == buf[0]) && (NULL != fgets(line, sizeof(line), fp))) {
+      for (i = 0; NULL != tags[i]; i++) {
+        if (0 == strncmp(line, tags[i], strlen(tags[i]))) {
+          snprintf(buf, len, "%s", tc_value(line));
+          break;
+        }
+      }
+    }
+    fclose(fp);
+  }
+#endif
+  if ('\0' == buf[0]) {
+    snprintf(buf, len, "unknown");
+  }
+}
+
+int TimerCacheKey(char *key, int len)
+{
+  int rv = 0;
+#if !defined(_WIN32)
+  struct utsname u;
+  char cpu[128];
+
+  memset(cpu, 0, sizeof(cpu));
+  if ((NULL != key) && (0 == uname(&u))) {
+    tc_cpu(cpu, sizeof(cpu));
+    if (len > snprintf(key, len, "%s|%s|%s %s|%d.%d.%d.%d", cpu, u.machine,
+                       u.sysname, u.release, ICC_VERSION_VER,
+                       ICC_VERSION_REL, ICC_VERSION_MOD, ICC_VERSION_FIX)) {
+      rv = 1;
+    }
+  }
+#endif
+  return rv;
+}
+
+/*!
+  @brief FNV-1a, detects a damaged or hand edited file, nothing more
+*/
+static unsigned long tc_sum(unsigned long h, const char *s)
+{
+  while ('\0' != *s) {
+    h ^= (unsigned char)*s++;
+    h = (h * 16777619UL) & 0xffffffffUL;
+  }
+  return h;
+}
+
+/*!
+  @brief format the checked part of the file
+*/
+static int tc_body(char *buf, int len, const char *key, int shift, int loops)
+{
+  int n = snprintf(buf, len, "key=%s\nshift=%d\nloops=%d\n", key, shift,
+                   loops);
+  return ((n > 0) && (n < len)) ? 1 : 0;
+}
+
+int TimerCacheRead(const char *path, int *shift, int *loops)
+{
+  int rv = 0;
+  FILE *fp = NULL;
+  char line[TC_LINELEN];
+  char key[TC_LINELEN];
+  char body[TC_LINELEN * 2];
+  char *fkey = NULL;
+  int s = -1, l = -1;
+  unsigned long sum = 0;
+  int have = 0;
+
+  if ((NULL != path) && (NULL != shift) && (NULL != loops) &&
+      TimerCacheKey(key, sizeof(key))) {
+    fp = fopen(path, "r");
+  }
+  if (NULL != fp) {
+    while (NULL != fgets(line, sizeof(line), fp)) {
+      if (0 == strncmp(line, "key=", 4)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (0 == strcmp(line + 4, key)) {
+          fkey = key;
+          have |= 1;
+        }
+      } else if (0 == strncmp(line, "shift=", 6)) {
+        s = atoi(line + 6);
+        have |= 2;
+      } else if (0 == strncmp(line, "loops=", 6)) {
+        l = atoi(line + 6);
+        have |= 4;
+      } else if (0 == strncmp(line, "sum=", 4)) {
+        sum = strtoul(line + 4, NULL, 16);
+        have |= 8;
+      }
+    }
+    fclose(fp);
+    if ((15 == have) && (NULL != fkey) && (s >= 0) && (s <= 16) &&
+        (l >= 0) && (l <= TIMER_CACHE_MAXLOOPS) && tc_body(body, sizeof(body), fkey, s, l) &&
+        (tc_sum(2166136261UL, body) == sum)) {
+      *shift = s;
+      *loops = l;
+      rv = 1;
+    }
+  }
+  return rv;
+}
+
+int TimerCacheWrite(const char *path, int shift, int loops)
+{
+  int rv = 0;
+  FILE *fp = NULL;
+  char key[TC_LINELEN];
+  char body[TC_LINELEN * 2];
+
+  if ((NULL != path) && TimerCacheKey(key, sizeof(key)) &&
+      tc_body(body, sizeof(body), key, shift, loops)) {
+    fp = fopen(path, "w");
+    if (NULL != fp) {
+      if ((EOF != fputs(TC_HEADER, fp)) && (EOF != fputs(body, fp)) &&
+          (0 < fprintf(fp, "sum=%08lx\n", tc_sum(2166136261UL, body)))) {
+        rv = 1;
+      }
+      if (0 != fclose(fp)) {
+        rv = 0;
+      }
+    }
+  }
+  return rv;
+}
@@ -0,0 +1,65 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: Persisted timer calibration (shift/loops) for the TRNG
+//
+*************************************************************************/
+
+#ifndef TIMER_CACHE_H
+#define TIMER_CACHE_H
+
+/*! @brief Longest cache file path we'll accept */
+#define TIMER_CACHE_PATHLEN 1024
+
+/*! @brief Largest loop count any TRNG_FIPS delay table uses,
+    a cached value above this can't have come from the tuner */
+#define TIMER_CACHE_MAXLOOPS 65521
+
+/*!
+  @brief set the timer calibration cache file
+  @param path the file, NULL or "" disables the cache (the default)
+  @return 1 on sucess, 0 if the path is too long
+  @note the library only reads the file, TimerCal writes it
+*/
+int SetTimerCache(const char *path);
+
+/*!
+  @brief return the timer calibration cache file or NULL
+*/
+const char *GetTimerCache(void);
+
+/*!
+  @brief build the key a cache file must match to be used
+  CPU model, OS kernel release and ICC version
+  @param key buffer for the key
+  @param len size of key
+  @return 1 on sucess, 0 if no key is available on this platform
+*/
+int TimerCacheKey(char *key, int len);
+
+/*!
+  @brief read and validate a timer calibration cache file
+  @param path the cache file
+  @param shift returned counter shift
+  @param loops returned sampling loop count
+  @return 1 if the file exists, matches this system, the checksum
+          is correct and the values are in range, 0 otherwise
+*/
+int TimerCacheRead(const char *path, int *shift, int *loops);
+
+/*!
+  @brief write a timer calibration cache file
+  @param path the cache file
+  @param shift counter shift
+  @param loops sampling loop count
+  @return 1 on sucess, 0 otherwise
+*/
+int TimerCacheWrite(const char *path, int shift, int loops);
+
+#endif
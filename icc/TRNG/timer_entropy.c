@@ -12,6 +12,7 @@
 #include <string.h>
 
 #include "TRNG/timer_entropy.h"
+#include "TRNG/timer_cache.h"
 #include "TRNG/looper.h"
 /*! @brief delay loop
     It's in this module exactly because it's not used by any code in here
@@ -25,6 +26,7 @@
 
 int ex_loops = -1;
 int ex_shift = -1;
+int cal_loops = -1;   /* Sampling loops from the calibration cache, used as a starting point */
 
 
 unsigned int shift = 0;
@@ -486,6 +488,57 @@ static int checkShift(int lps,int shft)
 	return prob; /* Probably needs another shift */
 }
 
+/*! @brief try the shift saved in the timer calibration cache
+    One burst of samples (rather than the S_TRY bursts plus the
+    65536 sample checkShift() pass) to confirm the counter is running
+    and that the cached shift still lands on the low moving bits.
+    @param mn minimum shift
+    @return 1 if the cached values were used, 0 if we need a full calibration
+*/
+static int cachedShift(int mn)
+{
+    int rv = 0;
+    int s = -1, l = -1;
+    unsigned int i;
+    ICC_UINT64 X = 0;
+    ICC_UINT64 *XA = NULL;
+
+    if ((NULL != GetTimerCache()) && TimerCacheRead(GetTimerCache(), &s, &l) && (s >= mn))
+    {
+        XA = (ICC_UINT64 *)calloc(SAMPLES, sizeof(ICC_UINT64));
+        if (NULL != XA)
+        {
+            for (i = 0; i < SAMPLES; i++)
+            {
+                XA[i] = RdCTR_raw();
+            }
+            for (i = 0; i < (SAMPLES / 2); i++)
+            {
+                X |= XA[i] ^ XA[SAMPLES - i - 1];
+            }
+            /* CalcShift() picks the lowest pair of moving bits and may
+               add one more, so either is a match.
+            */
+            for (i = mn; i < 16; i++)
+            {
+                if (((unsigned int)X & (1 << i)) && ((unsigned int)X & (1 << (i + 1))))
+                {
+                    break;
+                }
+            }
+            if ((i < 16) && ((s == (int)i) || (s == (int)i + 1)))
+            {
+                timer_ok = 1;
+                shift = s;
+                cal_loops = l;
+                rv = 1;
+            }
+            free(XA);
+        }
+    }
+    return rv;
+}
+
 ICC_UINT64 CalcShift(int mn)
 {
     unsigned int i;
@@ -502,7 +555,7 @@ ICC_UINT64 CalcShift(int mn)
     {
         shift = ex_shift;
     }
-    else
+    else if (!cachedShift((mn > 15 || mn < 0) ? 0 : mn))
     {
         /* Add a sanity check to mn */
         if (mn > 15 || mn < 0)
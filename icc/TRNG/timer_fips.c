@@ -71,6 +71,7 @@ static void printbin( char *s,int l)
 */
 extern int shift_done;           /* Have we run CalcShift() */
 extern int ex_loops;    /* loops set from config file or environment */
+extern int cal_loops;   /* loops from the timer calibration cache */
 static unsigned int loops;       /* loops that we picked, set from here (different in FIPS/non-FIPS modes */
 
 #define PTE 11
@@ -297,6 +298,7 @@ int FIPS_getbytes(E_SOURCE *E, unsigned char *buffer, int len)
     int buckets = 2;
     int count = 0;
     int ecount = 0;
+    unsigned int start = 0;
     T_FILTER *TF = NULL;
     TRNG_ERRORS rv = TRNG_OK;
     
@@ -310,15 +312,36 @@ int FIPS_getbytes(E_SOURCE *E, unsigned char *buffer, int len)
         if (!shift_done)  {
             CalcShift(0);
             shift_done = 1;
+            /* Start the tuner where it settled last time rather than
+               climbing up from the shortest delay. The cache may have
+               been written by a build with the other delay table, so
+               anything outside ours is discarded and we tune from scratch
+            */
+            if ((0 == loops) && (cal_loops >= ptable[0]) &&
+                (cal_loops <= ptable[PTE - 1])) {
+                loops = cal_loops;
+            }
         }
-        if (ex_loops > 0)
+        /* Parallel samplers run on other threads, they keep their
+           own tuning in TF and only the calling thread's sampler
+           reads or updates the shared loop count
+        */
+        if (TF->sub)
         {
-            loops = ex_loops;
+            start = (ex_loops > 0) ? ex_loops : 0;
         }
-        if (loops > 0)
+        else
+        {
+            if (ex_loops > 0)
+            {
+                loops = ex_loops;
+            }
+            start = loops;
+        }
+        if (start > 0)
         {
             for(i = 0; i < PTE; i++) {
-               if(ptable[i] >= loops) {
+               if(ptable[i] >= start) {
                   TF->lindex = i;
                   break;
                }
@@ -365,7 +388,9 @@ int FIPS_getbytes(E_SOURCE *E, unsigned char *buffer, int len)
                     continue;
                 }
             }
-            loops = ptable[TF->lindex];
+            if (!TF->sub) {
+                loops = ptable[TF->lindex];
+            }
 
             /*  We plausibly had outliers in the samples collected, process those as noise 
             The first two sets of data were assumed to be non-noisy 
@@ -376,17 +401,9 @@ int FIPS_getbytes(E_SOURCE *E, unsigned char *buffer, int len)
             At this point our entropy guarantee is still very low, all we are assured of here is that this was gathered from noise events
             Note the slighly improved collection technique.
             */
-           for (i = 0; (count < E_ESTB_BUFLEN) && (i < TF->nnoise); i++)
-            {
-                unsigned char c;
-                c  = ((TF->samples[i]) & 0xff);
-                if(1 == ChkMem(TF,c)) { /* Skip values that were frequent long term */
-                    /* Try and construct a byte of data from what was captured */
-                    buffer[count] = c;
-                    count++;
-                    proc_mem(TF,c); 
-                }    
-            }
+            /* Skip values that were frequent long term, keep the rest */
+            count += filter_mem(TF,TF->samples,TF->nnoise,buffer + count,
+                                E_ESTB_BUFLEN - count);
             if(count == E_ESTB_BUFLEN) {
                 /*! \induced 222. TRNG_FIPS. Fake failure of TRNG source */
                 if(222 == icc_failure) {
@@ -394,6 +411,7 @@ int FIPS_getbytes(E_SOURCE *E, unsigned char *buffer, int len)
                 }
                 if(0 != ht(&(E->hti),buffer) ) {
                     ecount++;
+                    E->htretry++;
                     TF->done = 0;
                     len = 0;
                 }
@@ -0,0 +1,286 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: Shared seed sources for DRBG instances
+//
+*************************************************************************/
+
+/*
+  By default every DRBG (RNG_CTX_new()) creates it's own TRNG, with a
+  conditioner, noise buffers and a deflate based entropy estimator.
+  That's most of the cost of creating a DRBG, in both time and memory,
+  and processes which keep thousands of them pay it thousands of times.
+
+  With ICC_TRNG_POOL=n, n TRNG's are created once and DRBG's created
+  afterwards draw their seeds from them instead.
+
+  - Each seed request goes to the pool member for the CPU we are
+    running on, under that member's lock. Requests on different CPU's
+    don't contend.
+  - Each request is a separate TRNG_GenerateRandomSeed() call, the
+    health tests, conditioning, long term entropy and duplicate checks
+    are exactly those a private TRNG would apply.
+  - A pool member is replaced if the global TRNG type changes, as a
+    private TRNG would be.
+  - A fork()ed child never uses the pool, the locks may have been held
+    when we forked and the members hold the parent's noise. DRBG's in
+    the child create their own TRNG on next seed.
+  - Requests check the pool and are counted in and out under pool_mtx
+    so TRNG_PoolStop() can refuse new ones and wait for those in flight
+    before it frees the members. That lock is only held to adjust the
+    count, never while gathering entropy, and it's never destroyed so
+    a late caller always finds it intact.
+*/
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* sched_getcpu() */
+#endif
+#include <stdio.h>
+#include "icclib.h"
+#include "platform.h"
+#include "platform_api.h"
+#include "tracer.h"
+#include "TRNG/ICC_NRBG.h"
+#include "TRNG/trng_pool.h"
+#if defined(__linux__)
+#include <sched.h>
+#endif
+#if !defined(_WIN32)
+#include <time.h>
+#endif
+
+typedef struct {
+  ICC_Mutex mtx;  /*!< Protects trng */
+  TRNG *trng;     /*!< This member's seed source */
+} POOL_MEMBER;
+
+static int pool_size = 0;              /*!< Configured size, 0 == off */
+static POOL_MEMBER *pool = NULL;       /*!< The pool */
+static int pool_n = 0;                 /*!< Members in use */
+static DWORD pool_pid = 0;             /*!< Process the pool belongs to */
+static ICC_Mutex pool_mtx;             /*!< Protects pool, pool_busy and pool_stopping */
+static int pool_mtx_valid = 0;         /*!< pool_mtx exists, it's never destroyed */
+static int pool_busy = 0;              /*!< Requests in flight */
+static int pool_stopping = 0;          /*!< TRNG_PoolStop() has started */
+
+int SetTRNGPool(int n)
+{
+  int rv = 0;
+  if ((NULL == pool) && (n >= 0) && (n <= TRNG_POOL_MAX)) {
+    pool_size = n;
+    rv = 1;
+  }
+  return rv;
+}
+
+int GetTRNGPool(void)
+{
+  return pool_size;
+}
+
+/*!
+  @brief pick a pool member, by CPU where we can find that
+  @return index into pool
+*/
+static int pool_member(void)
+{
+  int cpu = -1;
+#if defined(__linux__)
+  cpu = sched_getcpu();
+#elif defined(_WIN32)
+  cpu = (int)GetCurrentProcessorNumber();
+#endif
+  if (cpu < 0) {
+    cpu = (int)ICC_GetThreadId();
+  }
+  return (int)((unsigned int)cpu % (unsigned int)pool_n);
+}
+
+int TRNG_PoolStart(void)
+{
+  int ok = 0;
+  int i = 0;
+
+  if (!pool_mtx_valid && (0 != pool_size)) {
+    if (0 == ICC_CreateMutex(&pool_mtx)) {
+      pool_mtx_valid = 1;
+    }
+  }
+  if ((0 != pool_size) && (NULL == pool) && pool_mtx_valid) {
+    /* No requests until the pool is complete and pool_pid is ours */
+    pool_pid = 0;
+    pool_busy = 0;
+    pool_stopping = 0;
+    pool = (POOL_MEMBER *)ICC_Calloc(pool_size, sizeof(POOL_MEMBER), __FILE__, __LINE__);
+    if (NULL != pool) {
+      for (i = 0; i < pool_size; i++) {
+        pool[i].trng = TRNG_new(GetDefaultTrng());
+        if (NULL == pool[i].trng) {
+          break;
+        }
+        if (0 != ICC_CreateMutex(&(pool[i].mtx))) {
+          TRNG_free(pool[i].trng);
+          pool[i].trng = NULL;
+          break;
+        }
+      }
+      pool_n = i;
+      if (pool_n == pool_size) {
+        ok = 1;
+      } else {
+        TRNG_PoolStop();
+      }
+    }
+    if (ok) {
+      pool_pid = ICC_GetProcessId();
+      MARK("TRNG pool started", "");
+    }
+  }
+  return ok;
+}
+
+/*!
+  @brief wait a little for in flight requests to finish
+*/
+static void pool_nap(void)
+{
+#if defined(_WIN32)
+  Sleep(1);
+#else
+  struct timespec ts = {0, 1000000L};
+  nanosleep(&ts, NULL);
+#endif
+}
+
+void TRNG_PoolStop(void)
+{
+  int i = 0;
+  int busy = 0;
+
+  if (NULL != pool) {
+    /* Refuse new requests, then wait out any already using a member.
+       A fork()ed child never makes requests but may have inherited
+       a count, or the lock held, from the parent's threads, it
+       has nothing to wait for
+    */
+    if (ICC_GetProcessId() == pool_pid) {
+      ICC_LockMutex(&pool_mtx);
+      pool_stopping = 1;
+      ICC_UnlockMutex(&pool_mtx);
+      do {
+        ICC_LockMutex(&pool_mtx);
+        busy = pool_busy;
+        ICC_UnlockMutex(&pool_mtx);
+        if (0 != busy) {
+          pool_nap();
+        }
+      } while (0 != busy);
+    } else {
+      pool_stopping = 1;
+    }
+    for (i = 0; i < pool_n; i++) {
+      ICC_DestroyMutex(&(pool[i].mtx));
+      TRNG_free(pool[i].trng);
+      pool[i].trng = NULL;
+    }
+    ICC_Free(pool);
+    pool = NULL;
+    pool_n = 0;
+  }
+}
+
+/*!
+  @brief register a request against the pool
+  @return 1 if the pool is usable and pool_leave() must follow, 0 otherwise
+  @note a fork()ed child is refused before it touches pool_mtx,
+        the parent may have held it when we forked
+*/
+static int pool_enter(void)
+{
+  int rv = 0;
+
+  if (pool_mtx_valid && (ICC_GetProcessId() == pool_pid)) {
+    ICC_LockMutex(&pool_mtx);
+    if ((NULL != pool) && !pool_stopping) {
+      pool_busy++;
+      rv = 1;
+    }
+    ICC_UnlockMutex(&pool_mtx);
+  }
+  return rv;
+}
+
+/*!
+  @brief end a request started with pool_enter()
+*/
+static void pool_leave(void)
+{
+  ICC_LockMutex(&pool_mtx);
+  pool_busy--;
+  ICC_UnlockMutex(&pool_mtx);
+}
+
+int TRNG_PoolAvail(void)
+{
+  int rv = 0;
+
+  if (pool_enter()) {
+    rv = 1;
+    pool_leave();
+  }
+  return rv;
+}
+
+TRNG_ERRORS TRNG_PoolGenerateRandomSeed(int seedLength, void *seed)
+{
+  TRNG_ERRORS rv = TRNG_INIT;
+  POOL_MEMBER *m = NULL;
+  TRNG_TYPE type;
+
+  if (pool_enter()) {
+    m = &pool[pool_member()];
+    ICC_LockMutex(&(m->mtx));
+    /* Follow the global TRNG type, as private TRNG's do */
+    type = GetDefaultTrng();
+    if ((NULL != m->trng) && (TRNG_type(m->trng) != type)) {
+      TRNG_free(m->trng);
+      m->trng = NULL;
+    }
+    if (NULL == m->trng) {
+      m->trng = TRNG_new(type);
+    }
+    if (NULL != m->trng) {
+      rv = TRNG_GenerateRandomSeed(m->trng, seedLength, seed);
+    }
+    ICC_UnlockMutex(&(m->mtx));
+    pool_leave();
+  }
+  return rv;
+}
+
+int TRNG_PoolEntropy(void)
+{
+  int rv = 0;
+  int e = 0;
+  int i = 0;
+
+  if (pool_enter()) {
+    for (i = 0; i < pool_n; i++) {
+      ICC_LockMutex(&(pool[i].mtx));
+      e = GetEntropy(pool[i].trng);
+      ICC_UnlockMutex(&(pool[i].mtx));
+      /* 0 is a member that hasn't been used yet, no estimate */
+      if ((e > 0) && ((0 == rv) || (e < rv))) {
+        rv = e;
+      }
+    }
+    pool_leave();
+  }
+  return rv;
+}
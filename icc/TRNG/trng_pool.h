@@ -0,0 +1,70 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: Shared seed sources for DRBG instances
+//
+*************************************************************************/
+
+#ifndef TRNG_POOL_H
+#define TRNG_POOL_H
+
+/*! @brief Largest seed source pool we'll create */
+#define TRNG_POOL_MAX 64
+
+/*!
+  @brief set the number of shared seed sources
+  @param n pool size, 0 disables it (the default), every DRBG then
+         has it's own TRNG
+  @return 1 on sucess, 0 otherwise
+  @note this must be called before the first ICC_Attach()
+*/
+int SetTRNGPool(int n);
+
+/*!
+  @brief return the configured seed source pool size
+*/
+int GetTRNGPool(void);
+
+/*!
+  @brief create the pool if one is configured
+  @return 1 if it's usable, 0 otherwise
+  @note Failure isn't fatal, DRBG's then create their own TRNG
+*/
+int TRNG_PoolStart(void);
+
+/*!
+  @brief free the pool's TRNG's
+*/
+void TRNG_PoolStop(void);
+
+/*!
+  @brief can the pool be used from this process ?
+  @return 1 if the pool is running and we aren't a fork()ed child
+*/
+int TRNG_PoolAvail(void);
+
+/*!
+  @brief
+  Seed data from the pool member for the current CPU
+  @param seedLength the number of bytes requested
+  @param seed a pointer to the buffer to fill
+  @return TRNG_OK on sucess, error indication otherwise
+  @note each call is a separate request to a health tested NRBG,
+  exactly as TRNG_GenerateRandomSeed() on a private TRNG
+*/
+TRNG_ERRORS TRNG_PoolGenerateRandomSeed(int seedLength, void *seed);
+
+/*!
+  @brief the lowest running entropy estimate of the pool members
+  which have generated data
+  @return entropy estimate, 0 if there isn't one yet or the pool isn't usable
+*/
+int TRNG_PoolEntropy(void);
+
+#endif
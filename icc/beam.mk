@@ -20,7 +20,7 @@ all: icc.beam icclib.beam fips.beam status.beam \
 	fips-prng/SP800-90HashData.beam fips-prng/SP800-90Cipher.beam \
 	fips-prng/SP800-90TRNG.beam fips-prng/fips-dss-prng.beam \
 	fips-prng/fips-prng-RAND.beam fips-prng/fips-prng-err.beam \
-	fips-prng/ds.beam fips-prng/utils.beam
+	fips-prng/ds.beam fips-prng/utils.beam fips-prng/hashgen.beam
 
 .SUFFIXES: .beam .c
 
@@ -58,6 +58,8 @@ fips-prng/SP800-90Cipher.beam: fips-prng/SP800-90Cipher.c
 
 fips-prng/SP800-90HashData.beam: fips-prng/SP800-90HashData.c
 
+fips-prng/hashgen.beam: fips-prng/hashgen.c
+
 fips-prng/fips-dss-prng.beam: fips-prng/fips-dss-prng.c
 
 fips-prng/fips-prng-RAND.beam: fips-prng/fips-prng-RAND.c
@@ -20,17 +20,17 @@ Delta_test$(OBJSUFX): DELTA/Delta_test.c
 #- Build test code
 
 Delta_test$(EXESUFX): delta$(OBJSUFX) Delta_test$(OBJSUFX) \
-		high_res_timer$(OBJSUFX)  iccstub$(OBJSUFX) \
+		high_res_timer$(OBJSUFX) timer_cache$(OBJSUFX) iccstub$(OBJSUFX) \
 		looper$(OBJSUFX) $(ASMOBJS)
 	$(LD) $(LDFLAGS) delta$(OBJSUFX) Delta_test$(OBJSUFX) \
-		high_res_timer$(OBJSUFX)  iccstub$(OBJSUFX) \
+		high_res_timer$(OBJSUFX) timer_cache$(OBJSUFX) iccstub$(OBJSUFX) \
 		 $(ASMOBJS) looper$(OBJSUFX) $(LDLIBS)
 
 $(SHLPRFX)delta$(SHLSUFX):  delta$(OBJSUFX) \
-		high_res_timer$(OBJSUFX) iccstub$(OBJSUFX) \
+		high_res_timer$(OBJSUFX) timer_cache$(OBJSUFX) iccstub$(OBJSUFX) \
 	 	looper$(OBJSUFX) $(ASMOBJS)
 	$(SLD)  $(SLDFLAGS) delta$(OBJSUFX) \
-		high_res_timer$(OBJSUFX) iccstub$(OBJSUFX) \
+		high_res_timer$(OBJSUFX) timer_cache$(OBJSUFX) iccstub$(OBJSUFX) \
 		looper$(OBJSUFX) $(ASMOBJS) \
 	$(EXPORT_FLAG)DELTA/$(ICCLIB_EXPFILE)
 	$(CP) $@ ../package/iccsdk/$@
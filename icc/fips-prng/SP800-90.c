@@ -38,6 +38,13 @@
 #pragma comment(lib, "Ws2_32.lib")
 #else
 #include <arpa/inet.h>
+#include <time.h>
+#endif
+#if defined(__linux)
+#include <sys/mman.h>
+#if defined(MADV_WIPEONFORK)
+#define FORK_WIPE 1
+#endif
 #endif
 #include "icclib.h"
 #include "ds.h"
@@ -47,6 +54,8 @@
 #include "status.h"
 #include "utils.h"
 #include "TRNG/ICC_NRBG.h"
+#include "TRNG/entropy_reservoir.h"
+#include "TRNG/trng_pool.h"
 #include "induced.h"
 
 
@@ -59,6 +68,84 @@ extern SP800_90STATE TRNG_Inst_Type(PRNG_CTX *ctx,
 
 static const char C01[4] = {0x00,0x00,0x00,0x01};
 
+#if defined(FORK_WIPE)
+/*! 
+  fork() detection without a syscall per generate.
+  A page marked MADV_WIPEONFORK reads as zero in a fork()ed child,
+  it holds the current fork generation. 
+  pthread_atfork() would do the same job on more platforms but the
+  handler can't be removed and ICC is unloaded by the stub library.
+*/
+static volatile unsigned int *fork_page = NULL;
+static size_t fork_page_size = 0;
+/*! Source of new fork generations, unlike fork_page this is inherited */
+static unsigned int fork_counter = 0;
+#endif
+
+/*!
+  @brief set up fork() detection
+  @note called once, while we are single threaded
+*/
+static void ForkDetectInit(void)
+{
+#if defined(FORK_WIPE)
+  void *p = NULL;
+
+  fork_page_size = (size_t)sysconf(_SC_PAGESIZE);
+  p = mmap(NULL, fork_page_size, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (MAP_FAILED != p) {
+    /* Fails with EINVAL on kernels prior to 4.14 */
+    if (0 == madvise(p, fork_page_size, MADV_WIPEONFORK)) {
+      fork_counter = 1;
+      *(unsigned int *)p = fork_counter;
+      fork_page = (volatile unsigned int *)p;
+    } else {
+      munmap(p, fork_page_size);
+    }
+  }
+#endif
+}
+
+/*!
+  @brief release the fork() detection page
+*/
+static void ForkDetectCleanup(void)
+{
+#if defined(FORK_WIPE)
+  if (NULL != fork_page) {
+    munmap((void *)fork_page, fork_page_size);
+    fork_page = NULL;
+  }
+#endif
+}
+
+/*!
+  @brief return the process fork() generation
+  @return the generation, changes in a fork()ed child,
+          0 if unavailable and the caller must compare PID's
+*/
+static unsigned int ForkGeneration(void)
+{
+  unsigned int g = 0;
+#if defined(FORK_WIPE)
+  if (NULL != fork_page) {
+    g = *fork_page;
+    if (0 == g) {
+      /* First check in a new child, allocate it a generation.
+         Threads racing here at worst force an extra reseed.
+      */
+      do {
+        g = __sync_add_and_fetch(&fork_counter, 1);
+      } while (0 == g);
+      (void)__sync_bool_compare_and_swap(fork_page, 0, g);
+      g = *fork_page;
+    }
+  }
+#endif
+  return g;
+}
+
 /*! \IMPLEMENT SP800-90 Implementation
   The SP800_90 code is an API for RNG's, not just an
   implementation of the SP800_90 standard.
@@ -224,6 +311,26 @@ static unsigned char kabuf[1024];
 
 extern int error_state;
 
+/*! \FIPS Deferred periodic self test, ICC_RNG_TEST_THREAD
+  By default the periodic retest runs inline in RNG_CTX_Init(),
+  all strengths, for the caller which creates the SELF_TEST_AT'th
+  instance of a type.
+  With deferral enabled the RNG maintenance thread retests types
+  shortly before they are due (PRNG_TestDue()), so the counter is
+  reset before callers reach it. RNG_CTX_Init() still runs the
+  test inline, blocking that caller, when
+  - the type has never been tested, first use is always tested
+  - the last self test of the type failed
+  - the test is overdue by more than TEST_GRACE instantiations,
+    i.e. the thread isn't keeping up
+  - we are a fork()ed child, the thread isn't running here
+*/
+#define TEST_EARLY(at) ((at) >> 3) /*!< Instantiations before due we retest at */
+#define TEST_GRACE(at) ((at) >> 2) /*!< Instantiations past due before we block */
+
+static int test_deferred = 0; /*!< PRNG_TestDue() is being called */
+static DWORD test_pid = 0;    /*!< The process which enabled deferral */
+
 
 
 /*!
@@ -282,18 +389,21 @@ const char **get_SP800_90FIPS(void) {
         }
       }
 
-      if (exclude) {
-        continue;
-      }
       /* This is opportunistic, create the per-type mutex
-         here when we are already single threaded
+         here when we are already single threaded. Excluded types
+         get one too, PRNG_TestDue() locks every type and
+         CleanupSP800_90() destroys them all
       */
       ICC_CreateMutex(&(PRNG_list[i]->mtx));
+      if (exclude) {
+        continue;
+      }
       if (SP800_IS_FIPS == PRNG_list[i]->FIPS) {
         FIPS_rng_list[j] = (char *)PRNG_list[i]->prngname;
         j++;
       }
     }
+    ForkDetectInit();
     initialized = 1;
   }
   return (const char **)FIPS_rng_list;
@@ -316,7 +426,27 @@ TRNG_ERRORS PRNG_GenerateRandomSeed(PRNG_CTX *P, unsigned int n,
     prng->error_reason = ERRAT("0 bytes is not a valid entropy request");
     rv = TRNG_REQ_SIZE;
   } else {
-    rv = TRNG_GenerateRandomSeed(prng->trng, n, buf);
+    if (prng->shared && !TRNG_PoolAvail()) {
+      /* The pool was stopped, or we are a fork()ed child,
+         use our own seed source from now on
+      */
+      prng->trng = TRNG_new(GetDefaultTrng());
+      prng->shared = 0;
+    }
+    /* Pre-harvested entropy if there's any from the TRNG type
+       we'd use, otherwise gather it now
+    */
+    if (prng->shared) {
+      if (!TRNG_ReservoirTake(GetDefaultTrng(), buf, n)) {
+        rv = TRNG_PoolGenerateRandomSeed(n, buf);
+      }
+    } else if (NULL != prng->trng) {
+      if (!TRNG_ReservoirTake(TRNG_type(prng->trng), buf, n)) {
+        rv = TRNG_GenerateRandomSeed(prng->trng, n, buf);
+      }
+    } else {
+      rv = TRNG_INIT;
+    }
     /** \induced 401: Simulate a one off TRNG failure,
         force test case to fail, triggering this error path
         and recovery
@@ -356,6 +486,7 @@ void CleanupSP800_90()
      */
     ICC_DestroyMutex(&(PRNG_list[i]->mtx));
   }
+  ForkDetectCleanup();
 }
 
 /*!
@@ -414,7 +545,7 @@ static unsigned NeededBytes(SP800_90PRNG_Data_t *ictx)
     /* Pull enough bytes to compensate for the entropy 
        guarantee of the source
     */
-    if(ictx->trng) {
+    if(ictx->trng || ictx->shared) {
       l = ictx->minEnt * GetDesignEntropy(ictx->trng);
     } else {
       /* Some modes use the PRNG as a conditioner
@@ -471,6 +602,8 @@ void PRNG_free_scratch(unsigned char **ein,
   @param person a pointer to the personalization data
   @param perl a pointer to the length of the personalization data
   @param flags a pointer to the flags used to track data we've allocated
+  @param scratch EBUF_SIZE bytes used for the entropy input if none was
+  provided, the caller scrubs it
   @return SP800_90STATE , normally SP800_90INIT
   @note In normal use we'd expect to arrive here with ein,einl, nonce, nonl 
   as NULL,0,NULL,0. But during testing we call the functions embedded in the
@@ -484,7 +617,7 @@ SP800_90STATE PRNG_Instantiate(SP800_90PRNG_Data_t *ctx,
 			       unsigned char **ein, unsigned int *einl,
 			       unsigned char **nonce, unsigned int *nonl,
 			       unsigned char **person,unsigned int *perl,
-			       unsigned int *flags)
+			       unsigned int *flags, unsigned char *scratch)
 {
   switch(ctx->state) {
   case SP800_90INIT:
@@ -508,9 +641,9 @@ SP800_90STATE PRNG_Instantiate(SP800_90PRNG_Data_t *ctx,
      ) {
 
     ctx->Auto = 1; /* Enable autoreseed by default */
-    /* Note we DON'T set the alloc flag here, we reuse ctx->eBuf for this
-       if we aren't being driven in formal test mode.
-       and eBuf is erased once the data is consumed.
+    /* Note we DON'T set the alloc flag here, we use the caller's scratch
+       buffer for this if we aren't being driven in formal test mode.
+       and scratch is erased once the data is consumed.
     */
     /*! \FIPS  VE07.09.01 
       - Entropy and Nonce ("Seed key" and "Seed") are obtained
@@ -530,7 +663,7 @@ SP800_90STATE PRNG_Instantiate(SP800_90PRNG_Data_t *ctx,
       \FIPS SP800-90, Entropy input: Section 8.6.3
     */
     if (NULL == *ein) {
-      *ein = ctx->eBuf;
+      *ein = scratch;
       *einl = NeededBytes(ctx);
       if (TRNG_OK != PRNG_GenerateRandomSeed((PRNG_CTX *)ctx, *einl, *ein)) {
         ctx->state = SP800_90ERROR;
@@ -609,6 +742,100 @@ SP800_90STATE PRNG_Instantiate(SP800_90PRNG_Data_t *ctx,
   return ctx->state;
 }
 
+unsigned int PRNG_StateSize(SP800_90PRNG_t *prng, unsigned int *k,
+                            unsigned int *v, unsigned int *c,
+                            unsigned int *t)
+{
+  unsigned int K = 0, V = 0, C = 0, T = 0;
+
+  if (NULL != prng) {
+    switch (prng->type) {
+    case SP800_SHA1:
+    case SP800_SHA224:
+    case SP800_SHA256:
+    case SP800_SHA384:
+    case SP800_SHA512:
+      /* V,C retained, T holds V during generate */
+      V = C = T = prng->seedlen;
+      break;
+    case SP800_HMAC_SHA1:
+    case SP800_HMAC_SHA224:
+    case SP800_HMAC_SHA256:
+    case SP800_HMAC_SHA384:
+    case SP800_HMAC_SHA512:
+      K = V = prng->OBL;
+      break;
+    case SP800_CTR_3DES:
+    case SP800_CTR_AES128:
+    case SP800_CTR_AES192:
+    case SP800_CTR_AES256:
+      /* seedlen is keylen + OBL. Cipher_df() and Update() write
+         whole blocks to C and T
+      */
+      K = prng->seedlen - prng->OBL;
+      V = prng->OBL;
+      C = T = BlocksReqd(prng->seedlen, prng->OBL) * prng->OBL;
+      break;
+    default: /* TRNG's */
+      break;
+    }
+  }
+  if (NULL != k) {
+    *k = K;
+  }
+  if (NULL != v) {
+    *v = V;
+  }
+  if (NULL != c) {
+    *c = C;
+  }
+  if (NULL != t) {
+    *t = T;
+  }
+  return K + V + C + T;
+}
+
+/*!
+  @brief (re)size the working state for the context's DRBG mode
+  and point K,V,C,T into it
+  @param ictx the context, ictx->prng set
+  @return 1 on success, 0 if the allocation failed
+  @note the old state is scrubbed before it's released, it's only
+  reallocated if the mode needs a different size
+*/
+static int PRNG_State(SP800_90PRNG_Data_t *ictx)
+{
+  unsigned int k = 0, v = 0, c = 0, t = 0, n = 0;
+  int rv = 1;
+
+  n = PRNG_StateSize(ictx->prng, &k, &v, &c, &t);
+  if (n != ictx->stl) {
+    if (NULL != ictx->st) {
+      memset(ictx->st, 0, ictx->stl);
+      ICC_Free(ictx->st);
+    }
+    ictx->st = NULL;
+    ictx->stl = 0;
+    if (n > 0) {
+      ictx->st = (unsigned char *)ICC_Calloc(1, n, __FILE__, __LINE__);
+      if (NULL != ictx->st) {
+        ictx->stl = n;
+      } else {
+        rv = 0;
+      }
+    }
+  }
+  if (rv && (NULL != ictx->st)) {
+    ictx->K = k ? ictx->st : NULL;
+    ictx->V = v ? ictx->st + k : NULL;
+    ictx->C = c ? ictx->st + k + v : NULL;
+    ictx->T = t ? ictx->st + k + v + c : NULL;
+  } else {
+    ictx->K = ictx->V = ictx->C = ictx->T = NULL;
+  }
+  return rv;
+}
+
 /*! 
   @brief check that a memory area is zero'd 
   @param where The location to check
@@ -838,11 +1065,21 @@ void Cln(PRNG_CTX *ctx)
   SP800_90PRNG_Data_t *ictx = (SP800_90PRNG_Data_t *)ctx;
   SP800_90PRNG_t *prng = ictx->prng;
   TRNG *trng = ictx->trng;
+  unsigned char *st = ictx->st;
+  unsigned int stl = ictx->stl;
+  int shared = ictx->shared;
   ictx->trng = NULL;
   prng->Cleanup(ctx);
+  if (NULL != st) {
+    memset(st, 0, stl);
+  }
   memset(ictx,0,sizeof(SP800_90PRNG_Data_t));
   ictx->prng = prng;
   ictx->trng = trng;
+  ictx->shared = shared;
+  ictx->st = st;
+  ictx->stl = stl;
+  PRNG_State(ictx);
   ictx->state = SP800_90UNINIT;
 }
 /*!
@@ -854,9 +1091,30 @@ void Cln(PRNG_CTX *ctx)
   @param alg a PRNG algorithm
 */
 #define TEST_OUT_SIZE 1024
+
+/*!
+  @brief monotonic clock, used to time the self test
+  @return microseconds from an arbitrary start point
+*/
+static ICC_UINT64 test_clock_us(void)
+{
+#if defined(_WIN32)
+  LARGE_INTEGER f, c;
+  QueryPerformanceFrequency(&f);
+  QueryPerformanceCounter(&c);
+  return (ICC_UINT64)((c.QuadPart / f.QuadPart) * 1000000 +
+                      ((c.QuadPart % f.QuadPart) * 1000000) / f.QuadPart);
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (ICC_UINT64)ts.tv_sec * 1000000 + (ICC_UINT64)(ts.tv_nsec / 1000);
+#endif
+}
+
 void PRNG_self_test(PRNG_CTX *ctx, PRNG *alg)
 {
   int i;
+  ICC_UINT64 t0 = test_clock_us();
   unsigned char *out = NULL;
   SP800_90PRNG_Data_t *ictx = (SP800_90PRNG_Data_t *)ctx;
   SP800_90PRNG_t *prng = NULL;
@@ -944,7 +1202,9 @@ void PRNG_self_test(PRNG_CTX *ctx, PRNG *alg)
           ictx->prng->Cln(ctx);
           ictx->state = SP800_90CRIT;
           ictx->error_reason = reason;
+          ICC_LockMutex(&(ictx->prng->mtx));
           ictx->prng->error = 1; /* 40770 make self test errors sticky */
+          ICC_UnlockMutex(&(ictx->prng->mtx));
         }
         else
         {
@@ -954,21 +1214,21 @@ void PRNG_self_test(PRNG_CTX *ctx, PRNG *alg)
           /** \induced 404: Simulate a failure of the PRNG cleanup function,
             make some of the data that should have been zero'd non-zero
         */
-          if (404 == icc_failure)
+          if ((404 == icc_failure) && (NULL != ictx->st))
           {
-            ictx->eBuf[5] = 0x42;
+            ictx->st[ictx->stl - 1] = 0x42;
           }
-          if (NotZero(ictx->K, MAX_K) || NotZero(ictx->V, MAX_V) ||
-              NotZero(ictx->C, MAX_C) || NotZero(ictx->T, MAX_T) ||
-              NotZero(ictx->eBuf, EBUF_SIZE) || (ictx->SecStr != 0) ||
+          if (NotZero(ictx->st, ictx->stl) || (ictx->SecStr != 0) ||
               (ictx->ReseedAt != 0) || (ictx->Paranoid != 0) ||
               (ictx->minEnt != 0) || (ictx->CallCount.u != 0) ||
-              (ictx->ctx.cctx != NULL))
+              (ictx->ctx.cctx != NULL) || (ictx->dfctx != NULL))
           {
             SetFatalError("PRNG context cleanup failed", __FILE__, __LINE__);
             ictx->state = SP800_90CRIT;
             ictx->error_reason = ERRAT("PRNG context cleanup filed");
+            ICC_LockMutex(&(ictx->prng->mtx));
             ictx->prng->error = 1; /* 40770 make self test errors sticky */
+            ICC_UnlockMutex(&(ictx->prng->mtx));
           }
           else
           {
@@ -982,6 +1242,8 @@ void PRNG_self_test(PRNG_CTX *ctx, PRNG *alg)
       ictx->TestMode = 0;
       ICC_LockMutex(&(ialg->mtx));
       ialg->last_tested_at = ialg->test_at;
+      ialg->tested = 1;
+      ialg->test_us = (unsigned int)(test_clock_us() - t0);
       ICC_UnlockMutex(&(ialg->mtx));
       ICC_Free(out);
       out = NULL;
@@ -993,6 +1255,58 @@ void PRNG_self_test(PRNG_CTX *ctx, PRNG *alg)
     }
   }
 }
+
+void PRNG_SetTestDeferred(int on)
+{
+  test_pid = ICC_GetProcessId();
+  test_deferred = (0 != on) ? 1 : 0;
+}
+
+/*!
+  @brief can RNG_CTX_Init() leave a due self test to PRNG_TestDue() ?
+  @param p the DRBG type
+  @param count the type's retest counter after this instantiation
+  @return 1 if the caller needn't test inline
+  @note call with p->mtx held
+*/
+static int PRNG_TestDeferred(SP800_90PRNG_t *p, int count)
+{
+  return (test_deferred && p->tested && (0 == p->error) &&
+          (count > -TEST_GRACE(p->test_at)) &&
+          (ICC_GetProcessId() == test_pid)) ? 1 : 0;
+}
+
+void PRNG_TestDue(void)
+{
+  int i = 0;
+  int due = 0;
+  SP800_90PRNG_t *p = NULL;
+  SP800_90PRNG_Data_t *ictx = NULL;
+
+  for (i = 0; NULL != PRNG_list[i]; i++) {
+    p = PRNG_list[i];
+    if (p->type & IS_TRNG) {
+      continue;
+    }
+    /* Types not yet used (and so tested) inline are left alone.
+       Failed types are retested inline by the next caller.
+    */
+    ICC_LockMutex(&(p->mtx));
+    due = (p->tested && (0 == p->error) &&
+           (p->last_tested_at <= TEST_EARLY(p->test_at))) ? 1 : 0;
+    ICC_UnlockMutex(&(p->mtx));
+    if (due) {
+      ictx = (SP800_90PRNG_Data_t *)RNG_CTX_new_no_TRNG();
+      if (NULL != ictx) {
+        ictx->prng = p;
+        if (PRNG_State(ictx)) {
+          PRNG_self_test((PRNG_CTX *)ictx, (PRNG *)p);
+        }
+        RNG_CTX_free((PRNG_CTX *)ictx);
+      }
+    }
+  }
+}
 /* Note, the reason for the ef functions here is to create an 
    OpenSSL callable set of interfaces. We delegate ICC/FIPS 
    error handling to the META layer as we want to plug these PRNG's
@@ -1106,13 +1420,17 @@ PRNG_CTX *RNG_CTX_new_no_TRNG()
 /*!
   @brief allocate a new PRNG_CTX
   @return a PRNG_CTX or NULL
+  @note if the shared TRNG pool is running (ICC_TRNG_POOL) the
+  new context is seeded from that rather than it's own TRNG
 */
 
 PRNG_CTX *RNG_CTX_new() 
 {
   SP800_90PRNG_Data_t  * ctx = NULL;
   ctx = (SP800_90PRNG_Data_t  *)RNG_CTX_new_no_TRNG();
-  if(NULL != ctx) {
+  if((NULL != ctx) && TRNG_PoolAvail()) {
+    ctx->shared = 1;
+  } else if(NULL != ctx) {
     /* And attach it to it's own TRNG of the default type */
     if(NULL != ctx->trng) {
       TRNG_free(ctx->trng);
@@ -1166,14 +1484,18 @@ SP800_90STATE RNG_CTX_Init(PRNG_CTX *ctx, PRNG *alg, unsigned char *person,
   TRNG_TYPE T;
   TRNG_ERRORS e;
   SP800_90STATE state = SP800_90CRIT;
+  unsigned char ebuf[EBUF_SIZE];
   /* Allow reinitialization at any point,
      provided there wasn't a critical failure
   */
 
   if(NULL != ictx && NULL != ialg && ( IS_TRNG & ialg->type) ) { /* If it's a TRNG test tap, just create it */         
     ictx->prng = ialg;
-    if (SP800_90INIT == PRNG_Instantiate(ictx, &ein, &einl, &nonce, &nonl,
-                                               &person, &personal, &flags)) {
+    if (!PRNG_State(ictx)) {
+      ictx->state = SP800_90CRIT;
+      ictx->error_reason = ERRAT("Could not allocate memory for the DRBG state");
+    } else if (SP800_90INIT == PRNG_Instantiate(ictx, &ein, &einl, &nonce, &nonl,
+                                               &person, &personal, &flags, ebuf)) {
             /* Call the Instantiate function */
       ictx->prng->Inst(ctx, ein, einl, nonce, nonl, person, personal);
       T = typeofTRNG(ialg->type);
@@ -1195,6 +1517,11 @@ SP800_90STATE RNG_CTX_Init(PRNG_CTX *ctx, PRNG *alg, unsigned char *person,
     default:
       if ((NULL != ctx) && (NULL != alg)) {
         ictx->prng = (SP800_90PRNG_t *)alg;
+        if (!PRNG_State(ictx)) {
+          ictx->state = SP800_90CRIT;
+          ictx->error_reason = ERRAT("Could not allocate memory for the DRBG state");
+          break;
+        }
         if (personal > ictx->prng->maxPers) {
           ictx->state = SP800_90PARAM;
           ictx->error_reason = ERRAT(SP800_90_EXCESS_TOTAL);
@@ -1208,6 +1535,9 @@ SP800_90STATE RNG_CTX_Init(PRNG_CTX *ctx, PRNG *alg, unsigned char *person,
         ICC_LockMutex(&(ialg->mtx));
         ialg->last_tested_at--; /* Update the self test counter */
         i = ialg->last_tested_at;
+        if ((i <= 0) && PRNG_TestDeferred(ialg, i)) {
+          i = 1; /* The test thread will get to it */
+        }
         ICC_UnlockMutex(&(ialg->mtx));
 
         if (i <= 0) {
@@ -1251,10 +1581,11 @@ SP800_90STATE RNG_CTX_Init(PRNG_CTX *ctx, PRNG *alg, unsigned char *person,
              Checks the buffer lengths here if they were passed in ..
           */
           if (SP800_90INIT == PRNG_Instantiate(ictx, &ein, &einl, &nonce, &nonl,
-                                               &person, &personal, &flags)) {
+                                               &person, &personal, &flags, ebuf)) {
             /* Call the Instantiate function */
             ictx->prng->Inst(ctx, ein, einl, nonce, nonl, person, personal);
           }
+          memset(ebuf, 0, sizeof(ebuf));
           /* Clean up any buffers we provided in PRNG_Instantiate */
           PRNG_free_scratch(&ein, &nonce, &person, &flags);
 
@@ -1269,6 +1600,7 @@ SP800_90STATE RNG_CTX_Init(PRNG_CTX *ctx, PRNG *alg, unsigned char *person,
     }
 #if !defined(_WIN32)    
     ictx->lastPID = getpid();
+    ictx->lastGen = ForkGeneration();
 #endif
     state = ictx->state;
   }
@@ -1293,6 +1625,7 @@ SP800_90STATE RNG_ReSeed(PRNG_CTX *ctx, unsigned char *adata,
   SP800_90STATE state = SP800_90CRIT;
   int einl;
   int type = 0;
+  unsigned char ebuf[EBUF_SIZE];
 
   unsigned long l;
 
@@ -1325,9 +1658,10 @@ SP800_90STATE RNG_ReSeed(PRNG_CTX *ctx, unsigned char *adata,
         }
 
         /*
-          check that the global TRNG type hasn't changed
+          check that the global TRNG type hasn't changed,
+          the shared pool tracks that itself
         */
-        type = TRNG_type(ictx->trng);
+        type = ictx->shared ? GetDefaultTrng() : TRNG_type(ictx->trng);
         if (type != GetDefaultTrng())
         {       
           /* printf("Changing TRNG, default %d, current %d\n", GetDefaultTrng(),type); */
@@ -1347,16 +1681,16 @@ SP800_90STATE RNG_ReSeed(PRNG_CTX *ctx, unsigned char *adata,
         {
           /* Provide an appropriate amount of entropy */
           einl = NeededBytes(ictx);
-          if (TRNG_OK != PRNG_GenerateRandomSeed(ctx, einl, ictx->eBuf))
+          if (TRNG_OK != PRNG_GenerateRandomSeed(ctx, einl, ebuf))
           {
             ictx->state = SP800_90ERROR;
             ictx->error_reason = ERRAT("TRNG failure, low entropy");
           }
           else
           {
-            ictx->prng->Res(ctx, ictx->eBuf, einl, adata, adatal);
-            memset(ictx->eBuf, 0, einl);
+            ictx->prng->Res(ctx, ebuf, einl, adata, adatal);
           }
+          memset(ebuf, 0, einl);
         }
         break;
       case SP800_90ERROR:
@@ -1400,20 +1734,31 @@ static SP800_90STATE OldefRNG_Generate(PRNG_CTX *ctx, unsigned char *buffer,
   unsigned int l;
   unsigned char tbuf[512];
 #if !defined(_WIN32)
-
-  pid_t pid = -1;
+  unsigned int gen = 0;
+  int forked = 0;
 #endif
   if (NULL != ictx)
   {
     if (NULL != ictx->prng)
     {
 #if !defined(_WIN32)
-      /* Fork protection, ensure each process has unique state after fork() */
-      pid = getpid();
-      if(ictx->lastPID != pid) {
-        TRNG_GenerateRandomSeed(ictx->trng,512,tbuf); /* We cache the noise input, so pull enough data to ensure that's cleared */
+      /* Fork protection, ensure each process has unique state after fork() 
+         a memory compare where we have a fork generation, getpid() otherwise
+      */
+      gen = ForkGeneration();
+      if(0 != gen) {
+        forked = (ictx->lastGen != gen);
+      } else {
+        forked = (ictx->lastPID != getpid());
+      }
+      if(forked) {
+        if(NULL != ictx->trng) {
+          TRNG_GenerateRandomSeed(ictx->trng,512,tbuf); /* We cache the noise input, so pull enough data to ensure that's cleared */
+        }
+        /* A shared context switches to it's own TRNG on the reseed */
         ictx->state = SP800_90RESEED; /* Force a reseed to fix the PRNG states */
-        ictx->lastPID = pid;
+        ictx->lastPID = getpid();
+        ictx->lastGen = gen;
       }
 
 #endif  
@@ -1681,7 +2026,7 @@ SP800_90STATE RNG_CTX_ctrl(PRNG_CTX *ctx, SP800_90CTRL type, int arg,
       }
       break;
     case SP800_90_GETENTROPY:
-      *(unsigned int *)ptr = GetEntropy(ictx->trng);
+      *(unsigned int *)ptr = ictx->shared ? TRNG_PoolEntropy() : GetEntropy(ictx->trng);
       rv = ictx->state;
       break;
     case SP800_90_GETLASTERROR:
@@ -1728,6 +2073,35 @@ SP800_90STATE RNG_CTX_ctrl(PRNG_CTX *ctx, SP800_90CTRL type, int arg,
         rv = SP800_90PARAM;
       }
       break;
+    case SP800_90_GETCALLS:
+      if (NULL != ptr) {
+        *(unsigned int *)ptr = ntohl(ictx->CallCount.u);
+        rv = ictx->state;
+      } else {
+        rv = SP800_90PARAM;
+      }
+      break;
+    case SP800_90_GETSIZE:
+      /* The OpenSSL digest/cipher contexts are opaque and not counted,
+         nor is the shared TRNG pool */
+      if (NULL != ptr) {
+        *(unsigned int *)ptr = (unsigned int)sizeof(SP800_90PRNG_Data_t) +
+                               ictx->stl + TRNG_Size(ictx->trng);
+        rv = ictx->state;
+      } else {
+        rv = SP800_90PARAM;
+      }
+      break;
+    case SP800_90_GETTESTTIME:
+      if (NULL != ptr) {
+        ICC_LockMutex(&(ictx->prng->mtx));
+        *(unsigned int *)ptr = ictx->prng->test_us;
+        ICC_UnlockMutex(&(ictx->prng->mtx));
+        rv = ictx->state;
+      } else {
+        rv = SP800_90PARAM;
+      }
+      break;
     default:
       break;
     }
@@ -1751,6 +2125,10 @@ void RNG_CTX_free(PRNG_CTX *ctx)
       ictx->prng->Cln(ctx);
       ictx->prng = NULL;
     }
+    if(NULL != ictx->st) {
+      memset(ictx->st,0,ictx->stl);
+      ICC_Free(ictx->st);
+    }
     memset(ictx,0,sizeof(SP800_90PRNG_Data_t));
     ICC_Free(ictx);
   }
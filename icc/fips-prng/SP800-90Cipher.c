@@ -30,47 +30,70 @@ static const unsigned char K[32] = { 0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,
 static const unsigned char ZERO[32] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
 				       0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
 
+#if defined(NODF_ENABLED)
 static const unsigned char C01[1] = {0x01};
+#endif
 static const unsigned char C80[1] = {0x80};
 
 /*!
-  @brief SP800-90 Block cipher chaining function.
-  Note: This is a compression function, it takes multiple blocks of input, and only returns one block
-  of output
-  @param pctx an internal PRNG context
-  @param ctx An initialized cipher context
-  @param in A Data chaining structure containing the input data
-  @param out a pointer to the output buffer
-  @note key initialization is done outside this code. (Is expensive !)
+  @brief Maximum number of counter blocks encrypted in one pass
+  in the generate loop. 64 blocks (1k) keeps the working set in L1
+  while giving the cipher enough independent blocks to pipeline.
 */
+#define CTR_BATCH 64
 
-static void BCC(SP800_90PRNG_Data_t *pctx,EVP_CIPHER_CTX *ctx,DS *in,unsigned char *out)
+/*!
+  @brief Increment the big endian counter V by one.
+  Equivalent to Add(V,V,len,C01,1) but stops as soon as
+  there's no carry out of a byte.
+  @param V the counter
+  @param len the length of the counter in bytes
+*/
+static void CTR_Inc(unsigned char *V,unsigned len)
 {
-  int outl = 0;
-  unsigned i,n;
-  unsigned char T[MAX_OBL];
-  /* Chaining value = 0^outlen */
-  memset(out,0,pctx->prng->OBL); 
-  DS_Reset(in);
-  /* Exactly as specified, 
-     Note input is always 0 padded to a full block 
-     so partical blocks of input aren't a concern
-  */
-  n = in->total / pctx->prng->OBL;
-  for(i = 1; i <= n; i++) { 
-    DS_Copy(in,T,pctx->prng->OBL); /* Note that DS_Copy() 0 pads */    
-    /* input_block (T) = chaining_value (out) ^ block_i (in) */
-    xor(T,T,out,pctx->prng->OBL);
-    /* Chaining value = Block_Encrypt(key,input_block) */
-    if( 1 !=EVP_EncryptUpdate(ctx,out,&outl,T,(int)pctx->prng->OBL) || 
-	(outl != (int)pctx->prng->OBL) ) {
-      pctx->error_reason = ERRAT("Encrypt Update failed");
-      pctx->state = SP800_90ERROR;
-      return;
+  while(len > 0) {
+    len--;
+    V[len]++;
+    if(0 != V[len]) {
+      break;
     }
   }
-  /* output block (1 block) = chaining value, it's already there */
 }
+
+/*!
+  @brief SP800-90 CTR mode block generation.
+  Lay out n consecutive values of V+1, V+2 ... V+n in out then
+  encrypt them in place with a single cipher call so the underlying
+  (ECB) implementation can pipeline the blocks.
+  @param pctx an internal PRNG context
+  @param out destination, n * OBL bytes
+  @param n the number of blocks to generate
+  @return 1 on success, 0 on failure (pctx state is set, out is cleared)
+  @note V is left at V+n, exactly as n single block increments would
+*/
+static int CTR_Blocks(SP800_90PRNG_Data_t *pctx,unsigned char *out,unsigned n)
+{
+  int outl = 0;
+  unsigned i;
+  unsigned obl = pctx->prng->OBL;
+  unsigned char *ptr = out;
+
+  for(i = 0; i < n; i++) {
+    CTR_Inc(pctx->V,obl);
+    memcpy(ptr,pctx->V,obl);
+    ptr += obl;
+  }
+  if( 1 != EVP_EncryptUpdate(pctx->ctx.cctx,out,&outl,out,(int)(n * obl)) ||
+      (outl != (int)(n * obl)) ) {
+    /* Don't leave the plain counter values, i.e. V, with the caller */
+    OPENSSL_cleanse(out,n * obl);
+    pctx->error_reason = ERRAT("Encrypt Update failed");
+    pctx->state = SP800_90ERROR;
+    return 0;
+  }
+  return 1;
+}
+
 /*!
   @brief Extract a new K & V
   @param pctx an internal PRNG context
@@ -85,9 +108,12 @@ void SetKV(SP800_90PRNG_Data_t *pctx)
      of K & V)
   */
   memcpy(pctx->V,(pctx->T)+keylen,pctx->prng->OBL); 
-  /* And set up the new key */
-  EVP_CIPHER_CTX_cleanup(pctx->ctx.cctx);
-  if(1 != EVP_EncryptInit(pctx->ctx.cctx,pctx->alg.cipher,pctx->K,NULL)  ) {
+  /* And set up the new key. The context keeps it's cipher from
+     Instantiate so this only recomputes the key schedule in place,
+     a cleanup/EncryptInit here would free and reallocate the cipher
+     data on every generate call.
+  */
+  if(1 != EVP_EncryptInit_ex(pctx->ctx.cctx,NULL,NULL,pctx->K,NULL)  ) {
     pctx->error_reason = ERRAT("Encrypt Init failed");
     pctx->state = SP800_90ERROR;
     return;
@@ -106,129 +132,185 @@ void SetKV(SP800_90PRNG_Data_t *pctx)
 */
 static void Update(SP800_90PRNG_Data_t *pctx)
 {
-  unsigned int k = 0;
-  int outl = 0;
-  unsigned char *buf = pctx->T;
-  unsigned int blen = pctx->prng->seedlen;
-  
-  
-  while(blen > 0) {
-    Add(pctx->V,pctx->V,pctx->prng->OBL,(unsigned char *)C01,1);
-    if( 1 != EVP_EncryptUpdate(pctx->ctx.cctx,buf,&outl,pctx->V,(int)pctx->prng->OBL) ||
-	(outl != (int)pctx->prng->OBL)  ) {
-      pctx->error_reason = ERRAT("Encrypt Update failed");
-      pctx->state = SP800_90ERROR;
-      return;
-    }
-    k = (blen > pctx->prng->OBL) ? pctx->prng->OBL : blen;
-    buf += k;
-    blen -= k;
+  /* seedlen rounded up to whole blocks, fits in T (MAX_T) in all modes
+     so generate all the blocks in one pass 
+  */
+  if(!CTR_Blocks(pctx,pctx->T,BlocksReqd(pctx->prng->seedlen,pctx->prng->OBL))) {
+    return;
   }
   /* XOR in any provided data, which must be seedlen long */
   xor(pctx->T,pctx->T,pctx->C,pctx->prng->seedlen);
   /* Copy K & V from pctx->T and setup the new key */
   SetKV(pctx);  
-  memset(pctx->T,0,pctx->prng->seedlen);
+  memset(pctx->T,0,BlocksReqd(pctx->prng->seedlen,pctx->prng->OBL) * pctx->prng->OBL);
 }
+/*!
+  @brief Cipher_df input we'll gather on the stack, larger
+  inputs (long personalization strings or additional data) are allocated
+*/
+#define DF_STACK 512
+
+/*!
+  @brief CBC mode equivalent of the ECB cipher used by the DRBG
+  @param pctx a PRNG context
+  @return the CBC cipher with the same key length or NULL
+  @note only called when an instance sets up it's df context
+*/
+static const EVP_CIPHER *CBC_cipher(SP800_90PRNG_Data_t *pctx)
+{
+  static const EVP_CIPHER *cbc[3] = {NULL, NULL, NULL};
+  static const char *names[3] = {"AES-128-CBC", "AES-192-CBC", "AES-256-CBC"};
+  int i;
+
+  i = (EVP_CIPHER_key_length(pctx->alg.cipher) - 16) / 8;
+  if((i < 0) || (i > 2)) {
+    return NULL;
+  }
+  /* Yes, this is thread safe, it always gets set to the same value, so 
+     even in a race - no harm done 
+  */
+  if(NULL == cbc[i]) {
+    cbc[i] = EVP_get_cipherbyname(names[i]);
+  }
+  return cbc[i];
+}
+
+/*!
+  @brief one CBC encryption pass
+  @param pctx a PRNG context
+  @param ctx a CBC cipher context
+  @param key the key, NULL to keep the current key schedule
+  @param iv the IV
+  @param out output, n bytes
+  @param in input, n bytes, a multiple of the block size
+  @param n the number of bytes
+  @return 1 on success, 0 on failure (pctx state is set)
+*/
+static int CBC_Pass(SP800_90PRNG_Data_t *pctx, EVP_CIPHER_CTX *ctx,
+                    const unsigned char *key, const unsigned char *iv,
+                    unsigned char *out, const unsigned char *in, unsigned n)
+{
+  int outl = 0;
+  if( (1 != EVP_EncryptInit_ex(ctx,NULL,NULL,key,iv)) ||
+      (1 != EVP_EncryptUpdate(ctx,out,&outl,in,(int)n)) ||
+      (outl != (int)n) ) {
+    pctx->error_reason = ERRAT("Encrypt Update failed");
+    pctx->state = SP800_90ERROR;
+    return 0;
+  }
+  return 1;
+}
+
 /*!
   @brief SP800-90 Cipher derivation function
   @param pctx a PRNG context
   @param dsin a data chain containing the input data
   @note Output always comes out in pctx->C and is pctx->prng->seedlen bytes
   ASSUME that this is supposed to not change the stored state 
-  (Encryption key, pctx->K, pctx->V), so Cipher_df uses it's own EVP_CIPHER_CTX
+  (Encryption key, pctx->K, pctx->V), so Cipher_df uses it's own EVP_CIPHER_CTX,
+  pctx->dfctx, set up with the CBC cipher on first use and kept until
+  CIPHER_Cleanup()
+  @note BCC (SP800-90 10.3.3) is the CBC-MAC of it's input with a zero IV,
+  so the input is gathered once as 
+  IV || L || N || (input) || 0x80 || ZERO_PAD
+  and each BCC is a single CBC pass over that, only the block # field in
+  IV changes between passes and the key schedule is set up once.
+  The output stage, X = Block_Encrypt(K,X) repeatedly, is CBC encryption
+  of zero blocks with X as the IV, so that's one pass as well.
 */
 
 static void Cipher_df(SP800_90PRNG_Data_t *pctx,DS *dsin)
 {
-
-  unsigned int i,k;
-
-  unsigned char IV[MAX_OBL]; 
-  unsigned char L[4]; /* Maximum blocksize */
-  unsigned char N[4];
-  /*  unsigned char I[4]; */
-  unsigned char *ptr = NULL;
+  unsigned int i,k,n;
+  unsigned int obl = pctx->prng->OBL;
   unsigned int outl = pctx->prng->seedlen;
-  int eol = 0;
-  EVP_CIPHER_CTX *ctx = NULL;
+  unsigned int len = 0;
+  unsigned int keylen = 0;
+  unsigned char sbuf[2 * DF_STACK];
+  unsigned char *S = sbuf;     /* The BCC input */
+  unsigned char *E = NULL;     /* CBC output, only the last block is used */
+  unsigned char *data = NULL;
+  unsigned char *ptr = NULL;
+  const EVP_CIPHER *cbc = NULL;
+  EVP_CIPHER_CTX *ctx = pctx->dfctx;
 
-  ctx = EVP_CIPHER_CTX_new();
-  
-  memset(IV,0,pctx->prng->OBL);
   DS_Reset(dsin);
-
-  /* Note the ordering,insert IV after L after N with the resulting 
-     order
-     IV || L || N || (input) || 0x80 || ZERO_PAD
-     When in the inner loop
-  */
-  /* The length of the input data in bytes 
-     Note that we have to calculate this BEFORE we start adding data to dsin
+  /* IV || L || N || (input) || 0x80 then explicitly pad to a full block,
+     no padding if that's already a whole number of blocks (10.3.2 step 5)
   */
-  uint2BS(dsin->total,L);
-
-  uint2BS(outl,N);  /* The length of the output data in bytes */
-
-  DS_Insert(dsin,4,N);
-  DS_Insert(dsin,4,L);
-  DS_Insert(dsin,pctx->prng->OBL,IV);
-
-  DS_Append(dsin,1,C80);
-
-  i = pctx->prng->OBL - ( dsin->total % pctx->prng->OBL);
-  /* explicitly pad to a full block */
-  DS_Append(dsin,i,ZERO);
-
+  len = obl + 8 + dsin->total + 1;
+  len = BlocksReqd(len,obl) * obl;
+  if(len > DF_STACK) {
+    S = ICC_Malloc(2 * len,__FILE__,__LINE__);
+  }
+  if(NULL == ctx) {
+    cbc = CBC_cipher(pctx);
+    ctx = EVP_CIPHER_CTX_new();
+    if( (NULL != cbc) && (NULL != ctx) &&
+        (1 == EVP_EncryptInit_ex(ctx,cbc,NULL,NULL,NULL)) ) {
+      EVP_CIPHER_CTX_set_padding(ctx,0);
+      pctx->dfctx = ctx;
+    } else if(NULL != ctx) {
+      EVP_CIPHER_CTX_free(ctx);
+      ctx = NULL;
+    }
+  }
+  if( (NULL == S) || (NULL == ctx) ) {
+    pctx->error_reason = ERRAT("Encrypt Init failed");
+    pctx->state = SP800_90ERROR;
+    goto cleanup;
+  }
+  E = S + len;
+  memset(S,0,len);
+  /* The length of the input data in bytes */
+  uint2BS(dsin->total,S + obl);
+  /* The length of the output data in bytes */
+  uint2BS(outl,S + obl + 4);
+  ptr = S + obl + 8;
+  do {
+    DS_Extract(dsin,&n,&data);
+    if(NULL != data) {
+      memcpy(ptr,data,n);
+      ptr += n;
+    }
+  } while(NULL != data);
+  *ptr = C80[0];
 
   /* Set the encryption key 0x00,0x01 ....*/
-  if( 1 != EVP_EncryptInit(ctx,pctx->alg.cipher,(unsigned char *)K,NULL)  ) {
+  if(1 != EVP_EncryptInit_ex(ctx,NULL,NULL,K,NULL)) {
     pctx->error_reason = ERRAT("Encrypt Init failed");
     pctx->state = SP800_90ERROR;
-    return;
+    goto cleanup;
   }
-  outl = pctx->prng->seedlen; 
   ptr = pctx->T;
-  i = 0;
-  while(outl > 0) {
-    uint2BS(i,IV);  /* Set the block # field in the IV */
-    DS_Reset(dsin);
-    BCC(pctx,ctx,dsin,ptr);
-    k = (outl > pctx->prng->OBL) ? pctx->prng->OBL: outl;
-    ptr += k;
-    outl -= k;
-    i = i + 1;
-  }
-  EVP_CIPHER_CTX_cleanup(ctx);
-  /*  K = Leftmost keylen bits of temp (pctx->T)*/
-  if( 1 != EVP_EncryptInit(ctx,pctx->alg.cipher,pctx->T,NULL)  ) {
-    pctx->error_reason = ERRAT("Encrypt Init failed");
-    pctx->state = SP800_90ERROR;
-    return;
+  for(i = 0, k = 0; k < outl; i++, k += obl) {
+    uint2BS(i,S);  /* Set the block # field in the IV */
+    /* Chaining value = 0^outlen */
+    if(!CBC_Pass(pctx,ctx,NULL,ZERO,E,S,len)) {
+      goto cleanup;
+    }
+    memcpy(ptr,E + len - obl,obl);
+    ptr += obl;
   }
-  i = EVP_CIPHER_key_length(pctx->alg.cipher);
-  /* X = next outlen bits of temp (move to the start of pctx->T) */
-  memmove(pctx->T,pctx->T + i,pctx->prng->OBL);
-  /* This always generates seedlen bytes in pctx->C */
-  outl = pctx->prng->seedlen;
-  ptr = pctx->C;
-  while( outl > 0 ) {
-    /* X = Block_Encrypt(K,X) */
-    if( 1 != EVP_EncryptUpdate(ctx,ptr,&eol,pctx->T,(int)pctx->prng->OBL) ||
-	(eol != (int)pctx->prng->OBL)  ) {
-      pctx->error_reason = ERRAT("Encrypt Update failed");
-      pctx->state = SP800_90ERROR;
-      return;
+  /*  K = Leftmost keylen bits of temp (pctx->T),
+      X = next outlen bits of temp 
+      C = X = Block_Encrypt(K,X) ... seedlen bytes, 
+      pctx->C holds whole blocks
+  */
+  keylen = EVP_CIPHER_key_length(pctx->alg.cipher);
+  n = BlocksReqd(outl,obl) * obl;
+  memset(pctx->C,0,n);
+  CBC_Pass(pctx,ctx,pctx->T,pctx->T + keylen,pctx->C,pctx->C,n);
+  
+cleanup:
+  /* And clear our scratch areas */
+  memset(pctx->T,0,BlocksReqd(outl,obl) * obl);
+  if(NULL != S) {
+    memset(S,0,2 * len);
+    if(S != sbuf) {
+      ICC_Free(S);
     }
-    k = (outl > pctx->prng->OBL) ? pctx->prng->OBL: outl;
-    memcpy(pctx->T,ptr,pctx->prng->OBL);
-    ptr += k;
-    outl -= k;
   }
-  /* And clear our scratch area */
-  memset(pctx->T,0,pctx->prng->OBL);
-  EVP_CIPHER_CTX_cleanup(ctx);
-  EVP_CIPHER_CTX_free(ctx);
 }
 
 /*! 
@@ -272,7 +354,7 @@ SP800_90STATE CIPHER_Instantiate(PRNG_CTX *ctx,
   DS_Append(&seedDS,perl,person);
   /* Compress all the seed inputs to a single "seedlen" buffer (pctx->C) */
   Cipher_df(pctx,&seedDS);
-  memset(pctx->K,0,32);
+  memset(pctx->K,0,pctx->prng->seedlen - pctx->prng->OBL); /* keylen */
   memset(pctx->V,0,pctx->prng->OBL);
   /* Set the initial encryption key */
   EVP_CIPHER_CTX_cleanup(pctx->ctx.cctx);
@@ -330,8 +412,7 @@ SP800_90STATE CIPHER_Generate(PRNG_CTX *ctx,
  
   SP800_90PRNG_Data_t *pctx = (SP800_90PRNG_Data_t *)ctx;
 
-  int j = 0;
-  int outl = 0;
+  unsigned int n = 0;
   DS seedDS;
   /* Note that the ReSeed logic, state validation 
      and prediction resistance
@@ -347,20 +428,26 @@ SP800_90STATE CIPHER_Generate(PRNG_CTX *ctx,
   }  /*else { adata = 0^seedlen; } ,  pctx->C is 0 by default */   
 
   /*
-    Data is generated by encrypting V and incrementing V for the next block
+    Data is generated by encrypting V and incrementing V for the next block.
+    Whole blocks are built and encrypted in place in the caller's buffer
+    a batch at a time, only the trailing partial block goes via pctx->T
   */
-  while(blen > 0) {
-    Add(pctx->V,pctx->V,pctx->prng->OBL,(unsigned char *)C01,1);      
-    if( 1 != EVP_EncryptUpdate(pctx->ctx.cctx,pctx->T,&outl,pctx->V,(int)pctx->prng->OBL) ||
-	(outl != (int)pctx->prng->OBL)  ) {
-      pctx->error_reason = ERRAT("Encrypt Update failed");
-      pctx->state = SP800_90ERROR;
+  while(blen >= pctx->prng->OBL) {
+    n = blen / pctx->prng->OBL;
+    if(n > CTR_BATCH) {
+      n = CTR_BATCH;
+    }
+    if(!CTR_Blocks(pctx,buffer,n)) {
       return pctx->state;
     }
-    j = (blen > pctx->prng->OBL) ?  pctx->prng->OBL: blen; 
-    memcpy(buffer,pctx->T,j);
-    buffer += j;
-    blen -= j;
+    buffer += n * pctx->prng->OBL;
+    blen -= n * pctx->prng->OBL;
+  }
+  if(blen > 0) {
+    if(!CTR_Blocks(pctx,pctx->T,1)) {
+      return pctx->state;
+    }
+    memcpy(buffer,pctx->T,blen);
   }
   /*
     Update K,V , with additional input if any fed through
@@ -391,6 +478,10 @@ SP800_90STATE CIPHER_Cleanup(PRNG_CTX *ctx)
     EVP_CIPHER_CTX_free(pctx->ctx.cctx);
     pctx->ctx.cctx = NULL;
   }
+  if(NULL != pctx->dfctx) {
+    EVP_CIPHER_CTX_free(pctx->dfctx);
+    pctx->dfctx = NULL;
+  }
   return pctx->state; 
 }
 
@@ -430,7 +521,7 @@ SP800_90STATE CIPHER_InstantiateNoDF(PRNG_CTX *ctx,
   if((NULL != ein) && (einl != 0)) {
     xor(pctx->C,pctx->C,ein,pctx->prng->seedlen);
   }
-  memset(pctx->K,0,32);
+  memset(pctx->K,0,pctx->prng->seedlen - pctx->prng->OBL); /* keylen */
   memset(pctx->V,0,pctx->prng->OBL);
   /* In other modes, this is done by Cipher_df */
   EVP_CIPHER_CTX_cleanup(pctx->ctx.cctx);
@@ -574,6 +665,49 @@ static const StringBuf AES128_128Result =
    }
   };
 
+/*! \known AES-128 PRNG known answer test data, df padding
+  INSTANTIATE CTR_DRBG AES-128 use df with NO PREDICTION RESISTANCE
+  Not NIST data. The instantiate input (39 bytes) and the additional
+  input (7 bytes) are both 7 mod 16 long so IV || L || N || input || 0x80
+  is block aligned and Cipher_df must not add a pad block
+  (SP800-90A 10.3.2 step 5). Cross checked against OpenSSL's CTR-DRBG.
+*/
+static const StringBuf AES128_PadIntEin =
+  {0,16,
+   {
+     0x66,0x16,0x59,0x5c,0xab,0x1a,0x25,0x81,
+     0xeb,0x6a,0xed,0x93,0x29,0xc5,0xf2,0xe1
+   }
+  };
+static const StringBuf AES128_PadIntNon =
+  {0,8,
+   {
+     0xfa,0x01,0x1e,0x1c,0xeb,0x03,0x6e,0xc1
+   }
+  };
+static const StringBuf AES128_PadIntPers =
+  {0,15,
+   {
+     0x0b,0xc5,0x8e,0x2a,0x65,0xd6,0x76,0x6c,
+     0x5a,0x2a,0x15,0x20,0x4e,0xc8,0x6b
+   }
+  };
+static const StringBuf AES128_PadGenAAD =
+  {0,7,
+   {
+     0x1b,0x7b,0x85,0xbe,0x64,0xf0,0xa8
+   }
+  };
+static const StringBuf AES128_PadResult =
+  {0,32,
+   {
+     0x6a,0x76,0x93,0x3a,0xaf,0xe5,0xa7,0x3f,
+     0x38,0xd1,0xe3,0xd3,0x45,0x68,0x2c,0xad,
+     0x44,0x06,0xc9,0x69,0x04,0x29,0xcb,0x99,
+     0x8c,0x98,0x96,0xe5,0x2c,0x60,0x16,0xf1
+   }
+  };
+
 
 /*!
   \FIPS Data structure defining the capabilities and limits
@@ -618,12 +752,12 @@ SP800_90PRNG_t aes128PRNG = {
       &AES128_128Result
     },
     {
-      NULL,      
-      NULL,
-      NULL,
-      NULL,
-      NULL,
-      NULL,
+      &AES128_PadIntEin,
+      &AES128_PadIntNon,
+      &AES128_PadIntPers,
+      &AES128_PadGenAAD,
+      &NONE,
+      &AES128_PadResult
     },
     {
       NULL,      
@@ -26,11 +26,51 @@ static const unsigned char C01[1] = {0x01};
    HHAC based PRNG's 
 */
 
+/*!
+  @brief Key the DRBG's HMAC context with the current K.
+  This is the expensive step (ipad/opad compressions) and is 
+  only done when K changes. 
+  The keyed inner/outer state is retained by the HMAC_CTX 
+  and reused by SP_HMAC_Restart() for every HMAC under the same K.
+  @param pctx pointer to an internal SP800-90 structure
+  @return 1 on success, 0 otherwise (pctx state is set)
+*/
+static int SP_HMAC_Key(SP800_90PRNG_Data_t *pctx)
+{
+  if(1 != HMAC_Init_ex(pctx->ctx.hmac_ctx,pctx->K,pctx->prng->OBL,pctx->alg.md,NULL)) {
+    pctx->error_reason = ERRAT("HMAC Init failed");
+    pctx->state = SP800_90ERROR;
+    return 0;
+  }
+  return 1;
+}
+
+/*!
+  @brief Start a new HMAC with the key set by the last SP_HMAC_Key().
+  HMAC_Init_ex() with a NULL key and digest just copies the retained 
+  keyed state, so this costs no compressions.
+  @param pctx pointer to an internal SP800-90 structure
+  @return 1 on success, 0 otherwise (pctx state is set)
+  @note Invariant: after instantiate and every SP_HMAC_Update() the 
+  context is keyed with pctx->K
+*/
+static int SP_HMAC_Restart(SP800_90PRNG_Data_t *pctx)
+{
+  if(1 != HMAC_Init_ex(pctx->ctx.hmac_ctx,NULL,0,NULL,NULL)) {
+    pctx->error_reason = ERRAT("HMAC Init failed");
+    pctx->state = SP800_90ERROR;
+    return 0;
+  }
+  return 1;
+}
+
 /*!
   @brief Core SP800-90 HMAC routine, takes the old K,V,entropy
   creates the new K,V
   @param pctx pointer to an internal SP800-90 structure
   @param ds pointer to a data chain structure
+  @note On entry the HMAC context must be keyed with K,
+  on exit it's keyed with the new K
 */
 void SP_HMAC_Update(SP800_90PRNG_Data_t *pctx,DS *ds)
 {
@@ -38,7 +78,9 @@ void SP_HMAC_Update(SP800_90PRNG_Data_t *pctx,DS *ds)
   unsigned char *ptr = NULL;
   
   /* K = HMAC(K,V || 0x00 || provided data); */
-  HMAC_Init_ex(pctx->ctx.hmac_ctx,pctx->K,pctx->prng->OBL,pctx->alg.md,NULL);
+  if(!SP_HMAC_Restart(pctx)) {
+    return;
+  }
   /* V */
   HMAC_Update(pctx->ctx.hmac_ctx,pctx->V,pctx->prng->OBL);
   /* 0x00 */
@@ -49,18 +91,20 @@ void SP_HMAC_Update(SP800_90PRNG_Data_t *pctx,DS *ds)
     HMAC_Update(pctx->ctx.hmac_ctx,ptr,len);
   }
   HMAC_Final(pctx->ctx.hmac_ctx,pctx->K,&len);
-  HMAC_CTX_cleanup(pctx->ctx.hmac_ctx);
   /* V = HMAC(K,V) */
-  HMAC_Init_ex(pctx->ctx.hmac_ctx,pctx->K,pctx->prng->OBL,pctx->alg.md,NULL); 
+  if(!SP_HMAC_Key(pctx)) {
+    return;
+  }
   HMAC_Update(pctx->ctx.hmac_ctx,pctx->V,pctx->prng->OBL);
   HMAC_Final(pctx->ctx.hmac_ctx,pctx->V,&len);
-  HMAC_CTX_cleanup(pctx->ctx.hmac_ctx);
 
   DS_Reset(ds);
   /* if (provided_data != NULL) { */
   if(ds->total) {
     /* K = HMAC(K,V || 0x01 || provided data); */
-    HMAC_Init_ex(pctx->ctx.hmac_ctx,pctx->K,pctx->prng->OBL,pctx->alg.md,NULL);
+    if(!SP_HMAC_Restart(pctx)) {
+      return;
+    }
     /* V */
     HMAC_Update(pctx->ctx.hmac_ctx,pctx->V,pctx->prng->OBL);
     /* 0x01 */
@@ -71,12 +115,12 @@ void SP_HMAC_Update(SP800_90PRNG_Data_t *pctx,DS *ds)
       HMAC_Update(pctx->ctx.hmac_ctx,ptr,len);
     }
     HMAC_Final(pctx->ctx.hmac_ctx,pctx->K,&len);
-    HMAC_CTX_cleanup(pctx->ctx.hmac_ctx);
     /* V = HMAC(K,V) */
-    HMAC_Init_ex(pctx->ctx.hmac_ctx,pctx->K,pctx->prng->OBL,pctx->alg.md,NULL);
+    if(!SP_HMAC_Key(pctx)) {
+      return;
+    }
     HMAC_Update(pctx->ctx.hmac_ctx,pctx->V,pctx->prng->OBL); 
     HMAC_Final(pctx->ctx.hmac_ctx,pctx->V,&len);
-    HMAC_CTX_cleanup(pctx->ctx.hmac_ctx);
   }
 }
 /*!
@@ -96,7 +140,6 @@ static SP800_90STATE SP_HMAC_Instantiate(PRNG_CTX *ctx,
 {
   DS seedDS;
   SP800_90PRNG_Data_t *pctx = (SP800_90PRNG_Data_t *)ctx;
-  unsigned int l = 0;
 
   /* As noted elsewhere, this is thread safe, the value set is
      always the same
@@ -121,19 +164,12 @@ static SP800_90STATE SP_HMAC_Instantiate(PRNG_CTX *ctx,
   DS_Append(&seedDS,einl,ein);
   DS_Append(&seedDS,nonl,nonce);
   DS_Append(&seedDS,perl,person);
-  /* HMAC_init() will allow reuse of the md if it's passed as NULL in later calls
-     But: we still have to set the md somewhere...
-     Note that ICC's HMAC_Init() calls HMAC_Init_ex() under the covers.
-  */
-  HMAC_Init_ex(pctx->ctx.hmac_ctx,pctx->K,pctx->prng->OBL,pctx->alg.md,NULL);
-  /* Now get it back into the correct state ... */
-  HMAC_Final(pctx->ctx.hmac_ctx,pctx->T,&l);
-  HMAC_CTX_cleanup(pctx->ctx.hmac_ctx);
-  /* And erase any leaked data in this case, 
-     not necessary but easier than explaining why we shouldn't need to
+  /* Set the md and the initial (all zero) key, 
+     SP_HMAC_Update() expects the context to be keyed with K 
   */
-  memset(pctx->T,0,pctx->prng->OBL);
-  SP_HMAC_Update(pctx,&seedDS);
+  if(SP_HMAC_Key(pctx)) {
+    SP_HMAC_Update(pctx,&seedDS);
+  }
   return pctx->state;
 }
 /*!
@@ -166,7 +202,8 @@ static SP800_90STATE SP_HMAC_ReSeed(PRNG_CTX *ctx,
   @param blen Number of bytes of PRNG data to supply
   @param adata additional user provided data
   @param adatal a pointer to the length of the provided data
-
+  @note K is constant over the output loop, so each block
+  reuses the keyed HMAC state and costs only the data compressions
 */
 
 static SP800_90STATE SP_HMAC_Generate(PRNG_CTX *ctx,
@@ -187,10 +224,11 @@ static SP800_90STATE SP_HMAC_Generate(PRNG_CTX *ctx,
  
   /* Works fine with no prediction resistance */
   while(blen > 0 ) {
-    HMAC_Init_ex(pctx->ctx.hmac_ctx,pctx->K,pctx->prng->OBL,pctx->alg.md,NULL);
+    if(!SP_HMAC_Restart(pctx)) {
+      return pctx->state;
+    }
     HMAC_Update(pctx->ctx.hmac_ctx,pctx->V,pctx->prng->OBL);
     HMAC_Final(pctx->ctx.hmac_ctx,pctx->V,&l);
-    HMAC_CTX_cleanup(pctx->ctx.hmac_ctx);
     j = (blen > pctx->prng->OBL) ? pctx->prng->OBL: blen;
     memcpy(buffer,pctx->V,j);
     buffer += j;
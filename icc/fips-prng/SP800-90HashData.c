@@ -16,6 +16,7 @@
 #include "SP800-90i.h"
 #include "ds.h"
 #include "utils.h"
+#include "hashgen.h"
 
 
 
@@ -199,6 +200,7 @@ static SP800_90STATE SHA_Generate(PRNG_CTX *ctx,
   SP800_90PRNG_Data_t *pctx = (SP800_90PRNG_Data_t *)ctx;
   unsigned int l = 0;
   int j = 0;
+  unsigned char H[EVP_MAX_MD_SIZE];
 
   /* If additional input != NULL ... */
   if( (NULL != adata) && (0 != adatal)) {
@@ -248,6 +250,17 @@ static SP800_90STATE SHA_Generate(PRNG_CTX *ctx,
   /* Returned bits = Hashgen(requested,V) */
 
   memcpy(pctx->T,pctx->V,pctx->prng->seedlen);
+
+  /* Whole blocks several at a time where Hashgen() can,
+     a single block is left to EVP which has the hardware
+     SHA instructions
+  */
+  l = EVP_MD_size(pctx->alg.md);
+  j = blen / l;
+  if( (j > 1) && Hashgen(pctx->alg.md,pctx->T,pctx->prng->seedlen,buffer,j) ) {
+    buffer += j * l;
+    blen -= j * l;
+  }
 	 
   while(blen > 0) {
     if( 1 != EVP_DigestInit(pctx->ctx.md_ctx,pctx->alg.md) ) {
@@ -265,7 +278,7 @@ static SP800_90STATE SHA_Generate(PRNG_CTX *ctx,
     /* Can't just hash directly into buffer, it may not have enough room
        for the hash result
     */
-    if( 1 != EVP_DigestFinal(pctx->ctx.md_ctx,pctx->eBuf,&l) )  {
+    if( 1 != EVP_DigestFinal(pctx->ctx.md_ctx,H,&l) )  {
       pctx->error_reason = ERRAT("Digest Final failed");
       pctx->state = SP800_90ERROR;
       EVP_MD_CTX_reset(pctx->ctx.md_ctx);
@@ -275,10 +288,11 @@ static SP800_90STATE SHA_Generate(PRNG_CTX *ctx,
     /* data = data +1 */
     Add(pctx->T,pctx->T,pctx->prng->seedlen,(unsigned char *)C01,1);
     j = (blen > l) ? l: blen;
-    memcpy(buffer,pctx->eBuf,j);
+    memcpy(buffer,H,j);
     buffer += j;
     blen -= j;
   }
+  OPENSSL_cleanse(H,sizeof(H));
   /* create H in pctx->T 
      H = Hash(0x03 || V )
   */
@@ -74,7 +74,8 @@ typedef enum {
 /* Highest strength possible */
 #define MAX_STRENGTH 256
 /* Maximum number of bytes we'll have to extract from ICC's NRBG
-   to guarantee meeting the entropy requirements
+   to guarantee meeting the entropy requirements. 
+   Callers supply this as stack scratch, it's not held per context
 */
 #define EBUF_SIZE (MAX_STRENGTH * ICC_GUARANTEED_ENTROPY)
 
@@ -215,47 +216,59 @@ typedef struct  {
   SP800_90_test TestData[4];    /*!< Self test vectors */
   int error;                    /*!< 40770 , error in self test */
   ICC_Mutex mtx;                /*!< 41221 Need locking on the type */
+  int tested;                   /*!< Self test has run at least once */
+  unsigned int test_us;         /*!< Duration of the last self test run, microseconds */
 } SP800_90PRNG_t;      
 
 
 /*!
   @brief defines the instance specific data for the DRBG
+  @note The working state (K,V,C,T) is a single allocation sized for the
+  selected mode at RNG_CTX_Init(), see PRNG_StateSize(). Entropy collected
+  from the NRBG goes via a scratch buffer on the calling thread's stack
+  and is scrubbed before return, so isn't held per context.
+  The fields used on every generate call come first and fit one cache line
+  on 64 bit platforms.
 */
 typedef struct {
-  unsigned char K[MAX_K];  /*!< Working key for cipher modes*/
-  unsigned char V[MAX_V];  /*!< Working space/restained data for digest mode */
-  unsigned char C[MAX_C];  /*!< Working space/restained data for digest mode
-			        Working space in cipher modes */
-  unsigned char T[MAX_T];  /*!< Scratch space */
-  unsigned char eBuf[EBUF_SIZE]; /*!< A scratch buffer used to collect NRBG input,
-				   and DRBG output. It's scrubbed after each use */
-  unsigned int TestMode;       /*!< Set if we are testing the DRBG, supresses scrubbing if fed in (const) data buffers */
-  unsigned int SecStr;         /*!< The desired security strength in bits 112, 128,192,256 */
-  unsigned int ReseedAt;       /*!< Number of CALLS (not bytes) before we Reseed */
-  unsigned int Paranoid;       /*!< Enable Prediction resistance, continual reseed   */ 
-  unsigned int minEnt;         /*!< minimum entropy for instantiate, reseed or input (worst case) */
-  unsigned int Auto;            /*!< Automatic, auto-reseed, auto-chunk large requests*/
+  SP800_90STATE state;         /*!< The DRBG state - includes extra self test states */
   union {
    unsigned char c[4];         /*!< the number of times the Generate function was called since last seeded */
    uint32_t u;                 /* it's merged in the PRNG's */
   } CallCount;
-  SP800_90STATE state;         /*!< The DRBG state - includes extra self test states */
+  unsigned int ReseedAt;       /*!< Number of CALLS (not bytes) before we Reseed */
+  unsigned int Paranoid;       /*!< Enable Prediction resistance, continual reseed   */ 
+  unsigned int Auto;           /*!< Automatic, auto-reseed, auto-chunk large requests*/
+  unsigned int TestMode;       /*!< Set if we are testing the DRBG, supresses scrubbing if fed in (const) data buffers */
   SP800_90PRNG_t *prng;        /*!< A pointer to the instance of this class of DRBG */
-  union {
-    const EVP_MD *md;          /*!< ICC Message digest specific to this instance */
-    const EVP_CIPHER *cipher;  /*!< ICC Cipher specific to this instance */
-  } alg;
   union {
     EVP_MD_CTX *md_ctx;        /*!< Message digest context associated with this instance */
     EVP_CIPHER_CTX *cctx;      /*!< Cipher context associated with this instaance */
     HMAC_CTX *hmac_ctx;        /*!< HMAC ctx used in HMAC modes */
   } ctx;
-  char * error_reason;         /*!< A short reason for a failure */
-  TRNG *trng;                  /*!< The seed source for this DRBG instance */
+  union {
+    const EVP_MD *md;          /*!< ICC Message digest specific to this instance */
+    const EVP_CIPHER *cipher;  /*!< ICC Cipher specific to this instance */
+  } alg;
+  unsigned char *K;            /*!< Working key for cipher and HMAC modes */
+  unsigned char *V;            /*!< Retained data, seedlen (digest modes) or OBL bytes */
+  /* End of the hot fields */
+  unsigned char *C;            /*!< Retained data for digest modes,
+			            working space in cipher modes */
+  unsigned char *T;            /*!< Scratch space */
   unsigned char lastdata[CNT_SZ];   /*!< The first 8 bytes of the last data request */
 #if !defined(_WIN32)
   pid_t lastPID;               /* The PID on the last call to generate, auto-reseed on fork() - lacking on Windows */
+  unsigned int lastGen;        /* The fork generation on the last call to generate, 0 if unknown */
 #endif
+  unsigned int SecStr;         /*!< The desired security strength in bits 112, 128,192,256 */
+  unsigned int minEnt;         /*!< minimum entropy for instantiate, reseed or input (worst case) */
+  char * error_reason;         /*!< A short reason for a failure */
+  TRNG *trng;                  /*!< The seed source for this DRBG instance */
+  int shared;                  /*!< Seeded from the shared TRNG pool, trng is NULL */
+  EVP_CIPHER_CTX *dfctx;       /*!< CBC context for Cipher_df(), cipher modes only */
+  unsigned char *st;           /*!< K|V|C|T, one allocation */
+  unsigned int stl;            /*!< Length of st */
 } SP800_90PRNG_Data_t;
 
 
@@ -269,6 +282,8 @@ typedef struct {
   @param person a pointer to the personalization data
   @param perl a pointer to the length of the personalization data
   @param flags a pointer to the flags used to track data we've allocated
+  @param scratch EBUF_SIZE bytes, used for the entropy input if ein is NULL.
+         The caller scrubs it.
   @note In normal use we'd expect to arrive here with ein,einl, nonce, nonl 
   as NULL,0,NULL,0. But during testing we call the functions embedded in the
   PRNG_CTX directly to drive the code and supply the known input data through
@@ -278,7 +293,20 @@ SP800_90STATE PRNG_Instantiate(SP800_90PRNG_Data_t *ctx,
 			       unsigned char **ein, unsigned int *einl,
 			       unsigned char **nonce, unsigned int *nonl,
 			       unsigned char **person,unsigned int *perl,
-			       unsigned int *flags);
+			       unsigned int *flags, unsigned char *scratch);
+
+/*!
+  @brief Size the working state (K,V,C,T) for a DRBG mode
+  @param prng the DRBG mode
+  @param k returned size of K
+  @param v returned size of V
+  @param c returned size of C
+  @param t returned size of T
+  @return the total, 0 for the TRNG modes which keep no state here
+*/
+unsigned int PRNG_StateSize(SP800_90PRNG_t *prng, unsigned int *k,
+                            unsigned int *v, unsigned int *c,
+                            unsigned int *t);
 /*!
   @brief Utility function to release data allocated
   internally during operation
@@ -356,6 +384,21 @@ void Add(unsigned char *dest,
 */
 void PRNG_self_test(PRNG_CTX *ctx,PRNG *alg);
 
+/*!
+  @brief Leave periodic self tests which fall due to PRNG_TestDue()
+  rather than running them inline in RNG_CTX_Init()
+  @param on !0 to defer, 0 for inline testing
+  @note deferral only applies in the process which enabled it
+*/
+void PRNG_SetTestDeferred(int on);
+
+/*!
+  @brief Self test the DRBG types which are close to their
+  periodic retest, on a private context.
+  Called from the RNG maintenance thread
+*/
+void PRNG_TestDue(void);
+
 /*! 
   @brief Internal "Instantiate" function which encapsulates
   the necessary state transition logic common to all modes
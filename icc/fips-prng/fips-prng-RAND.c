@@ -28,6 +28,8 @@
 #include "fips.h"
 #include "platform.h"
 #include "TRNG/entropy_estimator.h"
+#include "TRNG/entropy_reservoir.h"
+#include "TRNG/trng_pool.h"
 #include "fips-prng/SP800-90.h"
 #include "fips-prng/SP800-90i.h"
 
@@ -91,6 +93,8 @@ static enum { UNDEF, INIT, FAIL }  status = UNDEF;
 typedef struct {
   ICC_Mutex mtx;
   PRNG_CTX *rng;
+  unsigned int inline_reseeds; /*!< Reseeds a caller waited for */
+  unsigned int bg_reseeds;     /*!< Reseeds done by the reseed thread */
 } PRNG_BLOCK;
 
 /*! \FIPS RGB underyling OpenSSL's RAND_bytes() and ICC_GenerateRandomSeed().
@@ -106,6 +110,8 @@ typedef struct {
   unsigned int bytes;
   unsigned int index;
   unsigned char aad[AAD_SIZE];
+  unsigned int inline_reseeds; /*!< Reseeds a caller waited for */
+  unsigned int bg_reseeds;     /*!< Reseeds done by the reseed thread */
 } TRNG_BLOCK;
 
 static PRNG_BLOCK *pctx = NULL;  /*!< Standard SP800-90 PRNG */
@@ -116,6 +122,64 @@ static TRNG_BLOCK *tctx = NULL; /*!< SP800-90B/C RBG used as seed source */
    threads across RNG's well
 */
 static int N_rngs = 7; /*!< The number of RNG units in play */
+
+/*! \FIPS Per thread RBG's, ICC_RNG_PER_THREAD
+  Optional replacement for the locked pools above for processes
+  with many threads.
+  Each thread lazily instantiates it's own DRBG and seed source RBG on
+  first use. They are only ever touched by that thread so the generate
+  path takes no locks. Each is a complete SP800-90 instance with it's own
+  reseed counter and continuous tests.
+  The instances are chained so they can be freed at library cleanup
+  while the thread is still alive, the chain lock is only taken when
+  a thread creates or destroys it's instances.
+*/
+typedef struct TLS_BLOCK_t {
+  PRNG_CTX *prng;
+  PRNG_CTX *trng;
+  unsigned int inline_reseeds; /*!< Reseeds done during a generate call */
+  struct TLS_BLOCK_t *next;
+} TLS_BLOCK;
+
+static int per_thread = 0; /*!< Use per thread RNG's rather than the pools */
+static TLS_BLOCK *tls_list = NULL; /*!< Every live per thread block */
+static ICC_Mutex tls_mtx; /*!< Protects tls_list and tls_closing */
+static int tls_mtx_valid = 0; /*!< tls_mtx exists, it's never destroyed */
+static int tls_key_valid = 0; /*!< tls_key is set up */
+static int tls_closing = 0; /*!< tls_cleanup() has started */
+#if defined(_WIN32)
+static DWORD tls_key = FLS_OUT_OF_INDEXES;
+#else
+static pthread_key_t tls_key;
+#endif
+
+/*! \FIPS Background reseeding, ICC_RNG_RESEED_THREAD
+  A pooled RNG that hits it's reseed limit reseeds on the next
+  generate, pulling from the TRNG while the caller holds the slot lock.
+  Optionally a thread polls the pools and reseeds slots shortly before
+  they reach the limit so callers seldom wait. 
+  The RNG's are unchanged, this only moves when the reseed happens.
+  @note the thread doesn't survive fork(), a forked child just falls
+  back to reseeding inline.
+  The same thread runs the deferred DRBG self tests, ICC_RNG_TEST_THREAD,
+  see PRNG_TestDue().
+*/
+#define RESEED_POLL_MS 100 /*!< Reseed thread polling interval */
+#define RESEED_EARLY(at) ((at) >> 4) /*!< Calls before the limit we reseed at */
+
+static int reseed_thread = 0; /*!< Run the reseed thread */
+static int test_thread = 0; /*!< Defer periodic self tests to the reseed thread */
+static int reseed_running = 0; /*!< The reseed thread was started */
+static DWORD reseed_pid = 0; /*!< The process that started it */
+#if defined(_WIN32)
+static HANDLE reseed_tid = NULL;
+static HANDLE reseed_evt = NULL; /*!< Signalled to stop the thread */
+#else
+static pthread_t reseed_tid;
+static pthread_mutex_t reseed_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t reseed_cv = PTHREAD_COND_INITIALIZER;
+static int reseed_stop = 0; /*!< Set to stop the thread */
+#endif
 static char icc_global_prng_name[20] = {"SHA256"}; /*!< The type of the default PRNG */
 
 /* Implementation of functions */
@@ -182,6 +246,79 @@ int SetPRNGName(char *prngname)
   return rv;
 }
 
+int GetRNGPerThread()
+{
+  return per_thread;
+}
+
+int SetRNGPerThread(int on)
+{
+  int rv = 0;
+  /* As with SetRNGInstances, only before the RNG's are created */
+  if (status != INIT) {
+    per_thread = (0 != on) ? 1 : 0;
+    rv = 1;
+  }
+  return rv;
+}
+
+int GetRNGReseedThread()
+{
+  return reseed_thread;
+}
+
+int SetRNGReseedThread(int on)
+{
+  int rv = 0;
+  if (status != INIT) {
+    reseed_thread = (0 != on) ? 1 : 0;
+    rv = 1;
+  }
+  return rv;
+}
+
+int GetRNGTestThread()
+{
+  return test_thread;
+}
+
+int SetRNGTestThread(int on)
+{
+  int rv = 0;
+  if (status != INIT) {
+    test_thread = (0 != on) ? 1 : 0;
+    rv = 1;
+  }
+  return rv;
+}
+
+int GetRNGReseeds(int background)
+{
+  unsigned int total = 0;
+  int i = 0;
+  TLS_BLOCK *t = NULL;
+
+  /* The counters are only updated under the lock that covers them */
+  if (INIT == status) {
+    for (i = 0; i < N_rngs; i++) {
+      ICC_LockMutex(&(pctx[i].mtx));
+      total += background ? pctx[i].bg_reseeds : pctx[i].inline_reseeds;
+      ICC_UnlockMutex(&(pctx[i].mtx));
+      ICC_LockMutex(&(tctx[i].mtx));
+      total += background ? tctx[i].bg_reseeds : tctx[i].inline_reseeds;
+      ICC_UnlockMutex(&(tctx[i].mtx));
+    }
+    if (tls_key_valid && !background) {
+      ICC_LockMutex(&tls_mtx);
+      for (t = tls_list; NULL != t; t = t->next) {
+        total += t->inline_reseeds;
+      }
+      ICC_UnlockMutex(&tls_mtx);
+    }
+  }
+  return (int)total;
+}
+
 int SetRNGInstances(int instances)
 {
   int rv = 0;
@@ -196,63 +333,352 @@ int SetRNGInstances(int instances)
 }
 
 /*!
-  @brief initialize a TRNG in the thread pool 
-  @param i the TRNG to initialize
+  @brief instantiate one of the RNG's
+  @param rng where to put the new RNG
   @return RAND_R_PRNG_OK or an error
-  @note   
-   - i is assumed in range 
+  @note 
    - locks are assumed to be taken/released outside this function
-   - TRNG already tested for not instantiated
+   - rng has already been tested for not-instantiated
 */
-static int init_trng(int i) {
-  int rc = RAND_R_PRNG_OK;
-  PRNG *alg = NULL; 
+static int init_rng(PRNG_CTX **rng) {
+  int rc =  RAND_R_PRNG_OK;
+  PRNG *alg = NULL;
 
   alg = get_RNGbyname(icc_global_prng_name,1);
-  tctx[i].rng = RNG_CTX_new();
-
-  if((alg != NULL) && (NULL != tctx[i].rng) ) {
-    if(SP800_90INIT != RNG_CTX_Init(tctx[i].rng,alg,NULL,0,256,0)) {
+  *rng = RNG_CTX_new();
+  if ((alg != NULL) && (NULL != *rng)) {
+    if(SP800_90INIT != RNG_CTX_Init(*rng,alg,NULL,0,256,0)) {
       rc = RAND_R_PRNG_NOT_INITIALIZED;
     } 
   } else {
     rc = RAND_R_PRNG_NOT_IMPLEMENTED;
   }
   if(RAND_R_PRNG_OK != rc) {
-    RNG_CTX_free(tctx[i].rng);
-    tctx[i].rng = NULL;
+    RNG_CTX_free(*rng);
+    *rng = NULL;
   }
   return rc;
 }
+
 /*!
-  @brief initialize a TRNG in the thread pool 
-  @param i the TRNG to initialize
+  @brief free a per thread block and it's RNG's
+  @param t the block, already unchained
+*/
+static void tls_free(TLS_BLOCK *t)
+{
+  if (NULL != t->prng) {
+    RNG_CTX_free(t->prng);
+  }
+  if (NULL != t->trng) {
+    RNG_CTX_free(t->trng);
+  }
+  memset(t, 0, sizeof(TLS_BLOCK));
+  ICC_Free(t);
+}
+
+/*!
+  @brief thread exit callback, frees the exiting thread's RNG's
+  @param arg the thread's TLS_BLOCK
+  @note library cleanup may have freed the block already, so only
+  free it if it's still on the chain, and once cleanup has started
+  leave everything to it. tls_mtx outlives cleanup so a callback
+  already running when cleanup starts can still take it
+*/
+#if defined(_WIN32)
+static VOID WINAPI tls_destructor(PVOID arg)
+#else
+static void tls_destructor(void *arg)
+#endif
+{
+  TLS_BLOCK *t = (TLS_BLOCK *)arg;
+  TLS_BLOCK **pp = NULL;
+  int found = 0;
+
+  if ((NULL != t) && tls_mtx_valid) {
+    ICC_LockMutex(&tls_mtx);
+    for (pp = &tls_list; !tls_closing && (NULL != *pp); pp = &((*pp)->next)) {
+      if (*pp == t) {
+        *pp = t->next;
+        found = 1;
+        break;
+      }
+    }
+    ICC_UnlockMutex(&tls_mtx);
+    if (found) {
+      tls_free(t);
+    }
+  }
+}
+
+/*!
+  @brief set up the per thread RNG key
   @return RAND_R_PRNG_OK or an error
-  @note 
-   - i is assumed in range 
-   - locks are assumed to be taken/released outside this function
-   - rng has already been tested for not-instantiated
 */
-static int init_prng(int i) {
-  int rc =  RAND_R_PRNG_OK;
-  PRNG *alg = NULL;
+static int tls_init(void)
+{
+  int rc = RAND_R_PRNG_OK;
 
-  alg = get_RNGbyname(icc_global_prng_name,1);
-  pctx[i].rng = RNG_CTX_new();
-   if ((alg != NULL) && (NULL != pctx[i].rng)) {
-    if(SP800_90INIT != RNG_CTX_Init(pctx[i].rng,alg,NULL,0,256,0)) {
+  if (!tls_mtx_valid) {
+    if (0 == ICC_CreateMutex(&tls_mtx)) {
+      tls_mtx_valid = 1;
+    }
+  }
+  if (!tls_mtx_valid) {
+    rc = RAND_R_PRNG_NOT_INITIALIZED;
+  } else {
+#if defined(_WIN32)
+    tls_key = FlsAlloc(tls_destructor);
+    if (FLS_OUT_OF_INDEXES == tls_key) {
       rc = RAND_R_PRNG_NOT_INITIALIZED;
-    } 
+    }
+#else
+    if (0 != pthread_key_create(&tls_key, tls_destructor)) {
+      rc = RAND_R_PRNG_NOT_INITIALIZED;
+    }
+#endif
+    if (RAND_R_PRNG_OK == rc) {
+      ICC_LockMutex(&tls_mtx);
+      tls_closing = 0;
+      ICC_UnlockMutex(&tls_mtx);
+      tls_key_valid = 1;
+    }
+  }
+  return rc;
+}
+
+/*!
+  @brief free every per thread RNG and the key
+  @note threads still running simply find no RNG and
+        we never get here while they are using one
+  @note the key goes first so no more thread exit callbacks start,
+        FlsFree() runs the callbacks itself and they return early.
+        Callbacks already running either unchained their block before
+        we took the lock or see tls_closing once they get it, so tls_mtx
+        is left in place for them rather than destroyed
+*/
+static void tls_cleanup(void)
+{
+  TLS_BLOCK *t = NULL;
+
+  if (tls_key_valid) {
+    ICC_LockMutex(&tls_mtx);
+    tls_closing = 1;
+    ICC_UnlockMutex(&tls_mtx);
+#if defined(_WIN32)
+    FlsFree(tls_key);
+    tls_key = FLS_OUT_OF_INDEXES;
+#else
+    pthread_key_delete(tls_key);
+#endif
+    ICC_LockMutex(&tls_mtx);
+    while (NULL != tls_list) {
+      t = tls_list;
+      tls_list = t->next;
+      tls_free(t);
+    }
+    ICC_UnlockMutex(&tls_mtx);
+    tls_key_valid = 0;
+  }
+}
+
+/*!
+  @brief get the calling thread's RNG block, creating it on first use
+  @return the block, or NULL on failure
+  @note the RNG's inside are instantiated by the caller as needed
+*/
+static TLS_BLOCK *tls_get(void)
+{
+  TLS_BLOCK *t = NULL;
+
+#if defined(_WIN32)
+  t = (TLS_BLOCK *)FlsGetValue(tls_key);
+#else
+  t = (TLS_BLOCK *)pthread_getspecific(tls_key);
+#endif
+  if (NULL == t) {
+    t = (TLS_BLOCK *)ICC_Malloc(sizeof(TLS_BLOCK), __FILE__, __LINE__);
+    if (NULL != t) {
+      memset(t, 0, sizeof(TLS_BLOCK));
+#if defined(_WIN32)
+      if (!FlsSetValue(tls_key, t)) {
+#else
+      if (0 != pthread_setspecific(tls_key, t)) {
+#endif
+        ICC_Free(t);
+        t = NULL;
+      } else {
+        ICC_LockMutex(&tls_mtx);
+        t->next = tls_list;
+        tls_list = t;
+        ICC_UnlockMutex(&tls_mtx);
+      }
+    }
+  }
+  return t;
+}
+
+/*!
+  @brief check whether an RNG needs a reseed
+  @param rng the RNG
+  @param early 1 to report RNG's close to the reseed limit as well
+  @return 1 if the RNG should be reseeded
+  @note caller holds any lock needed for rng
+*/
+static int reseed_due(PRNG_CTX *rng, int early)
+{
+  int rv = 0;
+  unsigned int calls = 0;
+  unsigned int at = 0;
+  SP800_90STATE state = SP800_90RUN;
+
+  state = RNG_CTX_ctrl(rng, SP800_90_GETCALLS, 0, &calls);
+  if (SP800_90RESEED == state) {
+    rv = 1;
+  } else if (early && (SP800_90RUN == state)) {
+    RNG_CTX_ctrl(rng, SP800_90_GETRESEED, 0, &at);
+    /* RESEED_EARLY(at) <= at, so neither side can wrap */
+    if (calls >= (at - RESEED_EARLY(at))) {
+      rv = 1;
+    }
+  }
+  return rv;
+}
+
+/*!
+  @brief one pass of the reseed thread over the pools
+*/
+static void reseed_pass(void)
+{
+  int i = 0;
+
+  for (i = 0; i < N_rngs; i++) {
+    ICC_LockMutex(&(pctx[i].mtx));
+    if ((NULL != pctx[i].rng) && reseed_due(pctx[i].rng, 1)) {
+      /* Any error here is reported to the next caller */
+      RNG_ReSeed(pctx[i].rng, NULL, 0);
+      pctx[i].bg_reseeds++;
+    }
+    ICC_UnlockMutex(&(pctx[i].mtx));
+
+    ICC_LockMutex(&(tctx[i].mtx));
+    if ((NULL != tctx[i].rng) && reseed_due(tctx[i].rng, 1)) {
+      RNG_ReSeed(tctx[i].rng, NULL, 0);
+      tctx[i].bg_reseeds++;
+    }
+    ICC_UnlockMutex(&(tctx[i].mtx));
+  }
+}
+
+/*!
+  @brief reseed thread, polls the pools until told to stop
+*/
+#if defined(_WIN32)
+static DWORD WINAPI reseed_main(LPVOID arg)
+{
+  while (WAIT_TIMEOUT == WaitForSingleObject(reseed_evt, RESEED_POLL_MS)) {
+    if (reseed_thread) {
+      reseed_pass();
+    }
+    if (test_thread) {
+      PRNG_TestDue();
+    }
+  }
+  return 0;
+}
+#else
+static void *reseed_main(void *arg)
+{
+  struct timespec ts;
+
+  pthread_mutex_lock(&reseed_mtx);
+  while (!reseed_stop) {
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += (RESEED_POLL_MS % 1000) * 1000000L;
+    ts.tv_sec += RESEED_POLL_MS / 1000 + ts.tv_nsec / 1000000000L;
+    ts.tv_nsec %= 1000000000L;
+    pthread_cond_timedwait(&reseed_cv, &reseed_mtx, &ts);
+    if (!reseed_stop) {
+      pthread_mutex_unlock(&reseed_mtx);
+      if (reseed_thread) {
+        reseed_pass();
+      }
+      if (test_thread) {
+        PRNG_TestDue();
+      }
+      pthread_mutex_lock(&reseed_mtx);
+    }
+  }
+  pthread_mutex_unlock(&reseed_mtx);
+  return NULL;
+}
+#endif
+
+/*!
+  @brief start the reseed thread
+  @return RAND_R_PRNG_OK or an error
+*/
+static int reseed_start(void)
+{
+  int rc = RAND_R_PRNG_OK;
+
+#if defined(_WIN32)
+  reseed_evt = CreateEvent(NULL, TRUE, FALSE, NULL);
+  if (NULL != reseed_evt) {
+    reseed_tid = CreateThread(NULL, 0, reseed_main, NULL, 0, NULL);
+    if (NULL == reseed_tid) {
+      CloseHandle(reseed_evt);
+      reseed_evt = NULL;
+      rc = RAND_R_PRNG_NOT_INITIALIZED;
+    }
   } else {
-    rc = RAND_R_PRNG_NOT_IMPLEMENTED;
+    rc = RAND_R_PRNG_NOT_INITIALIZED;
   }
-  if(RAND_R_PRNG_OK != rc) {
-    RNG_CTX_free(pctx[i].rng);
-    pctx[i].rng = NULL;
+#else
+  reseed_stop = 0;
+  if (0 != pthread_create(&reseed_tid, NULL, reseed_main, NULL)) {
+    rc = RAND_R_PRNG_NOT_INITIALIZED;
+  }
+#endif
+  if (RAND_R_PRNG_OK == rc) {
+    reseed_running = 1;
+    reseed_pid = ICC_GetProcessId();
+    if (test_thread) {
+      PRNG_SetTestDeferred(1);
+    }
   }
   return rc;
 }
 
+/*!
+  @brief stop the reseed thread and wait for it to exit
+  @note must be called before the pools are freed
+*/
+static void reseed_end(void)
+{
+  if (reseed_running) {
+    PRNG_SetTestDeferred(0);
+    /* The thread only exists in the process that started it */
+    if (ICC_GetProcessId() == reseed_pid) {
+#if defined(_WIN32)
+      SetEvent(reseed_evt);
+      WaitForSingleObject(reseed_tid, INFINITE);
+#else
+      pthread_mutex_lock(&reseed_mtx);
+      reseed_stop = 1;
+      pthread_cond_signal(&reseed_cv);
+      pthread_mutex_unlock(&reseed_mtx);
+      pthread_join(reseed_tid, NULL);
+#endif
+    }
+#if defined(_WIN32)
+    CloseHandle(reseed_tid);
+    CloseHandle(reseed_evt);
+    reseed_tid = NULL;
+    reseed_evt = NULL;
+#endif
+    reseed_running = 0;
+  }
+}
 
 /* ------------------------------------- 
    Note 08/2008 Changed to use the SP800-90 API for
@@ -329,8 +755,20 @@ int RAND_FIPS_init(const void *seed, const unsigned int num) {
       }
     }
 
+    if ((RAND_R_PRNG_OK == rc) && per_thread) {
+      rc = tls_init();
+    }
+
     if (RAND_R_PRNG_OK == rc) {
       status = INIT;
+      /* Not fatal, we just reseed (and self test) inline as before */
+      if (reseed_thread || test_thread) {
+        reseed_start();
+      }
+      /* Likewise, seeding falls back to inline collection */
+      TRNG_ReservoirStart();
+      /* and DRBG's to their own TRNG */
+      TRNG_PoolStart();
     }
   cleanup:
     if (rc != RAND_R_PRNG_OK) {
@@ -356,6 +794,7 @@ int RAND_FIPS_init(const void *seed, const unsigned int num) {
         ICC_Free(tctx);
         tctx = NULL;
       }
+      tls_cleanup();
       status = FAIL;
       ERR_put_error(ERR_LIB_RAND, RAND_F_FIPS_PRNG_RAND_INIT, rc, __FILE__,
                     __LINE__);
@@ -390,6 +829,25 @@ int RAND_FIPS_Entropy()
       }
     }   
   }
+  if (tls_key_valid) {
+    TLS_BLOCK *t = NULL;
+    ICC_LockMutex(&tls_mtx);
+    for (t = tls_list; NULL != t; t = t->next) {
+      if (NULL != t->prng) {
+        RNG_CTX_ctrl(t->prng,SP800_90_GETENTROPY,0,&eRNG);
+        if(eRNG < total) {
+          total = eRNG;
+        }
+      }
+      if (NULL != t->trng) {
+        RNG_CTX_ctrl(t->trng,SP800_90_GETENTROPY,0,&eRNG);
+        if(eRNG < total) {
+          total = eRNG;
+        }
+      }
+    }
+    ICC_UnlockMutex(&tls_mtx);
+  }
   return total;
 }
 
@@ -405,28 +863,39 @@ int fips_rand_seed(const void *ibuf, int num){
   unsigned char *buf = (unsigned char *)ibuf;
   SP800_90STATE state = SP800_90RUN;
 
-  tid = ICC_GetThreadId() % N_rngs;
-
-  ICC_LockMutex(&(tctx[tid].mtx));
-  /* If it was never initialized  */
-  if (NULL == tctx[tid].rng ) {
-    rc = init_trng(tid);
-    /* No need to reseed if it was just instantiated */
-  } else { /* We allow NULL,0 because the primary seed source is internal */
-    if (num >= 0) {
-      state = RNG_ReSeed(tctx[tid].rng, buf, num);
+  if (per_thread) {
+    TLS_BLOCK *t = tls_get();
+    if (NULL == t) {
+      rc = RAND_R_PRNG_NOT_INITIALIZED;
+    } else if (NULL == t->trng) {
+      rc = init_rng(&(t->trng));
+    } else if (num >= 0) {
+      state = RNG_ReSeed(t->trng, buf, num);
     }
-    switch (state)
-    {
-    case SP800_90RUN:
-    case SP800_90RESEED:
-      break;
-    default:
-      rc = RAND_R_PRNG_CRYPT_TEST_FAILED;
-      break;
+  } else {
+    tid = ICC_GetThreadId() % N_rngs;
+
+    ICC_LockMutex(&(tctx[tid].mtx));
+    /* If it was never initialized  */
+    if (NULL == tctx[tid].rng ) {
+      rc = init_rng(&(tctx[tid].rng));
+      /* No need to reseed if it was just instantiated */
+    } else { /* We allow NULL,0 because the primary seed source is internal */
+      if (num >= 0) {
+        state = RNG_ReSeed(tctx[tid].rng, buf, num);
+      }
     }
+    ICC_UnlockMutex(&(tctx[tid].mtx));
+  }
+  switch (state)
+  {
+  case SP800_90RUN:
+  case SP800_90RESEED:
+    break;
+  default:
+    rc = RAND_R_PRNG_CRYPT_TEST_FAILED;
+    break;
   }
-  ICC_UnlockMutex(&(tctx[tid].mtx));
   
   if (rc != RAND_R_PRNG_OK)
   {
@@ -462,43 +931,65 @@ int fips_rand_bytes(unsigned char *buf, int num){
   unsigned int aadl = 0;
   SP800_90STATE state = SP800_90RUN;
 
-  tid = ICC_GetThreadId() % N_rngs;
-
   if ((status != INIT) ||
       (buf==NULL) ||
       (num < 0)) {
     rc=RAND_R_PRNG_INVALID_ARG; 
     goto cleanup;
   }
-  ICC_LockMutex(&(tctx[tid].mtx));
-  /* If it was never initialized  */
-  if (NULL == tctx[tid].rng ) {
-    rc = init_trng(tid);
-  }
+  if (per_thread) {
+    /* No lock, only this thread ever uses it */
+    TLS_BLOCK *t = tls_get();
+    if (NULL == t) {
+      rc = RAND_R_PRNG_NOT_INITIALIZED;
+    } else if (NULL == t->trng) {
+      rc = init_rng(&(t->trng));
+    }
+    if (rc == RAND_R_PRNG_OK) {
+      if (reseed_due(t->trng, 0)) {
+        /* GetRNGReseeds() reads it under tls_mtx */
+        ICC_LockMutex(&tls_mtx);
+        t->inline_reseeds++;
+        ICC_UnlockMutex(&tls_mtx);
+      }
+      memset(buf,0,num);
+      state = RNG_Generate(t->trng, buf, num, NULL, 0);
+    }
+  } else {
+    tid = ICC_GetThreadId() % N_rngs;
 
-  if (rc == RAND_R_PRNG_OK) {
-    if (tctx[tid].bytes > 16) { /* Don't bother unless there's a decent amount of aad */
-      aad = tctx[tid].aad;
-      /* Pick up the TID as well, just to make sure the AAD fed to each
-               RNG does differ */
-      aadl = tctx[tid].bytes + 1;
-      tctx[tid].bytes = 0; /* Reset the aad accumulator state */
-      tctx[tid].index = 1;
+    ICC_LockMutex(&(tctx[tid].mtx));
+    /* If it was never initialized  */
+    if (NULL == tctx[tid].rng ) {
+      rc = init_rng(&(tctx[tid].rng));
     }
-    memset(buf,0,num);
-    state = RNG_Generate(tctx[tid].rng, buf, num, aad, aadl);
 
-    switch (state) {
-    case SP800_90RUN:
-    case SP800_90RESEED:
-      break;
-    default:
-      rc = RAND_R_PRNG_CRYPT_TEST_FAILED;
-      break;
+    if (rc == RAND_R_PRNG_OK) {
+      if (tctx[tid].bytes > 16) { /* Don't bother unless there's a decent amount of aad */
+        aad = tctx[tid].aad;
+        /* Pick up the TID as well, just to make sure the AAD fed to each
+                 RNG does differ */
+        aadl = tctx[tid].bytes + 1;
+        tctx[tid].bytes = 0; /* Reset the aad accumulator state */
+        tctx[tid].index = 1;
+      }
+      if (reseed_due(tctx[tid].rng, 0)) {
+        tctx[tid].inline_reseeds++;
+      }
+      memset(buf,0,num);
+      state = RNG_Generate(tctx[tid].rng, buf, num, aad, aadl);
     }
+    ICC_UnlockMutex(&(tctx[tid].mtx));
+  }
 
+  switch (state) {
+  case SP800_90RUN:
+  case SP800_90RESEED:
+    break;
+  default:
+    rc = RAND_R_PRNG_CRYPT_TEST_FAILED;
+    break;
   }
-  ICC_UnlockMutex(&(tctx[tid].mtx));
 
 cleanup:
   if (rc != RAND_R_PRNG_OK) {
@@ -523,9 +1014,8 @@ cleanup:
 */
 static int fips_rand_pseudo_bytes(unsigned char *buf, int num) {
   int rc = RAND_R_PRNG_OK;
-  SP800_90STATE state;
+  SP800_90STATE state = SP800_90RUN;
   int tid = 0;
-  tid = ICC_GetThreadId() % N_rngs;
 
   if ((status != INIT) ||
       (buf==NULL) ||
@@ -534,15 +1024,39 @@ static int fips_rand_pseudo_bytes(unsigned char *buf, int num) {
     goto cleanup;
   }
 
-  ICC_LockMutex(&(pctx[tid].mtx));
+  if (per_thread) {
+    /* No lock, only this thread ever uses it */
+    TLS_BLOCK *t = tls_get();
+    if (NULL == t) {
+      rc = RAND_R_PRNG_NOT_INITIALIZED;
+    } else if (NULL == t->prng) {
+      rc = init_rng(&(t->prng));
+    }
+    if (rc == RAND_R_PRNG_OK) {
+      if (reseed_due(t->prng, 0)) {
+        /* GetRNGReseeds() reads it under tls_mtx */
+        ICC_LockMutex(&tls_mtx);
+        t->inline_reseeds++;
+        ICC_UnlockMutex(&tls_mtx);
+      }
+      state = RNG_Generate(t->prng,buf,num,NULL,0);
+    }
+  } else {
+    tid = ICC_GetThreadId() % N_rngs;
+
+    ICC_LockMutex(&(pctx[tid].mtx));
 
-  if( rc == RAND_R_PRNG_OK ) {
     if(NULL == pctx[tid].rng) {
-      rc = init_prng(tid);
+      rc = init_rng(&(pctx[tid].rng));
     }
+    if( rc == RAND_R_PRNG_OK ) {
+      if (reseed_due(pctx[tid].rng, 0)) {
+        pctx[tid].inline_reseeds++;
+      }
+      state = RNG_Generate(pctx[tid].rng,buf,num,NULL,0);
+    }
+    ICC_UnlockMutex(&(pctx[tid].mtx));
   }
- 
-  state = RNG_Generate(pctx[tid].rng,buf,num,NULL,0);
 
   /* We could be in a RUN or RESEED state on return
    */
@@ -554,7 +1068,6 @@ static int fips_rand_pseudo_bytes(unsigned char *buf, int num) {
     rc=RAND_R_PRNG_CRYPT_TEST_FAILED;
     break;
   }
-  ICC_UnlockMutex(&(pctx[tid].mtx));
 
 cleanup:  
   if (rc != RAND_R_PRNG_OK) {
@@ -582,6 +1095,10 @@ static  int fips_rand_status(void){
 static void fips_rand_cleanup(void) {
   int rc = RAND_R_PRNG_OK;
   int i = 0;
+
+  reseed_end();
+  TRNG_ReservoirStop();
+  TRNG_PoolStop();
   if (NULL != pctx) {
     for (i = 0; i < N_rngs; i++) {
       if (NULL != pctx[i].rng) {
@@ -605,6 +1122,7 @@ static void fips_rand_cleanup(void) {
     ICC_Free(tctx);
     tctx = NULL;
   }
+  tls_cleanup();
   status = UNDEF;
 
   if (rc != RAND_R_PRNG_OK) {
@@ -107,6 +107,58 @@ int GetRNGInstances();
 */
 int SetRNGInstances(int instances);
 
+/*!
+  @brief return 1 if each thread has it's own RNG instances
+*/
+int GetRNGPerThread();
+
+/*!
+  @brief give each thread it's own RNG instances rather than
+         sharing the locked pool
+  @param on 1 to enable, 0 to use the pool
+  @return 1 on sucess, 0 otherwise
+  @note this must be called before the first ICC_Attach()
+*/
+int SetRNGPerThread(int on);
+
+/*!
+  @brief return 1 if the background reseed thread is enabled
+*/
+int GetRNGReseedThread();
+
+/*!
+  @brief enable a thread which reseeds the pooled RNG's shortly
+         before they reach their reseed limit
+  @param on 1 to enable, 0 to disable
+  @return 1 on sucess, 0 otherwise
+  @note this must be called before the first ICC_Attach()
+*/
+int SetRNGReseedThread(int on);
+
+/*!
+  @brief return 1 if periodic DRBG self tests are deferred to
+         the background thread
+*/
+int GetRNGTestThread();
+
+/*!
+  @brief run the periodic DRBG self tests on a background thread
+         (the reseed thread) rather than inline when a DRBG is
+         instantiated
+  @param on 1 to enable, 0 to disable
+  @return 1 on sucess, 0 otherwise
+  @note this must be called before the first ICC_Attach()
+*/
+int SetRNGTestThread(int on);
+
+/*!
+  @brief return the number of RNG reseeds so far
+  @param background 0 for reseeds done inline during a generate call,
+         1 for reseeds done in advance by the reseed thread
+  @return the reseed count
+*/
+int GetRNGReseeds(int background);
+
 
 
 #endif /* HEADER_FIPS_PRNG_RAND_H */
@@ -0,0 +1,329 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: Multi-buffer Hashgen for the SP800-90 Hash DRBG
+//
+*************************************************************************/
+
+/*
+  Hashgen produces Hash(V) || Hash(V+1) || ...
+  The Hash DRBG seedlen is 55 bytes for SHA-224/256 and 111 bytes
+  for SHA-384/512 so each input, padded, is exactly one compression
+  block started from the standard IV and the blocks don't depend on
+  each other. We compute them side by side, one block per vector lane,
+  which avoids the per block EVP Init/Update/Final overhead and
+  makes use of AVX2/AVX-512 on x86_64.
+
+  There's deliberately no scalar SHA here, without a vector unit
+  Hashgen() declines and the caller uses EVP. So it does for SHA-224/256
+  on CPU's with the SHA extensions, which EVP already uses, and for SHA-1
+  and anything else we don't recognize.
+*/
+
+#include "icclib.h"
+#include "hashgen.h"
+#include "utils.h"
+
+#include <openssl/sha.h>
+
+#if defined(_WIN32) && !defined(__GNUC__)
+#define HG_U64(C) C##ui64
+#else
+#define HG_U64(C) C##ULL
+#endif
+
+#if defined(__x86_64__) && \
+  (defined(__clang__) || (defined(__GNUC__) && (__GNUC__ >= 5)))
+#define HASHGEN_X86 1
+/* The crypto capability vector, ICC_CAP_MASK is applied to this */
+extern unsigned int *OPENSSL_ia32cap_loc(void);
+#endif
+
+#if defined(HASHGEN_X86)
+static const unsigned char C01[1] = {0x01};
+
+static const SHA_LONG K256[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+  0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+  0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+  0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+  0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+  0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+  0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const SHA_LONG64 K512[80] = {
+  HG_U64(0x428a2f98d728ae22), HG_U64(0x7137449123ef65cd),
+  HG_U64(0xb5c0fbcfec4d3b2f), HG_U64(0xe9b5dba58189dbbc),
+  HG_U64(0x3956c25bf348b538), HG_U64(0x59f111f1b605d019),
+  HG_U64(0x923f82a4af194f9b), HG_U64(0xab1c5ed5da6d8118),
+  HG_U64(0xd807aa98a3030242), HG_U64(0x12835b0145706fbe),
+  HG_U64(0x243185be4ee4b28c), HG_U64(0x550c7dc3d5ffb4e2),
+  HG_U64(0x72be5d74f27b896f), HG_U64(0x80deb1fe3b1696b1),
+  HG_U64(0x9bdc06a725c71235), HG_U64(0xc19bf174cf692694),
+  HG_U64(0xe49b69c19ef14ad2), HG_U64(0xefbe4786384f25e3),
+  HG_U64(0x0fc19dc68b8cd5b5), HG_U64(0x240ca1cc77ac9c65),
+  HG_U64(0x2de92c6f592b0275), HG_U64(0x4a7484aa6ea6e483),
+  HG_U64(0x5cb0a9dcbd41fbd4), HG_U64(0x76f988da831153b5),
+  HG_U64(0x983e5152ee66dfab), HG_U64(0xa831c66d2db43210),
+  HG_U64(0xb00327c898fb213f), HG_U64(0xbf597fc7beef0ee4),
+  HG_U64(0xc6e00bf33da88fc2), HG_U64(0xd5a79147930aa725),
+  HG_U64(0x06ca6351e003826f), HG_U64(0x142929670a0e6e70),
+  HG_U64(0x27b70a8546d22ffc), HG_U64(0x2e1b21385c26c926),
+  HG_U64(0x4d2c6dfc5ac42aed), HG_U64(0x53380d139d95b3df),
+  HG_U64(0x650a73548baf63de), HG_U64(0x766a0abb3c77b2a8),
+  HG_U64(0x81c2c92e47edaee6), HG_U64(0x92722c851482353b),
+  HG_U64(0xa2bfe8a14cf10364), HG_U64(0xa81a664bbc423001),
+  HG_U64(0xc24b8b70d0f89791), HG_U64(0xc76c51a30654be30),
+  HG_U64(0xd192e819d6ef5218), HG_U64(0xd69906245565a910),
+  HG_U64(0xf40e35855771202a), HG_U64(0x106aa07032bbd1b8),
+  HG_U64(0x19a4c116b8d2d0c8), HG_U64(0x1e376c085141ab53),
+  HG_U64(0x2748774cdf8eeb99), HG_U64(0x34b0bcb5e19b48a8),
+  HG_U64(0x391c0cb3c5c95a63), HG_U64(0x4ed8aa4ae3418acb),
+  HG_U64(0x5b9cca4f7763e373), HG_U64(0x682e6ff3d6b2b8a3),
+  HG_U64(0x748f82ee5defb2fc), HG_U64(0x78a5636f43172f60),
+  HG_U64(0x84c87814a1f0ab72), HG_U64(0x8cc702081a6439ec),
+  HG_U64(0x90befffa23631e28), HG_U64(0xa4506cebde82bde9),
+  HG_U64(0xbef9a3f7b2c67915), HG_U64(0xc67178f2e372532b),
+  HG_U64(0xca273eceea26619c), HG_U64(0xd186b8c721c0c207),
+  HG_U64(0xeada7dd6cde0eb1e), HG_U64(0xf57d4f7fee6ed178),
+  HG_U64(0x06f067aa72176fba), HG_U64(0x0a637dc5a2c898a6),
+  HG_U64(0x113f9804bef90dae), HG_U64(0x1b710b35131c471b),
+  HG_U64(0x28db77f523047d84), HG_U64(0x32caab7b40c72493),
+  HG_U64(0x3c9ebe0a15c9bebc), HG_U64(0x431d67c49c100d4c),
+  HG_U64(0x4cc5d4becb3e42b6), HG_U64(0x597f299cfc657e2a),
+  HG_U64(0x5fcb6fab3ad6faec), HG_U64(0x6c44198c4a475817)
+};
+
+static const SHA_LONG IV224[8] = {
+  0xc1059ed8, 0x367cd507, 0x3070dd17, 0xf70e5939,
+  0xffc00b31, 0x68581511, 0x64f98fa7, 0xbefa4fa4
+};
+
+static const SHA_LONG IV256[8] = {
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+  0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static const SHA_LONG64 IV384[8] = {
+  HG_U64(0xcbbb9d5dc1059ed8), HG_U64(0x629a292a367cd507),
+  HG_U64(0x9159015a3070dd17), HG_U64(0x152fecd8f70e5939),
+  HG_U64(0x67332667ffc00b31), HG_U64(0x8eb44a8768581511),
+  HG_U64(0xdb0c2e0d64f98fa7), HG_U64(0x47b5481dbefa4fa4)
+};
+
+static const SHA_LONG64 IV512[8] = {
+  HG_U64(0x6a09e667f3bcc908), HG_U64(0xbb67ae8584caa73b),
+  HG_U64(0x3c6ef372fe94f82b), HG_U64(0xa54ff53a5f1d36f1),
+  HG_U64(0x510e527fade682d1), HG_U64(0x9b05688c2b3e6c1f),
+  HG_U64(0x1f83d9abfb41bd6b), HG_U64(0x5be0cd19137e2179)
+};
+
+/* FIPS 180-4 functions, written so they work on GCC/clang generic vectors */
+#define ROR32(x,n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define ROR64(x,n) (((x) >> (n)) | ((x) << (64 - (n))))
+#define SHA_CH(x,y,z) (((x) & (y)) ^ (~(x) & (z)))
+#define SHA_MAJ(x,y,z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define S256_S0(x) (ROR32(x,2) ^ ROR32(x,13) ^ ROR32(x,22))
+#define S256_S1(x) (ROR32(x,6) ^ ROR32(x,11) ^ ROR32(x,25))
+#define S256_s0(x) (ROR32(x,7) ^ ROR32(x,18) ^ ((x) >> 3))
+#define S256_s1(x) (ROR32(x,17) ^ ROR32(x,19) ^ ((x) >> 10))
+#define S512_S0(x) (ROR64(x,28) ^ ROR64(x,34) ^ ROR64(x,39))
+#define S512_S1(x) (ROR64(x,14) ^ ROR64(x,18) ^ ROR64(x,41))
+#define S512_s0(x) (ROR64(x,1) ^ ROR64(x,8) ^ ((x) >> 7))
+#define S512_s1(x) (ROR64(x,19) ^ ROR64(x,61) ^ ((x) >> 6))
+
+#define HG_CAT_(a,b) a##b
+#define HG_CAT(a,b) HG_CAT_(a,b)
+
+#define HG_SFX avx2
+#define HG_TARGET "avx2"
+#define HG_L256 8
+#define HG_L512 4
+#include "hashgen_lanes.h"
+#undef HG_SFX
+#undef HG_TARGET
+#undef HG_L256
+#undef HG_L512
+
+#define HG_SFX avx512
+#define HG_TARGET "avx512f"
+#define HG_L256 16
+#define HG_L512 8
+#include "hashgen_lanes.h"
+#undef HG_SFX
+#undef HG_TARGET
+#undef HG_L256
+#undef HG_L512
+
+/* OPENSSL_ia32cap_P[1] bit 28 AVX usable (OS saves YMM state)
+   OPENSSL_ia32cap_P[2] bit 5 AVX2, bit 16 AVX512F, bit 29 SHA extensions
+   OpenSSL already clears these if the OS won't save the wide registers
+*/
+#define HG_AVX (1U << 28)
+#define HG_AVX2 (1U << 5)
+#define HG_AVX512F (1U << 16)
+#define HG_SHA (1U << 29)
+
+typedef void (*HG256_f)(const SHA_LONG *W0,const SHA_LONG *iv,SHA_LONG *H);
+typedef void (*HG512_f)(const SHA_LONG64 *W0,const SHA_LONG64 *iv,SHA_LONG64 *H);
+
+/*!
+  @brief Pick the widest kernel this CPU can run
+  @param wide 0 for SHA-224/256, 1 for SHA-384/512
+  @param f256 returned SHA-256 kernel
+  @param f512 returned SHA-512 kernel
+  @return the number of lanes the kernel processes, 0 if EVP should
+          be used instead
+  @note this is re-evaluated on each call so capability masking
+        (ICC_CAP_MASK) takes effect
+  @note the SHA extensions only cover SHA-1/SHA-256
+*/
+static unsigned int Hashgen_Select(int wide,HG256_f *f256,HG512_f *f512)
+{
+  unsigned int *cap = OPENSSL_ia32cap_loc();
+  if(NULL == cap || (!wide && (cap[2] & HG_SHA))) {
+    return 0;
+  }
+  if(cap[1] & HG_AVX) {
+    if(cap[2] & HG_AVX512F) {
+      *f256 = sha256_lanes_avx512;
+      *f512 = sha512_lanes_avx512;
+      return wide ? 8 : 16;
+    }
+    if(cap[2] & HG_AVX2) {
+      *f256 = sha256_lanes_avx2;
+      *f512 = sha512_lanes_avx2;
+      return wide ? 4 : 8;
+    }
+  }
+  return 0;
+}
+
+int Hashgen(const EVP_MD *md,unsigned char *data,unsigned int seedlen,
+	    unsigned char *out,unsigned int n)
+{
+  SHA_LONG W32[16 * HASHGEN_MAX_LANES];
+  SHA_LONG H32[8 * HASHGEN_MAX_LANES];
+  SHA_LONG64 W64[16 * (HASHGEN_MAX_LANES / 2)];
+  SHA_LONG64 H64[8 * (HASHGEN_MAX_LANES / 2)];
+  unsigned char blk[128];
+  const SHA_LONG *iv32 = NULL;
+  const SHA_LONG64 *iv64 = NULL;
+  HG256_f f256 = NULL;
+  HG512_f f512 = NULL;
+  unsigned int lanes = 1, m = 0, i = 0, j = 0, t = 0;
+  unsigned int dlen = 0, bs = 0, bits = 0;
+  int wide = 0;
+
+  switch(EVP_MD_type(md)) {
+  case NID_sha224:
+    iv32 = IV224;
+    dlen = 28;
+    break;
+  case NID_sha256:
+    iv32 = IV256;
+    dlen = 32;
+    break;
+  case NID_sha384:
+    iv64 = IV384;
+    dlen = 48;
+    wide = 1;
+    break;
+  case NID_sha512:
+    iv64 = IV512;
+    dlen = 64;
+    wide = 1;
+    break;
+  default:
+    return 0;
+  }
+  /* data || 0x80 || length must fit in one block */
+  bs = wide ? 128 : 64;
+  if((seedlen + 1 + (bs / 8)) > bs) {
+    return 0;
+  }
+  lanes = Hashgen_Select(wide,&f256,&f512);
+  if(0 == lanes) {
+    return 0;
+  }
+  bits = seedlen * 8;
+
+  while(n > 0) {
+    m = (n > lanes) ? lanes : n;
+    /* Unused lanes hash zeros and are discarded */
+    memset(W32,0,sizeof(W32));
+    memset(W64,0,sizeof(W64));
+    for(i = 0; i < m; i++) {
+      memset(blk,0,bs);
+      memcpy(blk,data,seedlen);
+      blk[seedlen] = 0x80;
+      blk[bs - 2] = (unsigned char)(bits >> 8);
+      blk[bs - 1] = (unsigned char)bits;
+      for(t = 0; t < 16; t++) {
+	if(wide) {
+	  SHA_LONG64 w = 0;
+	  for(j = 0; j < 8; j++) {
+	    w = (w << 8) | blk[t * 8 + j];
+	  }
+	  W64[t * lanes + i] = w;
+	} else {
+	  W32[t * lanes + i] = ((SHA_LONG)blk[t * 4] << 24) |
+	    ((SHA_LONG)blk[t * 4 + 1] << 16) |
+	    ((SHA_LONG)blk[t * 4 + 2] << 8) | (SHA_LONG)blk[t * 4 + 3];
+	}
+      }
+      /* data = data +1 */
+      Add(data,data,seedlen,(unsigned char *)C01,1);
+    }
+    if(wide) {
+      f512(W64,iv64,H64);
+      for(i = 0; i < m; i++) {
+	for(j = 0; j < dlen; j++) {
+	  out[i * dlen + j] =
+	    (unsigned char)(H64[(j / 8) * lanes + i] >> (56 - 8 * (j % 8)));
+	}
+      }
+    } else {
+      f256(W32,iv32,H32);
+      for(i = 0; i < m; i++) {
+	for(j = 0; j < dlen; j++) {
+	  out[i * dlen + j] =
+	    (unsigned char)(H32[(j / 4) * lanes + i] >> (24 - 8 * (j % 4)));
+	}
+      }
+    }
+    out += m * dlen;
+    n -= m;
+  }
+  /* These are about to go out of scope, use a scrub the compiler
+     can't drop */
+  OPENSSL_cleanse(W32,sizeof(W32));
+  OPENSSL_cleanse(H32,sizeof(H32));
+  OPENSSL_cleanse(W64,sizeof(W64));
+  OPENSSL_cleanse(H64,sizeof(H64));
+  OPENSSL_cleanse(blk,sizeof(blk));
+  return 1;
+}
+#else
+int Hashgen(const EVP_MD *md,unsigned char *data,unsigned int seedlen,
+	    unsigned char *out,unsigned int n)
+{
+  return 0;
+}
+#endif
@@ -0,0 +1,42 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: Multi-buffer Hashgen for the SP800-90 Hash DRBG
+//
+*************************************************************************/
+
+#if !defined(HASHGEN_H)
+#define HASHGEN_H
+
+/*!
+  @brief Largest number of Hashgen blocks computed in one pass
+*/
+#define HASHGEN_MAX_LANES 16
+
+/*!
+  @brief Hashgen() for the SP800-90 Hash DRBG
+  Computes Hash(data) || Hash(data+1) || ... for n consecutive
+  values of data.
+  Every seedlen sized input pads to a single compression block
+  so the blocks are independent and are computed several at once
+  with vector instructions where the CPU has them.
+  @param md the digest, only SHA-224/256/384/512 are handled
+  @param data the seedlen byte counter, left at data+n on return
+  @param seedlen the length of data
+  @param out n * digest size bytes of output
+  @param n the number of blocks to generate
+  @return 1 if the output was generated, 0 if the digest/seedlen
+          combination isn't handled here, or there's no vector kernel
+          for this CPU, and data was left unchanged,
+          the caller then uses the EVP path
+*/
+int Hashgen(const EVP_MD *md,unsigned char *data,unsigned int seedlen,
+	    unsigned char *out,unsigned int n);
+
+#endif
@@ -0,0 +1,109 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: Multi-lane SHA-256/SHA-512 single block compression
+//              Included by hashgen.c once per vector width
+//
+*************************************************************************/
+
+/*
+  Expects
+  HG_SFX     name suffix for this instance
+  HG_TARGET  instruction set for the target() attribute
+  HG_L256    SHA-256 lanes (32 bit elements)
+  HG_L512    SHA-512 lanes (64 bit elements)
+  The lanes are the vector elements, GCC/clang generic vectors
+  keep this a straight transcription of FIPS 180-4.
+  Input words are W[t * lanes + lane], output words likewise.
+*/
+
+#define HG_V32 HG_CAT(hg_v32_,HG_SFX)
+#define HG_V64 HG_CAT(hg_v64_,HG_SFX)
+
+typedef SHA_LONG HG_V32 __attribute__((vector_size(HG_L256 * 4)));
+typedef SHA_LONG64 HG_V64 __attribute__((vector_size(HG_L512 * 8)));
+
+static __attribute__((target(HG_TARGET))) void
+HG_CAT(sha256_lanes_,HG_SFX)(const SHA_LONG *W0,const SHA_LONG *iv,SHA_LONG *H)
+{
+  HG_V32 W[16];
+  HG_V32 a,b,c,d,e,f,g,h,T1,T2;
+  int t;
+
+  for(t = 0; t < 16; t++) {
+    memcpy(&W[t],W0 + t * HG_L256,sizeof(HG_V32));
+  }
+  memset(&a,0,sizeof(a));
+  b = c = d = e = f = g = h = a;
+  a += iv[0]; b += iv[1]; c += iv[2]; d += iv[3];
+  e += iv[4]; f += iv[5]; g += iv[6]; h += iv[7];
+
+  for(t = 0; t < 64; t++) {
+    if(t >= 16) {
+      W[t & 15] += S256_s1(W[(t + 14) & 15]) + W[(t + 9) & 15] +
+                   S256_s0(W[(t + 1) & 15]);
+    }
+    T1 = h + S256_S1(e) + SHA_CH(e,f,g) + K256[t] + W[t & 15];
+    T2 = S256_S0(a) + SHA_MAJ(a,b,c);
+    h = g; g = f; f = e; e = d + T1;
+    d = c; c = b; b = a; a = T1 + T2;
+  }
+  a += iv[0]; b += iv[1]; c += iv[2]; d += iv[3];
+  e += iv[4]; f += iv[5]; g += iv[6]; h += iv[7];
+  memcpy(H + 0 * HG_L256,&a,sizeof(a));
+  memcpy(H + 1 * HG_L256,&b,sizeof(b));
+  memcpy(H + 2 * HG_L256,&c,sizeof(c));
+  memcpy(H + 3 * HG_L256,&d,sizeof(d));
+  memcpy(H + 4 * HG_L256,&e,sizeof(e));
+  memcpy(H + 5 * HG_L256,&f,sizeof(f));
+  memcpy(H + 6 * HG_L256,&g,sizeof(g));
+  memcpy(H + 7 * HG_L256,&h,sizeof(h));
+  OPENSSL_cleanse(W,sizeof(W));
+}
+
+static __attribute__((target(HG_TARGET))) void
+HG_CAT(sha512_lanes_,HG_SFX)(const SHA_LONG64 *W0,const SHA_LONG64 *iv,SHA_LONG64 *H)
+{
+  HG_V64 W[16];
+  HG_V64 a,b,c,d,e,f,g,h,T1,T2;
+  int t;
+
+  for(t = 0; t < 16; t++) {
+    memcpy(&W[t],W0 + t * HG_L512,sizeof(HG_V64));
+  }
+  memset(&a,0,sizeof(a));
+  b = c = d = e = f = g = h = a;
+  a += iv[0]; b += iv[1]; c += iv[2]; d += iv[3];
+  e += iv[4]; f += iv[5]; g += iv[6]; h += iv[7];
+
+  for(t = 0; t < 80; t++) {
+    if(t >= 16) {
+      W[t & 15] += S512_s1(W[(t + 14) & 15]) + W[(t + 9) & 15] +
+                   S512_s0(W[(t + 1) & 15]);
+    }
+    T1 = h + S512_S1(e) + SHA_CH(e,f,g) + K512[t] + W[t & 15];
+    T2 = S512_S0(a) + SHA_MAJ(a,b,c);
+    h = g; g = f; f = e; e = d + T1;
+    d = c; c = b; b = a; a = T1 + T2;
+  }
+  a += iv[0]; b += iv[1]; c += iv[2]; d += iv[3];
+  e += iv[4]; f += iv[5]; g += iv[6]; h += iv[7];
+  memcpy(H + 0 * HG_L512,&a,sizeof(a));
+  memcpy(H + 1 * HG_L512,&b,sizeof(b));
+  memcpy(H + 2 * HG_L512,&c,sizeof(c));
+  memcpy(H + 3 * HG_L512,&d,sizeof(d));
+  memcpy(H + 4 * HG_L512,&e,sizeof(e));
+  memcpy(H + 5 * HG_L512,&f,sizeof(f));
+  memcpy(H + 6 * HG_L512,&g,sizeof(g));
+  memcpy(H + 7 * HG_L512,&h,sizeof(h));
+  OPENSSL_cleanse(W,sizeof(W));
+}
+
+#undef HG_V32
+#undef HG_V64
@@ -56,6 +56,7 @@ struct ICC_KDF_t;
 struct ICC_DSA_SIG_t;
 struct ICC_CMAC_CTX_t;
 struct ICC_AES_GCM_CTX_t;
+struct ICC_AES_CCM_CTX_t;
 struct ICC_EVP_PKEY_CTX_t;
 struct ICC_ASN1_OBJECT_t;
 /*! @brief 
@@ -234,6 +235,13 @@ typedef struct ICC_CMAC_CTX_t         ICC_CMAC_CTX;
 */   
 typedef struct ICC_AES_GCM_CTX_t         ICC_AES_GCM_CTX;
 
+/*! @brief  
+   - Placeholder for AES_CCM structures
+   - Must be allocated/freed using ICC API's only.    
+   - No user accessable components inside.
+*/   
+typedef struct ICC_AES_CCM_CTX_t         ICC_AES_CCM_CTX;
+
 /*! @brief  
    - Placeholder for DSA_SIG structures
    - Must be allocated/freed using ICC API's only.    
@@ -501,6 +501,17 @@ typedef enum {
                                       To clear the callback, close the context and
                                       create a new one.
                                 */                                    				
+  ICC_RNG_RESEEDS_INLINE = 21,  /*!< Number of times a caller of the pooled 
+                                     RNG's has had to wait for a reseed 
+                                     - Read only, int
+                                     - FIPS: Allowed in FIPS mode
+                                */
+  ICC_RNG_RESEEDS_BACKGROUND = 22, /*!< Number of pooled RNG reseeds done in 
+                                     advance by the reseed thread 
+                                     (ICC_RNG_RESEED_THREAD)
+                                     - Read only, int
+                                     - FIPS: Allowed in FIPS mode
+                                */
   GSK_ICC_ACTIVE_LIBS = 52     /*!< Integer bit mask, the low two bits are used.
                                      Bit 0 = 1 the FIPS library is loadable
                                      Bit 1 = 1 the non-FIPS library is loadable
@@ -558,6 +569,51 @@ typedef enum {
 #define ICC_AES_GCM_CTRL_GET_ACCEL 1
  /*! @brief Force check of TLSV1.3 compatible GCM IV rollover, set only, no parameters */ 
 #define ICC_AES_GCM_CTRL_TLS13 2
+ /*! @brief get the ICC_GHASH() implementation, ptr is an int set to
+     0 portable 4 bit table, 1 PCLMULQDQ, 2 VPCLMULQDQ, 3 ARMv8 PMULL
+ */
+#define ICC_AES_GCM_CTRL_GHASH_IMPL 8
+
+/*! @brief One record for ICC_AES_GCM_SealBatch()/ICC_AES_GCM_OpenBatch().
+    The caller owns all the buffers.
+*/
+typedef struct ICC_AES_GCM_REC_t {
+  unsigned char *iv;      /*!< IV for this record, 12 bytes is best */
+  unsigned long ivlen;    /*!< Length of the IV */
+  unsigned char *aad;     /*!< Additional authenticated data, may be NULL if aadlen is 0 */
+  unsigned long aadlen;   /*!< Length of the aad */
+  unsigned char *in;      /*!< Plaintext (seal) or ciphertext (open) */
+  unsigned char *out;     /*!< Output, inlen bytes, may be in */
+  unsigned long inlen;    /*!< Length of the input */
+  unsigned char *tag;     /*!< Tag, written (seal) or checked (open) */
+  unsigned int taglen;    /*!< Length of the tag, 1-16 bytes */
+  int rv;                 /*!< Set to the result for this record, as ICC_AES_GCM_Seal()/Open() */
+} ICC_AES_GCM_REC;
+
+/*! @brief One buffer segment for ICC_AES_GCM_EncryptUpdateV()/DecryptUpdateV().
+    The caller owns the buffer.
+*/
+typedef struct ICC_AES_GCM_IOV_t {
+  unsigned char *base;    /*!< Start of the segment, may be NULL if len is 0 */
+  unsigned long len;      /*!< Length of the segment */
+} ICC_AES_GCM_IOV;
+
+/*! @brief One message for ICC_AES_CCM_SealBatch()/ICC_AES_CCM_OpenBatch().
+    The layout of in and out is as ICC_AES_CCM_Encrypt()/Decrypt(),
+    the tag follows the ciphertext. The caller owns all the buffers.
+*/
+typedef struct ICC_AES_CCM_REC_t {
+  unsigned char *nonce;   /*!< Nonce for this message, 7-13 bytes */
+  unsigned int nlen;      /*!< Length of the nonce */
+  unsigned char *aad;     /*!< Additional authenticated data, may be NULL if aadlen is 0 */
+  unsigned long aadlen;   /*!< Length of the aad */
+  unsigned char *in;      /*!< Plaintext (seal) or ciphertext and tag (open) */
+  unsigned long inlen;    /*!< Length of the input, including the tag for open */
+  unsigned char *out;     /*!< Output, ciphertext and tag (seal) or plaintext (open), may be in */
+  unsigned long outlen;   /*!< Set to the length of the output */
+  unsigned int taglen;    /*!< Length of the tag, 4-16 bytes, even */
+  int rv;                 /*!< Set to the result for this message, as ICC_AES_CCM_Seal()/Open() */
+} ICC_AES_CCM_REC;
 
 
 /*!
@@ -621,7 +677,14 @@ typedef enum {
   SP800_90_GETMAXNONCE,   /*!< Returns the maximum nonce allowed in this mode */
   SP800_90_SETAUTO,       /*!< Set the autoreseed status - defaults to on (!0) */
   SP800_90_GETAUTO,       /*! Get the autoreseed status 0 == off !0 == on */
-  SP800_90_SET_PARANOID   /*!< Set prediction resistance mode, continually reseed. (slow) */
+  SP800_90_SET_PARANOID,  /*!< Set prediction resistance mode, continually reseed. (slow) */
+  SP800_90_GETCALLS,      /*!< Get the number of Generate calls since the last (re)seed,
+                               compare with SP800_90_GETRESEED */
+  SP800_90_GETSIZE,       /*!< Get the bytes of memory held by this context,
+                               including it's seed source */
+  SP800_90_GETTESTTIME    /*!< Get the duration (microseconds) of the last
+                               self test run of the PRNG method used by this
+                               context, 0 if it hasn't run yet */
 } SP800_90CTRL;
 
 /*
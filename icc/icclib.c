@@ -34,6 +34,10 @@
 #include "iccerr.h"
 #include "TRNG/entropy_estimator.h"
 #include "TRNG/ICC_NRBG.h"
+#include "TRNG/entropy_reservoir.h"
+#include "TRNG/trng_pool.h"
+#include "TRNG/timer_cache.h"
+#include "TRNG/TRNG_FIPS.h"
 #include "openssl/opensslv.h"
 #include "crypto/evp.h"
 #include "openssl/evp.h"
@@ -466,6 +470,115 @@ static void EnvVars()
     i = atoi(tmp);
     SetRNGInstances(i);
   }
+  /*! \EnvVar ICC_RNG_PER_THREAD
+    - 1 gives each thread it's own lazily created RNG's rather
+      than sharing the ICC_RNG_INSTANCES locked pool. 
+      Improves scaling with many threads, costs memory per thread.
+    - FIPS mode: Yes
+   */
+
+  tmp = getenv("ICC_RNG_PER_THREAD");
+  if(NULL != tmp) {
+    MARK("ICC_RNG_PER_THREAD", tmp);
+    SetRNGPerThread(atoi(tmp));
+  }
+  /*! \EnvVar ICC_RNG_RESEED_THREAD
+    - 1 starts a thread which reseeds the pooled RNG's shortly
+      before they reach their reseed limit so callers seldom
+      wait for a reseed.
+      See ICC_RNG_RESEEDS_INLINE, ICC_RNG_RESEEDS_BACKGROUND
+    - FIPS mode: Yes
+   */
+
+  tmp = getenv("ICC_RNG_RESEED_THREAD");
+  if(NULL != tmp) {
+    MARK("ICC_RNG_RESEED_THREAD", tmp);
+    SetRNGReseedThread(atoi(tmp));
+  }
+  /*! \EnvVar ICC_RNG_TEST_THREAD
+    - 1 runs the periodic DRBG self tests on a background thread
+      shortly before they are due, rather than inline for the caller
+      which creates the SELF_TEST_AT'th instance of a DRBG type.
+      New instances still wait for a self test if the last one 
+      failed or the background thread falls behind.
+    - The duration of the last run is available from 
+      ICC_RNG_CTX_ctrl(SP800_90_GETTESTTIME)
+    - FIPS mode: Yes, the tests and their frequency are unchanged
+   */
+
+  tmp = getenv("ICC_RNG_TEST_THREAD");
+  if(NULL != tmp) {
+    MARK("ICC_RNG_TEST_THREAD", tmp);
+    SetRNGTestThread(atoi(tmp));
+  }
+  /*! \EnvVar ICC_TRNG_RESERVOIR
+    - Size in bytes (up to 65536) of a reservoir of seed data 
+      harvested in the background so DRBG instantiate/reseed 
+      seldom wait for entropy collection. 0, the default, disables it.
+    - FIPS mode: Yes, the data is produced and tested exactly
+      as inline seed data is
+   */
+
+  tmp = getenv("ICC_TRNG_RESERVOIR");
+  if(NULL != tmp) {
+    MARK("ICC_TRNG_RESERVOIR", tmp);
+    SetTRNGReservoir(atoi(tmp));
+  }
+  /*! \EnvVar ICC_TRNG_POOL
+    - Number of TRNG instances (up to 64) shared by the DRBG's
+      created after ICC startup, selected by CPU. Each DRBG then
+      doesn't need it's own TRNG, which makes instantiation much
+      cheaper in time and memory. 0, the default, disables it.
+    - Something around the number of CPU's is a reasonable size
+    - FIPS mode: Yes, every seed is still a separate health tested
+      request to a TRNG
+   */
+
+  tmp = getenv("ICC_TRNG_POOL");
+  if(NULL != tmp) {
+    MARK("ICC_TRNG_POOL", tmp);
+    SetTRNGPool(atoi(tmp));
+  }
+  /*! \EnvVar ICC_TRNG_SAMPLERS
+    - Number of threads (1-16) collecting timer noise for each
+      TRNG_FIPS instance. Each thread's samples are filtered and
+      health tested separately. 1, the default, is serial collection.
+    - Raises TRNG_FIPS throughput on hosts with idle cores
+    - FIPS mode: Yes
+   */
+
+  tmp = getenv("ICC_TRNG_SAMPLERS");
+  if(NULL != tmp) {
+    MARK("ICC_TRNG_SAMPLERS", tmp);
+    SetTRNGSamplers(atoi(tmp));
+  }
+  /*! \EnvVar ICC_TRNG_ESTIMATOR
+    - Long term entropy estimator run on TRNG output.
+    - DEFLATE, the default, the zlib compression ratio.
+    - MCV, a sliding window most common value estimate (SP800-90B 6.3.1),
+      much cheaper per byte and a few hundred bytes of state per TRNG
+      rather than a deflate stream.
+    - FIPS mode: Yes
+   */
+
+  tmp = getenv("ICC_TRNG_ESTIMATOR");
+  if(NULL != tmp) {
+    MARK("ICC_TRNG_ESTIMATOR", tmp);
+    SetEntropyEstimator(tmp);
+  }
+  /*! \EnvVar ICC_TRNG_CONDITIONER
+    - Conditioning function applied to raw noise in the TRNG.
+    - HMAC, the default, HMAC-SHA256 with the per-instance key.
+    - SHA256, SHA-256 over each pass of raw data, read in larger blocks,
+      about half the hashing work per seed byte.
+    - FIPS mode: Yes, both are SP800-90B vetted conditioning functions
+   */
+
+  tmp = getenv("ICC_TRNG_CONDITIONER");
+  if(NULL != tmp) {
+    MARK("ICC_TRNG_CONDITIONER", tmp);
+    SetTRNGConditioner(tmp);
+  }
   /*! \EnvVar ICC_TRNG
     - Sets the type of the TRNG used by default.
    */
@@ -537,6 +650,20 @@ static void EnvVars()
     i = atoi(tmp);
     ex_loops = i;
   }
+  /*! \EnvVar ICC_TIMER_CACHE
+    - Path of a timer calibration cache written by TimerCal
+    - Skips most of the TRNG timer calibration on startup when the file
+      matches this CPU, kernel and ICC version, a quick spot check is
+      done instead. Otherwise it's ignored.
+    - ICC_SHIFT and ICC_LOOPS still take precedence
+    - FIPS mode: Yes
+  */
+
+  tmp = getenv("ICC_TIMER_CACHE");
+  if(NULL != tmp) {
+    MARK("ICC_TIMER_CACHE", tmp);
+    SetTimerCache(tmp);
+  }
   /*! \EnvVar ICC_ALLOW_2KEY3DES
     - Allows 3 DES with 2 keys the same
     - FIPS mode: No
@@ -623,6 +750,11 @@ void SetParams(char *params[],int n)
           MARK("ICC_LOOPS", ptr);
           ex_loops = atoi(ptr);
         }
+
+        if (0 == strncmp(params[i], "ICC_TIMER_CACHE", strlen("ICC_TIMER_CACHE"))) {
+          MARK("ICC_TIMER_CACHE", ptr);
+          SetTimerCache(ptr);
+        }
 #if (NON_FIPS_ICC == 1)
         if (0 == strncmp(params[i], "ICC_RUN_POST", strlen("ICC_RUN_POST"))) {
           MARK("ICC_RUN_POST", ptr);
@@ -642,7 +774,56 @@ void SetParams(char *params[],int n)
           SetRNGInstances(atoi(ptr));
         }
 
-        if (0 == strncmp(params[i], "ICC_TRNG", strlen("ICC_TRNG"))) {
+        if (0 == strncmp(params[i], "ICC_RNG_PER_THREAD",
+                         strlen("ICC_RNG_PER_THREAD"))) {
+          MARK("ICC_RNG_PER_THREAD", ptr);
+          SetRNGPerThread(atoi(ptr));
+        }
+
+        if (0 == strncmp(params[i], "ICC_RNG_RESEED_THREAD",
+                         strlen("ICC_RNG_RESEED_THREAD"))) {
+          MARK("ICC_RNG_RESEED_THREAD", ptr);
+          SetRNGReseedThread(atoi(ptr));
+        }
+
+        if (0 == strncmp(params[i], "ICC_RNG_TEST_THREAD",
+                         strlen("ICC_RNG_TEST_THREAD"))) {
+          MARK("ICC_RNG_TEST_THREAD", ptr);
+          SetRNGTestThread(atoi(ptr));
+        }
+
+        if (0 == strncmp(params[i], "ICC_TRNG_RESERVOIR",
+                         strlen("ICC_TRNG_RESERVOIR"))) {
+          MARK("ICC_TRNG_RESERVOIR", ptr);
+          SetTRNGReservoir(atoi(ptr));
+        }
+
+        if (0 == strncmp(params[i], "ICC_TRNG_POOL",
+                         strlen("ICC_TRNG_POOL"))) {
+          MARK("ICC_TRNG_POOL", ptr);
+          SetTRNGPool(atoi(ptr));
+        }
+
+        if (0 == strncmp(params[i], "ICC_TRNG_SAMPLERS",
+                         strlen("ICC_TRNG_SAMPLERS"))) {
+          MARK("ICC_TRNG_SAMPLERS", ptr);
+          SetTRNGSamplers(atoi(ptr));
+        }
+
+        if (0 == strncmp(params[i], "ICC_TRNG_ESTIMATOR",
+                         strlen("ICC_TRNG_ESTIMATOR"))) {
+          MARK("ICC_TRNG_ESTIMATOR", ptr);
+          SetEntropyEstimator(ptr);
+        }
+
+        if (0 == strncmp(params[i], "ICC_TRNG_CONDITIONER",
+                         strlen("ICC_TRNG_CONDITIONER"))) {
+          MARK("ICC_TRNG_CONDITIONER", ptr);
+          SetTRNGConditioner(ptr);
+        }
+
+        /* Include the '=', other parameter names start with ICC_TRNG */
+        if (0 == strncmp(params[i], "ICC_TRNG=", strlen("ICC_TRNG="))) {
           MARK("ICC_TRNG", ptr);
           SetTRNGName(ptr);
           trng_set = 1;
@@ -1400,6 +1581,8 @@ int SetValue (ICClib * pcb, ICC_STATUS * status,ICC_VALUE_IDS_ENUM valueID,
                 __LINE__);
     break;
   case ICC_VERSION:
+  case ICC_RNG_RESEEDS_INLINE:
+  case ICC_RNG_RESEEDS_BACKGROUND:
     SetStatusLn(pcb, status, ICC_ERROR, ICC_UNSUPPORTED_VALUE_ID,
                 (char *)"Attempted to set an unsettable value ID", __FILE__,
                 __LINE__);
@@ -1547,6 +1730,8 @@ int GetValue (ICClib * pcb, ICC_STATUS * status,ICC_VALUE_IDS_ENUM valueID,
    case ICC_INDUCED_FAILURE:
    case ICC_LOOPS:
    case ICC_SHIFT:
+   case ICC_RNG_RESEEDS_INLINE:
+   case ICC_RNG_RESEEDS_BACKGROUND:
      tmp = sizeof(int);
      break;
   case ICC_FIPS_CALLBACK:
@@ -1658,6 +1843,14 @@ int GetValue (ICClib * pcb, ICC_STATUS * status,ICC_VALUE_IDS_ENUM valueID,
      *(int *)value = Loops();
       MARK("ICC_LOOPS","");
     break;
+   case ICC_RNG_RESEEDS_INLINE:
+     *(int *)value = GetRNGReseeds(0);
+     MARK("ICC_RNG_RESEEDS_INLINE","");
+     break;
+   case ICC_RNG_RESEEDS_BACKGROUND:
+     *(int *)value = GetRNGReseeds(1);
+     MARK("ICC_RNG_RESEEDS_BACKGROUND","");
+     break;
   case ICC_CPU_CAPABILITY_MASK:
      if(valueLength > 0) {
        *(char *)value = '\0';
@@ -3432,10 +3625,9 @@ int RSA_FixEncodingZeros(RSA* rsa, const RSA* pub, int allowDisableBlinding)
    return ICC_OSSL_SUCCESS;
 }
 
-/* A noop these days */
 void my_GHASH(AES_GCM_CTX *gcm_ctx,unsigned char *H,unsigned char *Hash,unsigned char *data,unsigned long datalen)
 {
-
+  GHASH(gcm_ctx,H,Hash,data,datalen);
 }
 #define MyCalloc(x,y) ICC_Calloc(x,y,__FILE__,__LINE__)
 #define MyFree(x) ICC_Free(x)
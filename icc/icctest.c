@@ -1460,6 +1460,116 @@ int doHMACUnitTest(ICC_CTX *ICC_ctx)
 }
 
 
+/*! @brief Most records GCMBatchCheck() handles */
+#define GCMB_RECS 8
+
+/*!
+  @brief check AES_GCM_SealBatch()/OpenBatch() against AES_GCM_Seal()
+  for records of the given lengths, all with ivlen byte IV's
+  @param ICC_ctx the ICC context
+  @param key the AES key
+  @param klen the key length
+  @param lens the record lengths
+  @param n the number of records, at most GCMB_RECS
+  @param ivlen the IV length, at most 16
+  @return 1 if the batch matched and decrypted, 0 otherwise
+*/
+static int GCMBatchCheck(ICC_CTX *ICC_ctx, unsigned char *key, unsigned int klen,
+                         const unsigned long *lens, unsigned int n, unsigned int ivlen)
+{
+  ICC_AES_GCM_REC recs[GCMB_RECS];
+  unsigned char ivs[GCMB_RECS][16];
+  unsigned char tags[GCMB_RECS][16];
+  unsigned char aad[13];
+  unsigned char tag[16];
+  unsigned char *pt = NULL;
+  unsigned char *ct = NULL;
+  unsigned char *ref = NULL;
+  ICC_AES_GCM_CTX *gcm1 = NULL;
+  ICC_AES_GCM_CTX *gcm2 = NULL;
+  unsigned long total = 0, off = 0, j = 0;
+  unsigned int i;
+  int ok = 1;
+
+  for(i = 0; i < n; i++) {
+    total += lens[i];
+  }
+  pt = (unsigned char *)malloc(total + 1);
+  ct = (unsigned char *)malloc(total + 1);
+  ref = (unsigned char *)malloc(total + 1);
+  gcm1 = ICC_AES_GCM_CTX_new(ICC_ctx);
+  gcm2 = ICC_AES_GCM_CTX_new(ICC_ctx);
+  if((NULL == pt) || (NULL == ct) || (NULL == ref) ||
+     (NULL == gcm1) || (NULL == gcm2)) {
+    ok = 0;
+  } else {
+    for(j = 0; j < total; j++) {
+      pt[j] = (unsigned char)(j * 7 + 3);
+    }
+    for(j = 0; j < sizeof(aad); j++) {
+      aad[j] = (unsigned char)j;
+    }
+    memcpy(ct,pt,total);
+    memset(recs,0,sizeof(recs));
+    for(i = 0, off = 0; i < n; off += lens[i], i++) {
+      memset(ivs[i],0,sizeof(ivs[i]));
+      ivs[i][0] = (unsigned char)ivlen;
+      ivs[i][ivlen - 1] ^= (unsigned char)(i + 1);
+      recs[i].iv = ivs[i];
+      recs[i].ivlen = ivlen;
+      recs[i].aad = (i & 1) ? aad : NULL;
+      recs[i].aadlen = (i & 1) ? sizeof(aad) : 0;
+      recs[i].in = recs[i].out = ct + off; /* In place */
+      recs[i].inlen = lens[i];
+      recs[i].tag = tags[i];
+      recs[i].taglen = 16;
+    }
+    ICC_AES_GCM_Init(ICC_ctx,gcm1,NULL,0,key,klen);
+    ICC_AES_GCM_Init(ICC_ctx,gcm2,NULL,0,key,klen);
+    if(1 != ICC_AES_GCM_SealBatch(ICC_ctx,gcm1,recs,n)) {
+      ok = 0;
+    }
+    for(i = 0, off = 0; ok && (i < n); off += lens[i], i++) {
+      if((1 != ICC_AES_GCM_Seal(ICC_ctx,gcm2,recs[i].iv,recs[i].ivlen,
+                                recs[i].aad,recs[i].aadlen,pt + off,lens[i],
+                                ref,tag,16)) ||
+         (0 != memcmp(ct + off,ref,lens[i])) ||
+         (0 != memcmp(tags[i],tag,16))) {
+        printf("\t\tGCM SealBatch record %u (%lu bytes, %u byte IV) differs from Seal\n",
+               i,lens[i],ivlen);
+        ok = 0;
+      }
+    }
+    /* And back, in place on a fresh context */
+    ICC_AES_GCM_CTX_free(ICC_ctx,gcm1);
+    gcm1 = ICC_AES_GCM_CTX_new(ICC_ctx);
+    if(ok && (NULL != gcm1)) {
+      ICC_AES_GCM_Init(ICC_ctx,gcm1,NULL,0,key,klen);
+      if((1 != ICC_AES_GCM_OpenBatch(ICC_ctx,gcm1,recs,n)) ||
+         (0 != memcmp(ct,pt,total))) {
+        printf("\t\tGCM OpenBatch (%u byte IV) failed\n",ivlen);
+        ok = 0;
+      }
+    }
+  }
+  if(NULL != gcm1) {
+    ICC_AES_GCM_CTX_free(ICC_ctx,gcm1);
+  }
+  if(NULL != gcm2) {
+    ICC_AES_GCM_CTX_free(ICC_ctx,gcm2);
+  }
+  if(NULL != pt) {
+    free(pt);
+  }
+  if(NULL != ct) {
+    free(ct);
+  }
+  if(NULL != ref) {
+    free(ref);
+  }
+  return ok;
+}
+
 int doAES_GCMUnitTest(ICC_CTX *ICC_ctx)
 {
 
@@ -1514,11 +1624,37 @@ int doAES_GCMUnitTest(ICC_CTX *ICC_ctx)
   unsigned char ciphertext[sizeof(gcm_ka_ciphertext)+32];
   unsigned char pt[sizeof(gcm_ka_plaintext)];
   ICC_AES_GCM_CTX *gcm_ctx = NULL;
-  static  unsigned char tmp1[16] = {
-    0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,
-    0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,
+  /* GHASH key, E(K,0^128), for vector 4 */
+  static unsigned char ghash_ka_H[] = {
+    0xb8,0x3b,0x53,0x37,0x08,0xbf,0x53,0x5d,
+    0x0a,0xa6,0xe5,0x29,0x80,0xd5,0x3b,0x78
+  };
+  /* len(A) || len(C) in bits */
+  static unsigned char ghash_ka_len[] = {
+    0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xa0,
+    0x00,0x00,0x00,0x00,0x00,0x00,0x01,0xe0
   };
-  static unsigned char tmp2[16];
+  /* GHASH(H, A || C || len) for vector 4 */
+  static unsigned char ghash_ka_result[] = {
+    0x69,0x8e,0x57,0xf7,0x0e,0x6e,0xcc,0x7f,
+    0xd9,0x46,0x3b,0x72,0x60,0xa9,0xae,0x5f
+  };
+  unsigned char ghash_buf[256];
+  unsigned char tmp1[16];
+  unsigned char tmp2[16];
+  ICC_AES_GCM_REC recs[3];
+  /* Counter blocks (J0 + data) run 33, 64, 3, -, 1, 45, -, 4 so the
+     sixth record straddles the 128 block pass, 1500 and 2049 are
+     over the 1K limit and go through the cipher context */
+  static const unsigned long blens96[] = {500,1000,17,1500,0,700,2049,33};
+  static const unsigned long blens128[] = {64,1000,1200,1000};
+  unsigned char bivs[3][sizeof(gcm_ka_iv)];
+  unsigned char bbuf[3][sizeof(gcm_ka_plaintext)];
+  unsigned char btags[3][16];
+  ICC_AES_GCM_IOV vaad[2];
+  ICC_AES_GCM_IOV vin[3];
+  ICC_AES_GCM_IOV vout[2];
+  int impl = 0;
   int i,j;
   int err = 0;
   memset(Result,0,sizeof(Result));
@@ -1577,13 +1713,220 @@ int doAES_GCMUnitTest(ICC_CTX *ICC_ctx)
       rv = ICC_OPENSSL_ERROR;
     }
 
-    /* And now - a couple of tests just for completeness
-       all these really do is put a tick in the box WRT test coverage
+    /* One shot, key set once and the IV per message */
+    printf("\tTesting AES_GCM Seal/Open\n");
+    for(i = 0; i < 3; i++) {
+      ICC_AES_GCM_CTX *gcm1 = ICC_AES_GCM_CTX_new(ICC_ctx);
+      if(NULL == gcm1) {
+        rv = ICC_OPENSSL_ERROR;
+        break;
+      }
+      ICC_AES_GCM_Init(ICC_ctx,gcm1,NULL,0,gcm_ka_key,sizeof(gcm_ka_key));
+      memset(pt,0,sizeof(pt));
+      memcpy(tmp1,gcm_ka_authtag,sizeof(tmp1));
+      switch(i) {
+      case 0:
+        if((1 != ICC_AES_GCM_Seal(ICC_ctx,gcm1,gcm_ka_iv,sizeof(gcm_ka_iv),gcm_ka_aad,sizeof(gcm_ka_aad),
+                                  gcm_ka_plaintext,sizeof(gcm_ka_plaintext),ciphertext,Result,16)) ||
+           (0 != memcmp(ciphertext,gcm_ka_ciphertext,sizeof(gcm_ka_ciphertext))) ||
+           (0 != memcmp(Result,gcm_ka_authtag,sizeof(gcm_ka_authtag)))) {
+          printf("\t\tGCM Seal failed\n");
+          rv = ICC_OPENSSL_ERROR;
+        }
+        /* The same IV again must be refused */
+        if(1 == ICC_AES_GCM_Seal(ICC_ctx,gcm1,gcm_ka_iv,sizeof(gcm_ka_iv),gcm_ka_aad,sizeof(gcm_ka_aad),
+                                 gcm_ka_plaintext,sizeof(gcm_ka_plaintext),ciphertext,Result,16)) {
+          printf("\t\tGCM Seal accepted a repeated IV\n");
+          rv = ICC_OPENSSL_ERROR;
+        }
+        break;
+      case 1:
+        if((1 != ICC_AES_GCM_Open(ICC_ctx,gcm1,gcm_ka_iv,sizeof(gcm_ka_iv),gcm_ka_aad,sizeof(gcm_ka_aad),
+                                  gcm_ka_ciphertext,sizeof(gcm_ka_ciphertext),pt,tmp1,16)) ||
+           (0 != memcmp(pt,gcm_ka_plaintext,sizeof(gcm_ka_plaintext)))) {
+          printf("\t\tGCM Open failed\n");
+          rv = ICC_OPENSSL_ERROR;
+        }
+        break;
+      default:
+        tmp1[15] ^= 1;
+        if(1 == ICC_AES_GCM_Open(ICC_ctx,gcm1,gcm_ka_iv,sizeof(gcm_ka_iv),gcm_ka_aad,sizeof(gcm_ka_aad),
+                                 gcm_ka_ciphertext,sizeof(gcm_ka_ciphertext),pt,tmp1,16)) {
+          printf("\t\tGCM Open accepted a bad tag\n");
+          rv = ICC_OPENSSL_ERROR;
+        }
+        break;
+      }
+      ICC_AES_GCM_CTX_free(ICC_ctx,gcm1);
+    }
+
+    /* Batch, vector 4, then the same plaintext with no AAD and
+       AAD with no plaintext under new IVs, checked against Seal */
+    printf("\tTesting AES_GCM SealBatch/OpenBatch\n");
+    memset(recs,0,sizeof(recs));
+    for(i = 0; i < 3; i++) {
+      memcpy(bivs[i],gcm_ka_iv,sizeof(gcm_ka_iv));
+      bivs[i][sizeof(gcm_ka_iv)-1] ^= (unsigned char)i;
+      memcpy(bbuf[i],gcm_ka_plaintext,sizeof(gcm_ka_plaintext));
+      recs[i].iv = bivs[i];
+      recs[i].ivlen = sizeof(gcm_ka_iv);
+      recs[i].aad = (1 == i) ? NULL : gcm_ka_aad;
+      recs[i].aadlen = (1 == i) ? 0 : sizeof(gcm_ka_aad);
+      recs[i].in = recs[i].out = bbuf[i]; /* In place */
+      recs[i].inlen = (2 == i) ? 0 : sizeof(gcm_ka_plaintext);
+      recs[i].tag = btags[i];
+      recs[i].taglen = 16;
+    }
+    {
+      ICC_AES_GCM_CTX *gcm1 = ICC_AES_GCM_CTX_new(ICC_ctx);
+      ICC_AES_GCM_CTX *gcm2 = ICC_AES_GCM_CTX_new(ICC_ctx);
+      if((NULL == gcm1) || (NULL == gcm2)) {
+        rv = ICC_OPENSSL_ERROR;
+      } else {
+        ICC_AES_GCM_Init(ICC_ctx,gcm1,NULL,0,gcm_ka_key,sizeof(gcm_ka_key));
+        ICC_AES_GCM_Init(ICC_ctx,gcm2,NULL,0,gcm_ka_key,sizeof(gcm_ka_key));
+        if((1 != ICC_AES_GCM_SealBatch(ICC_ctx,gcm1,recs,3)) ||
+           (0 != memcmp(bbuf[0],gcm_ka_ciphertext,sizeof(gcm_ka_ciphertext))) ||
+           (0 != memcmp(btags[0],gcm_ka_authtag,sizeof(gcm_ka_authtag)))) {
+          printf("\t\tGCM SealBatch failed\n");
+          rv = ICC_OPENSSL_ERROR;
+        }
+        for(i = 1; i < 3; i++) {
+          if((1 != ICC_AES_GCM_Seal(ICC_ctx,gcm2,recs[i].iv,recs[i].ivlen,recs[i].aad,recs[i].aadlen,
+                                    gcm_ka_plaintext,recs[i].inlen,ciphertext,Result,16)) ||
+             (0 != memcmp(bbuf[i],ciphertext,recs[i].inlen)) ||
+             (0 != memcmp(btags[i],Result,16))) {
+            printf("\t\tGCM SealBatch record %d differs from Seal\n",i);
+            rv = ICC_OPENSSL_ERROR;
+          }
+        }
+        /* Open in place on a fresh context, the second tag corrupted */
+        ICC_AES_GCM_CTX_free(ICC_ctx,gcm1);
+        gcm1 = ICC_AES_GCM_CTX_new(ICC_ctx);
+        if(NULL != gcm1) {
+          ICC_AES_GCM_Init(ICC_ctx,gcm1,NULL,0,gcm_ka_key,sizeof(gcm_ka_key));
+          btags[1][0] ^= 1;
+          if((1 == ICC_AES_GCM_OpenBatch(ICC_ctx,gcm1,recs,3)) ||
+             (1 != recs[0].rv) || (1 == recs[1].rv) || (1 != recs[2].rv) ||
+             (0 != memcmp(bbuf[0],gcm_ka_plaintext,sizeof(gcm_ka_plaintext))) ||
+             (0 != bbuf[1][0])) {
+            printf("\t\tGCM OpenBatch failed\n");
+            rv = ICC_OPENSSL_ERROR;
+          }
+        }
+      }
+      if(NULL != gcm1) {
+        ICC_AES_GCM_CTX_free(ICC_ctx,gcm1);
+      }
+      if(NULL != gcm2) {
+        ICC_AES_GCM_CTX_free(ICC_ctx,gcm2);
+      }
+    }
 
-       GHASH is there are a convenience while testing
-    */
+    /* Records across the keystream pass boundary, long records
+       and IV's other than 96 bits, checked against Seal */
+    if(!GCMBatchCheck(ICC_ctx,gcm_ka_key,sizeof(gcm_ka_key),blens96,
+                      sizeof(blens96)/sizeof(blens96[0]),12) ||
+       !GCMBatchCheck(ICC_ctx,gcm_ka_key,sizeof(gcm_ka_key),blens128,
+                      sizeof(blens128)/sizeof(blens128[0]),16)) {
+      rv = ICC_OPENSSL_ERROR;
+    }
+
+    /* Scatter/gather, vector 4 with the aad, input and output each
+       split at different, unaligned points, then back in place */
+    printf("\tTesting AES_GCM EncryptUpdateV/DecryptUpdateV\n");
+    memcpy(bbuf[0],gcm_ka_plaintext,sizeof(gcm_ka_plaintext));
+    vaad[0].base = gcm_ka_aad;
+    vaad[0].len = 5;
+    vaad[1].base = gcm_ka_aad + 5;
+    vaad[1].len = sizeof(gcm_ka_aad) - 5;
+    vin[0].base = bbuf[0];
+    vin[0].len = 1;
+    vin[1].base = bbuf[0] + 1;
+    vin[1].len = 20;
+    vin[2].base = bbuf[0] + 21;
+    vin[2].len = sizeof(gcm_ka_plaintext) - 21;
+    vout[0].base = ciphertext;
+    vout[0].len = 33;
+    vout[1].base = ciphertext + 33;
+    vout[1].len = sizeof(gcm_ka_plaintext) - 33;
+    memset(ciphertext,0,sizeof(ciphertext));
+    {
+      /* A fresh context per direction, the IV is the same */
+      ICC_AES_GCM_CTX *gcm1 = ICC_AES_GCM_CTX_new(ICC_ctx);
+      if(NULL == gcm1) {
+        rv = ICC_OPENSSL_ERROR;
+      } else {
+        ICC_AES_GCM_Init(ICC_ctx,gcm1,gcm_ka_iv,sizeof(gcm_ka_iv),gcm_ka_key,sizeof(gcm_ka_key));
+        outlen = 0;
+        toutlen = 0;
+        if((1 != ICC_AES_GCM_EncryptUpdateV(ICC_ctx,gcm1,vaad,2,vin,3,vout,2,&outlen)) ||
+           (sizeof(gcm_ka_plaintext) != outlen) ||
+           (1 != ICC_AES_GCM_EncryptFinal(ICC_ctx,gcm1,ciphertext+outlen,&toutlen,Result)) ||
+           (0 != memcmp(ciphertext,gcm_ka_ciphertext,sizeof(gcm_ka_ciphertext))) ||
+           (0 != memcmp(Result,gcm_ka_authtag,sizeof(gcm_ka_authtag)))) {
+          printf("\t\tGCM EncryptUpdateV failed\n");
+          rv = ICC_OPENSSL_ERROR;
+        }
+        ICC_AES_GCM_CTX_free(ICC_ctx,gcm1);
+      }
+      memcpy(bbuf[0],gcm_ka_ciphertext,sizeof(gcm_ka_ciphertext));
+      gcm1 = ICC_AES_GCM_CTX_new(ICC_ctx);
+      if(NULL == gcm1) {
+        rv = ICC_OPENSSL_ERROR;
+      } else {
+        ICC_AES_GCM_Init(ICC_ctx,gcm1,gcm_ka_iv,sizeof(gcm_ka_iv),gcm_ka_key,sizeof(gcm_ka_key));
+        outlen = 0;
+        toutlen = 0;
+        if((1 != ICC_AES_GCM_DecryptUpdateV(ICC_ctx,gcm1,vaad,2,vin,3,vin,3,&outlen)) ||
+           (1 != ICC_AES_GCM_DecryptFinal(ICC_ctx,gcm1,bbuf[0]+outlen,&toutlen,gcm_ka_authtag,16)) ||
+           (0 != memcmp(bbuf[0],gcm_ka_plaintext,sizeof(gcm_ka_plaintext)))) {
+          printf("\t\tGCM DecryptUpdateV failed\n");
+          rv = ICC_OPENSSL_ERROR;
+        }
+        ICC_AES_GCM_CTX_free(ICC_ctx,gcm1);
+      }
+    }
+
+    /* This one just puts a tick in the box WRT test coverage */
     ICC_AES_GCM_CTX_ctrl(ICC_ctx,gcm_ctx,ICC_AES_GCM_CTRL_SET_ACCEL,0,NULL);
-    ICC_GHASH(ICC_ctx,gcm_ctx,tmp1,tmp2,gcm_ka_plaintext,sizeof(gcm_ka_plaintext));
+
+    ICC_AES_GCM_CTX_ctrl(ICC_ctx,gcm_ctx,ICC_AES_GCM_CTRL_GHASH_IMPL,0,&impl);
+    printf("\tTesting GHASH, implementation %d\n",impl);
+    /* Chained, A and C with partial last blocks, then the lengths */
+    memset(tmp1,0,sizeof(tmp1));
+    ICC_GHASH(ICC_ctx,gcm_ctx,ghash_ka_H,tmp1,gcm_ka_aad,sizeof(gcm_ka_aad));
+    ICC_GHASH(ICC_ctx,gcm_ctx,ghash_ka_H,tmp1,gcm_ka_ciphertext,sizeof(gcm_ka_ciphertext));
+    ICC_GHASH(ICC_ctx,gcm_ctx,ghash_ka_H,tmp1,ghash_ka_len,sizeof(ghash_ka_len));
+    if(0 != memcmp(tmp1,ghash_ka_result,sizeof(ghash_ka_result))) {
+      printf("\t\tGHASH failed (chained)\n");
+      rv = ICC_OPENSSL_ERROR;
+    }
+    /* The same, in one call and with no context */
+    memset(ghash_buf,0,sizeof(ghash_buf));
+    memcpy(ghash_buf,gcm_ka_aad,sizeof(gcm_ka_aad));
+    memcpy(ghash_buf+32,gcm_ka_ciphertext,sizeof(gcm_ka_ciphertext));
+    memcpy(ghash_buf+96,ghash_ka_len,sizeof(ghash_ka_len));
+    memset(tmp1,0,sizeof(tmp1));
+    ICC_GHASH(ICC_ctx,NULL,ghash_ka_H,tmp1,ghash_buf,112);
+    if(0 != memcmp(tmp1,ghash_ka_result,sizeof(ghash_ka_result))) {
+      printf("\t\tGHASH failed (single call)\n");
+      rv = ICC_OPENSSL_ERROR;
+    }
+    /* Multi block paths against one block at a time */
+    for(i = 0; i < (int)sizeof(ghash_buf); i++) {
+      ghash_buf[i] = (unsigned char)(i * 7 + 3);
+    }
+    memset(tmp1,0,sizeof(tmp1));
+    memset(tmp2,0,sizeof(tmp2));
+    ICC_GHASH(ICC_ctx,gcm_ctx,ghash_ka_H,tmp1,ghash_buf,sizeof(ghash_buf));
+    for(i = 0; i < (int)sizeof(ghash_buf); i += 16) {
+      ICC_GHASH(ICC_ctx,gcm_ctx,ghash_ka_H,tmp2,ghash_buf+i,16);
+    }
+    if(0 != memcmp(tmp1,tmp2,sizeof(tmp1))) {
+      printf("\t\tGHASH failed (block at a time)\n");
+      rv = ICC_OPENSSL_ERROR;
+    }
     check_stack(1);
     if(ICC_OSSL_SUCCESS == rv ) {
       printf("AES_GCM Unit test successfully completed!\n");
@@ -1627,6 +1970,10 @@ int doAES_CCMUnitTest(ICC_CTX *ICC_ctx)
   unsigned char *out = NULL;
   unsigned long outlen = 0;
   int err = 0;
+  ICC_AES_CCM_CTX *ccm_ctx = NULL;
+  ICC_AES_CCM_REC recs[3];
+  unsigned char bbuf[3][sizeof(ct)];
+  int i;
 
   printf("Starting AES_CCM unit test...\n");
   check_stack(0);
@@ -1649,6 +1996,72 @@ int doAES_CCMUnitTest(ICC_CTX *ICC_ctx)
     } else if(memcmp(out,pt,sizeof(pt)) != 0) {
       rv = ICC_FAILURE;
     }
+
+    /* The same vector with the key held in a context, twice to
+       cover the reuse of the expanded key */
+    printf("\tTesting AES_CCM_CTX Seal/Open\n");
+    ccm_ctx = ICC_AES_CCM_CTX_new(ICC_ctx);
+    if((NULL == ccm_ctx) || (1 != ICC_AES_CCM_Init(ICC_ctx,ccm_ctx,Key,16))) {
+      printf("\t\tAES_CCM_CTX setup failed\n");
+      rv = ICC_FAILURE;
+    } else {
+      for(i = 0; i < 2; i++) {
+        memset(out,0,sizeof(pt)+64);
+        if((1 != ICC_AES_CCM_Seal(ICC_ctx,ccm_ctx,nonce,sizeof(nonce),aad,sizeof(aad),
+                                  pt,sizeof(pt),out,&outlen,6)) ||
+           (sizeof(ct) != outlen) || (0 != memcmp(out,ct,sizeof(ct)))) {
+          printf("\t\tAES_CCM_Seal failed\n");
+          rv = ICC_FAILURE;
+        }
+      }
+      for(i = 0; i < 2; i++) {
+        memset(out,0,sizeof(pt)+64);
+        if((1 != ICC_AES_CCM_Open(ICC_ctx,ccm_ctx,nonce,sizeof(nonce),aad,sizeof(aad),
+                                  ct,sizeof(ct),out,&outlen,6)) ||
+           (sizeof(pt) != outlen) || (0 != memcmp(out,pt,sizeof(pt)))) {
+          printf("\t\tAES_CCM_Open failed\n");
+          rv = ICC_FAILURE;
+        }
+      }
+      /* Batch, in place, the vector three times, the
+         second with a corrupted tag on the way back */
+      printf("\tTesting AES_CCM SealBatch/OpenBatch\n");
+      memset(recs,0,sizeof(recs));
+      for(i = 0; i < 3; i++) {
+        memcpy(bbuf[i],pt,sizeof(pt));
+        recs[i].nonce = nonce;
+        recs[i].nlen = sizeof(nonce);
+        recs[i].aad = aad;
+        recs[i].aadlen = sizeof(aad);
+        recs[i].in = recs[i].out = bbuf[i];
+        recs[i].inlen = sizeof(pt);
+        recs[i].taglen = 6;
+      }
+      if(1 != ICC_AES_CCM_SealBatch(ICC_ctx,ccm_ctx,recs,3)) {
+        printf("\t\tAES_CCM_SealBatch failed\n");
+        rv = ICC_FAILURE;
+      }
+      for(i = 0; i < 3; i++) {
+        if((1 != recs[i].rv) || (sizeof(ct) != recs[i].outlen) ||
+           (0 != memcmp(bbuf[i],ct,sizeof(ct)))) {
+          printf("\t\tAES_CCM_SealBatch message %d failed\n",i);
+          rv = ICC_FAILURE;
+        }
+        recs[i].inlen = recs[i].outlen;
+      }
+      bbuf[1][sizeof(ct)-1] ^= 1;
+      if((1 == ICC_AES_CCM_OpenBatch(ICC_ctx,ccm_ctx,recs,3)) ||
+         (1 != recs[0].rv) || (1 == recs[1].rv) || (1 != recs[2].rv) ||
+         (0 != memcmp(bbuf[0],pt,sizeof(pt))) ||
+         (0 != memcmp(bbuf[2],pt,sizeof(pt))) ||
+         (0 != bbuf[1][0])) {
+        printf("\t\tAES_CCM_OpenBatch failed\n");
+        rv = ICC_FAILURE;
+      }
+    }
+    if(NULL != ccm_ctx) {
+      ICC_AES_CCM_CTX_free(ICC_ctx,ccm_ctx);
+    }
     
     check_stack(1);
     if(ICC_OSSL_SUCCESS == rv ) {
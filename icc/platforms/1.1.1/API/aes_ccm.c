@@ -1,15 +1,18 @@
 /*************************************************************************
 // Copyright IBM Corp. 2023
 //
-// Licensed under the Apache License 2.0 (the "License").  You may not use
-// this file except in compliance with the License.  You can obtain a copy
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
 // in the file LICENSE in the source distribution.
 *************************************************************************/
 
 
 /* Note !
    AES-CCM is defined as a one-shot encrypt/mac operation
-   hence there's no AES_CCM_CTX, no Init/Update/Final
+   hence there's no Init/Update/Final.
+   The AES_CCM_CTX only holds the key so that many messages
+   under one key don't pay for the cipher lookup, context
+   allocation and key expansion each time.
    It'll also eat a LOT of RAM for long messages.
 */
 #ifndef AES_DEBUG
@@ -18,94 +21,127 @@
 # endif
 #endif
 #include <string.h>
+#include <limits.h>
 
 #include "openssl/evp.h"
 #include "icclib.h"
 
-int AES_CCM_common(ICClib *pcb,unsigned char *iv,unsigned int ivlen,
-			unsigned char *key,unsigned int keylen,
-			unsigned char *aad, unsigned long aadlen,
-			unsigned char *data,unsigned long datalen,
-			unsigned char *out, unsigned long *outlen,
-		        unsigned int taglen,int enc
-			)
+static const EVP_CIPHER *ccm_128 = NULL;
+static const EVP_CIPHER *ccm_192 = NULL;
+static const EVP_CIPHER *ccm_256 = NULL;
+static const EVP_CIPHER *ecb_128 = NULL;
+static const EVP_CIPHER *ecb_192 = NULL;
+static const EVP_CIPHER *ecb_256 = NULL;
+
+/** @brief
+    The CCM cipher for a key length, looked up once
+    @param keylen the key length in bytes
+    @return the cipher, NULL if the key length isn't 16, 24 or 32
+*/
+static const EVP_CIPHER *AES_CCM_cipher(unsigned int keylen)
 {
-  int rv = 1;
-  EVP_CIPHER_CTX *ctx = NULL;
   const EVP_CIPHER *cip = NULL;
-  int chunklen = 0;
-  unsigned char tag[16];
-  int tmplen = 0;
-  
-  memset(tag,0,sizeof(tag));
 
-  ctx = EVP_CIPHER_CTX_new();
   switch(keylen) {
   case 16:
-    cip = EVP_get_cipherbyname("aes-128-ccm");
+    if(NULL == ccm_128) {
+      ccm_128 = EVP_get_cipherbyname("aes-128-ccm");
+    }
+    cip = ccm_128;
     break;
   case 24:
-    cip = EVP_get_cipherbyname("aes-192-ccm");
+    if(NULL == ccm_192) {
+      ccm_192 = EVP_get_cipherbyname("aes-192-ccm");
+    }
+    cip = ccm_192;
     break;
   case 32:
-    cip = EVP_get_cipherbyname("aes-256-ccm");
+    if(NULL == ccm_256) {
+      ccm_256 = EVP_get_cipherbyname("aes-256-ccm");
+    }
+    cip = ccm_256;
     break;
   default:
-    rv = -1;
     break;
   }
+  return cip;
+}
+
+/** @brief
+    Encrypt or decrypt one message on a context with the cipher and
+    key set, common code for the one shot and context calls
+    @param a an AES_CCM_CTX_t with ctx, cipher and key set
+    @param enc 1 to encrypt, 0 to decrypt
+    @return 1 if O.K., 0 otherwise
+    @note The key is only expanded the first time, after that only
+    the nonce changes between messages. Some OpenSSL versions don't
+    take a new nonce length, tag length or direction on a keyed
+    context, so a change of any of those starts from scratch.
+    On decrypt datalen includes the tag, as AES_CCM_Decrypt()
+*/
+static int AES_CCM_Crypt(AES_CCM_CTX_t *a, int enc,
+                         unsigned char *iv, unsigned int ivlen,
+                         unsigned char *aad, unsigned long aadlen,
+                         unsigned char *data, unsigned long datalen,
+                         unsigned char *out, unsigned long *outlen,
+                         unsigned int taglen)
+{
+  int rv = 1;
+  int chunklen = 0;
+  unsigned char tag[16];
+  int tmplen = 0;
+
+  memset(tag,0,sizeof(tag));
+  *outlen = 0;
+  if(taglen > sizeof(tag)) {
+    return 0;
+  }
   if(!enc) {
     if(datalen >= taglen) {
       memcpy(tag,data + datalen - taglen,taglen);
       datalen -= taglen;
     }
   }
-  *outlen = 0;
-
-  if(1 == rv) {
-    EVP_CIPHER_CTX_set_flags(ctx, EVP_CIPHER_CTX_FLAG_WRAP_ALLOW);
+  if((ivlen != a->nlen) || (taglen != a->taglen) || (enc != a->enc)) {
+    a->keyed = 0;
+    a->nlen = ivlen;
+    a->taglen = taglen;
+    a->enc = enc;
   }
-
-  if(1 == rv) {
-    rv =  EVP_CipherInit_ex(ctx,cip,NULL,NULL,NULL,enc);
+  if(!a->keyed) {
+    rv = EVP_CipherInit_ex(a->ctx,a->cipher,NULL,NULL,NULL,enc);
   }
 
   if(1 == rv) {
-    rv = EVP_CIPHER_CTX_ctrl(ctx,EVP_CTRL_AEAD_SET_IVLEN,ivlen,0);
-  }
-
-  if(1 == rv) {;
-    rv = EVP_CIPHER_CTX_ctrl(ctx,EVP_CTRL_AEAD_SET_TAG,taglen,(1 == enc) ? NULL: tag);
+    rv = EVP_CIPHER_CTX_ctrl(a->ctx,EVP_CTRL_AEAD_SET_IVLEN,ivlen,0);
   }
 
   if(1 == rv) {
-    rv = EVP_CIPHER_CTX_set_key_length(ctx,keylen);
+    rv = EVP_CIPHER_CTX_ctrl(a->ctx,EVP_CTRL_AEAD_SET_TAG,taglen,(1 == enc) ? NULL: tag);
   }
 
   if(1 == rv) {
-    rv = EVP_CipherInit_ex(ctx, NULL, NULL, key, iv, -1);
+    rv = EVP_CipherInit_ex(a->ctx, NULL, NULL, a->keyed ? NULL : a->key, iv, -1);
+    a->keyed = (1 == rv) ? 1 : 0;
   }
 
   if( 1 == rv) {
     tmplen = 0;
-    rv = EVP_CipherUpdate(ctx, NULL, &tmplen, NULL,datalen);  
-  }    
+    rv = EVP_CipherUpdate(a->ctx, NULL, &tmplen, NULL,datalen);
+  }
 
   if( (1 == rv) && (NULL != aad) && (aadlen > 0) ) {
-    rv = EVP_CipherUpdate(ctx,NULL,&chunklen,aad,aadlen);
-   
+    rv = EVP_CipherUpdate(a->ctx,NULL,&chunklen,aad,aadlen);
   }
 
-  rv = EVP_CIPHER_CTX_set_padding(ctx, 0); 
-
   if( 1 == rv ) {
     chunklen = 0;
-    rv = EVP_CipherUpdate(ctx,out+(*outlen),&chunklen,data,datalen);
+    rv = EVP_CipherUpdate(a->ctx,out+(*outlen),&chunklen,data,datalen);
     *outlen += chunklen;
   }
 
   if(enc && (1 == rv)) {
-    rv = EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG,taglen, tag);
+    rv = EVP_CIPHER_CTX_ctrl(a->ctx, EVP_CTRL_AEAD_GET_TAG,taglen, tag);
   }
 
   if(1 == rv) {
@@ -114,12 +150,48 @@ int AES_CCM_common(ICClib *pcb,unsigned char *iv,unsigned int ivlen,
       *outlen += taglen;
     }
   }
+  return rv;
+}
+
+int AES_CCM_common(ICClib *pcb,unsigned char *iv,unsigned int ivlen,
+			unsigned char *key,unsigned int keylen,
+			unsigned char *aad, unsigned long aadlen,
+			unsigned char *data,unsigned long datalen,
+			unsigned char *out, unsigned long *outlen,
+		        unsigned int taglen,int enc
+			)
+{
+  int rv = 1;
+  AES_CCM_CTX_t a;
+
+  memset(&a,0,sizeof(a));
+  *outlen = 0;
+  a.cipher = AES_CCM_cipher(keylen);
+  if(NULL == a.cipher) {
+    rv = -1;
+  }
+  if(1 == rv) {
+    a.ctx = EVP_CIPHER_CTX_new();
+    if(NULL == a.ctx) {
+      rv = 0;
+    }
+  }
+  if(1 == rv) {
+    EVP_CIPHER_CTX_set_flags(a.ctx, EVP_CIPHER_CTX_FLAG_WRAP_ALLOW);
+    memcpy(a.key,key,keylen);
+    a.klen = keylen;
+    rv = AES_CCM_Crypt(&a,enc,iv,ivlen,aad,aadlen,data,datalen,
+                       out,outlen,taglen);
+  }
   if(1 == rv && pcb && pcb->callback) {
     int nid;
-    nid = EVP_CIPHER_type(cip);
+    nid = EVP_CIPHER_type(a.cipher);
     pcb->callback("ICC_CCM_common",nid,1);
   }
-  EVP_CIPHER_CTX_free(ctx); 
+  if(NULL != a.ctx) {
+    EVP_CIPHER_CTX_free(a.ctx);
+  }
+  OPENSSL_cleanse(a.key,sizeof(a.key));
 
   return rv;
 }
@@ -160,4 +232,532 @@ int AES_CCM_Decrypt(ICClib *pcb,unsigned char *iv,unsigned int ivlen,
   return rv;
 }
 
+/** @brief
+    Allocate an AES CCM context
+    @return NULL on failure, or a pointer to an AES_CCM_CTX with no key
+*/
+AES_CCM_CTX *AES_CCM_CTX_new(void)
+{
+  AES_CCM_CTX_t *a = NULL;
+
+  a = (AES_CCM_CTX_t *)OPENSSL_malloc(sizeof(AES_CCM_CTX_t));
+  if(NULL != a) {
+    memset(a,0,sizeof(AES_CCM_CTX_t));
+    a->ctx = EVP_CIPHER_CTX_new();
+    if(NULL == a->ctx) {
+      OPENSSL_free(a);
+      a = NULL;
+    } else {
+      EVP_CIPHER_CTX_set_flags(a->ctx, EVP_CIPHER_CTX_FLAG_WRAP_ALLOW);
+    }
+  }
+  return (AES_CCM_CTX *)a;
+}
+
+/** @brief
+    Free an AES CCM context, the key is erased
+    @param ain the AES_CCM_CTX to free
+*/
+void AES_CCM_CTX_free(AES_CCM_CTX *ain)
+{
+  AES_CCM_CTX_t *a = (AES_CCM_CTX_t *)ain;
+
+  if(NULL == a) {
+    return;
+  }
+  if(NULL != a->ctx) {
+    EVP_CIPHER_CTX_free(a->ctx);
+  }
+  if(NULL != a->ecb) {
+    EVP_CIPHER_CTX_free(a->ecb);
+  }
+  OPENSSL_cleanse(a,sizeof(AES_CCM_CTX_t));
+  OPENSSL_free(a);
+}
+
+/** @brief
+    Set the key for an AES CCM context
+    @param ain an AES_CCM_CTX
+    @param key an aes key 16,24 or 32 bytes long
+    @param keylen the length of the aes key
+    @return 1 if O.K., -1 if the key length isn't supported
+    @note The key is expanded on the first message and kept
+    for the ones after, call again to change it.
+*/
+int AES_CCM_Init(AES_CCM_CTX *ain,unsigned char *key,unsigned int keylen)
+{
+  AES_CCM_CTX_t *a = (AES_CCM_CTX_t *)ain;
+  const EVP_CIPHER *cip = NULL;
+
+  if((NULL == a) || (NULL == key)) {
+    return 0;
+  }
+  cip = AES_CCM_cipher(keylen);
+  if(NULL == cip) {
+    return -1;
+  }
+  a->cipher = cip;
+  memcpy(a->key,key,keylen);
+  a->klen = keylen;
+  a->keyed = 0;
+  a->ecbkeyed = 0;
+  return 1;
+}
+
+/** @brief
+    One message on an AES_CCM_CTX, common code for AES_CCM_Seal()
+    and AES_CCM_Open()
+    @param enc 1 to encrypt, 0 to decrypt
+    @return 1 if O.K., 0 otherwise
+*/
+static int AES_CCM_OneShot(ICClib *pcb,AES_CCM_CTX *ain,int enc,
+                           unsigned char *nonce,unsigned int nlen,
+                           unsigned char *aad,unsigned long aadlen,
+                           unsigned char *data,unsigned long datalen,
+                           unsigned char *out,unsigned long *outlen,
+                           unsigned int taglen)
+{
+  AES_CCM_CTX_t *a = (AES_CCM_CTX_t *)ain;
+  int rv = 0;
+
+  if(NULL != outlen) {
+    *outlen = 0;
+  }
+  if((NULL == a) || (NULL == a->ctx) || (NULL == a->cipher) ||
+     (NULL == nonce) || (NULL == outlen) || (NULL == out) ||
+     ((NULL == aad) && (0 != aadlen)) ||
+     ((NULL == data) && (0 != datalen)) ||
+     (!enc && (datalen < taglen)) ||
+     (aadlen > INT_MAX) || (datalen > INT_MAX)) {
+    return 0;
+  }
+  rv = AES_CCM_Crypt(a,enc,nonce,nlen,aad,aadlen,data,datalen,
+                     out,outlen,taglen);
+  if(1 == rv && pcb && pcb->callback) {
+    pcb->callback("ICC_CCM_common",EVP_CIPHER_type(a->cipher),1);
+  }
+  return rv;
+}
+
+/** @brief
+    Encrypt and authenticate one message under the key held in an
+    AES_CCM_CTX
+    @param pcb The internal ICC_CTX
+    @param ain an AES_CCM_CTX with the key set by AES_CCM_Init()
+    @param nonce the nonce, 7-13 bytes
+    @param nlen the length of the nonce
+    @param aad Additional Authentication data, hashed, but not encrypted
+    @param aadlen the length of the aad
+    @param data the data to encrypt
+    @param datalen the length of the data
+    @param out the output buffer, datalen + taglen bytes
+    @param outlen a place to store the returned output length
+    @param taglen the desired length of the auth tag
+    @return 1 if O.K., 0 otherwise
+    @note The output is the same as AES_CCM_Encrypt(), the tag
+    follows the ciphertext
+*/
+int AES_CCM_Seal(ICClib *pcb,AES_CCM_CTX *ain,
+                 unsigned char *nonce,unsigned int nlen,
+                 unsigned char *aad,unsigned long aadlen,
+                 unsigned char *data,unsigned long datalen,
+                 unsigned char *out,unsigned long *outlen,
+                 unsigned int taglen)
+{
+  return AES_CCM_OneShot(pcb,ain,1,nonce,nlen,aad,aadlen,data,datalen,
+                         out,outlen,taglen);
+}
+
+/** @brief
+    Decrypt and verify one message under the key held in an
+    AES_CCM_CTX
+    @param pcb The internal ICC_CTX
+    @param ain an AES_CCM_CTX with the key set by AES_CCM_Init()
+    @param nonce the nonce, 7-13 bytes
+    @param nlen the length of the nonce
+    @param aad Additional Authentication data
+    @param aadlen the length of the aad
+    @param data the ciphertext followed by the tag
+    @param datalen the length of data, including the tag
+    @param out the output buffer, datalen - taglen bytes
+    @param outlen a place to store the returned output length
+    @param taglen the length of the auth tag
+    @return 1 if the tag matched, 0 otherwise
+    @note As AES_CCM_Decrypt(), no data is returned unless the tag
+    matches
+*/
+int AES_CCM_Open(ICClib *pcb,AES_CCM_CTX *ain,
+                 unsigned char *nonce,unsigned int nlen,
+                 unsigned char *aad,unsigned long aadlen,
+                 unsigned char *data,unsigned long datalen,
+                 unsigned char *out,unsigned long *outlen,
+                 unsigned int taglen)
+{
+  return AES_CCM_OneShot(pcb,ain,0,nonce,nlen,aad,aadlen,data,datalen,
+                         out,outlen,taglen);
+}
+
+/*! @brief messages MAC'd side by side in the batch calls */
+#define CCM_LANES 8
+/*! @brief messages with more aad + data than this go through the
+    cipher context, with a short message most of the cost is the
+    per message setup the lanes avoid */
+#define CCM_BATCH_MAX 128
+/*! @brief B0 and the encoded aad, which is < 2^16-2^8 so has a 2 byte
+    length prefix, rounded up to a whole block */
+#define CCM_HDR_MAX (16 + ((2 + CCM_BATCH_MAX + 15) & ~15))
+/*! @brief counter blocks for one lane, A0 for the tag then the data */
+#define CCM_LANE_CTRS (1 + (CCM_BATCH_MAX + 15) / 16)
+
+/*! @brief the state of one message in the lane kernel */
+typedef struct {
+  AES_CCM_REC *r;
+  unsigned char hdr[CCM_HDR_MAX]; /*!< B0 || encoded aad, 0 padded */
+  unsigned long nhdr;             /*!< blocks in hdr */
+  unsigned long nblk;             /*!< blocks MAC'd, hdr then payload */
+  unsigned long ptlen;            /*!< length of the payload */
+  unsigned char *pt;              /*!< the plaintext payload */
+  unsigned char *ct;              /*!< the ciphertext payload */
+  unsigned char Y[16];            /*!< CBC-MAC chaining value */
+} CCM_LANE;
+
+/** @brief
+    Key the AES-ECB context the batch calls use, once per key
+    @param a an AES_CCM_CTX_t with the key set
+    @return 1 if O.K., 0 otherwise
+*/
+static int AES_CCM_BatchKey(AES_CCM_CTX_t *a)
+{
+  const EVP_CIPHER *c = NULL;
+  int rv = 0;
+
+  if(a->ecbkeyed) {
+    return 1;
+  }
+  switch(a->klen) {
+  case 16:
+    if(NULL == ecb_128) {
+      ecb_128 = EVP_get_cipherbyname("aes-128-ecb");
+    }
+    c = ecb_128;
+    break;
+  case 24:
+    if(NULL == ecb_192) {
+      ecb_192 = EVP_get_cipherbyname("aes-192-ecb");
+    }
+    c = ecb_192;
+    break;
+  case 32:
+    if(NULL == ecb_256) {
+      ecb_256 = EVP_get_cipherbyname("aes-256-ecb");
+    }
+    c = ecb_256;
+    break;
+  default:
+    break;
+  }
+  if(NULL == c) {
+    return 0;
+  }
+  if(NULL == a->ecb) {
+    a->ecb = EVP_CIPHER_CTX_new();
+  }
+  if((NULL != a->ecb) &&
+     (1 == EVP_EncryptInit_ex(a->ecb,c,NULL,a->key,NULL))) {
+    EVP_CIPHER_CTX_set_padding(a->ecb,0);
+    rv = 1;
+  }
+  a->ecbkeyed = rv;
+  return rv;
+}
+
+/*! @brief the record is one the lane kernel can do, SP800-38C A.1 */
+static int ccm_laneable(const AES_CCM_REC *r, int enc)
+{
+  unsigned long ptlen = 0;
+
+  if((r->nlen < 7) || (r->nlen > 13) ||
+     (r->taglen < 4) || (r->taglen > 16) || (r->taglen & 1)) {
+    return 0;
+  }
+  ptlen = enc ? r->inlen : r->inlen - r->taglen;
+  return ((r->aadlen + ptlen) <= CCM_BATCH_MAX) ? 1 : 0;
+}
+
+/*! @brief the formatted B0 and aad for a lane, SP800-38C A.2 */
+static void ccm_format(CCM_LANE *l)
+{
+  AES_CCM_REC *r = l->r;
+  unsigned int q = 15 - r->nlen;
+  unsigned long n = l->ptlen;
+  unsigned long hl = 16;
+  unsigned int i;
+
+  l->hdr[0] = (unsigned char)(((0 != r->aadlen) ? 0x40 : 0) |
+                              (((r->taglen - 2) / 2) << 3) | (q - 1));
+  memcpy(l->hdr + 1,r->nonce,r->nlen);
+  for(i = 0; i < q; i++) {
+    l->hdr[15 - i] = (unsigned char)n;
+    n >>= 8;
+  }
+  if(0 != r->aadlen) {
+    l->hdr[16] = (unsigned char)(r->aadlen >> 8);
+    l->hdr[17] = (unsigned char)r->aadlen;
+    memcpy(l->hdr + 18,r->aad,r->aadlen);
+    hl = 18 + r->aadlen;
+    if(0 != (hl & 15)) {
+      memset(l->hdr + hl,0,16 - (hl & 15));
+      hl = (hl + 15) & ~15UL;
+    }
+  }
+  l->nhdr = hl / 16;
+  l->nblk = l->nhdr + (l->ptlen + 15) / 16;
+}
+
+/*! @brief counter block A_i, SP800-38C A.3 */
+static void ccm_ctr(unsigned char *A, const AES_CCM_REC *r, unsigned long i)
+{
+  unsigned int q = 15 - r->nlen;
+  unsigned int j;
+
+  A[0] = (unsigned char)(q - 1);
+  memcpy(A + 1,r->nonce,r->nlen);
+  for(j = 0; j < q; j++) {
+    A[15 - j] = (unsigned char)i;
+    i >>= 8;
+  }
+}
+
+/*! @brief X = Y ^ (block i of the MAC input for a lane) */
+static void ccm_macblk(unsigned char *X, const CCM_LANE *l, unsigned long i)
+{
+  const unsigned char *b = NULL;
+  unsigned long off, len;
+  unsigned int j;
+
+  if(i < l->nhdr) {
+    b = l->hdr + i * 16;
+    len = 16;
+  } else {
+    off = (i - l->nhdr) * 16;
+    b = l->pt + off;
+    len = l->ptlen - off;
+    if(len > 16) {
+      len = 16;
+    }
+  }
+  for(j = 0; j < len; j++) {
+    X[j] = l->Y[j] ^ b[j];
+  }
+  for(; j < 16; j++) {
+    X[j] = l->Y[j];
+  }
+}
+
+/*! @brief out = in ^ ks */
+static void ccm_xor(unsigned char *out, const unsigned char *in,
+                    const unsigned char *ks, unsigned long len)
+{
+  unsigned long i;
+
+  for(i = 0; i < len; i++) {
+    out[i] = in[i] ^ ks[i];
+  }
+}
+
+/** @brief
+    Up to CCM_LANES short messages through the lane kernel
+    @param a an AES_CCM_CTX_t with the ECB context keyed
+    @param enc 1 to encrypt, 0 to decrypt
+    @param lanes the messages, r and ptlen set
+    @param nl the number of lanes in use
+    @return 1 if the AES calls worked, 0 otherwise. A tag mismatch
+    is reported in the record, not here
+    @note The counter blocks of every lane are encrypted in one AES
+    pass. The CBC-MAC of one message is serial, but the messages are
+    independent, so each AES call takes the next block of every lane.
+*/
+static int AES_CCM_Lanes(AES_CCM_CTX_t *a, int enc, CCM_LANE *lanes, int nl)
+{
+  unsigned char ks[CCM_LANES * CCM_LANE_CTRS][16];
+  unsigned char X[CCM_LANES][16];
+  unsigned char T[16];
+  int base[CCM_LANES];
+  unsigned long i, maxblk = 0;
+  int n = 0, outl = 0;
+  int j, k;
+  CCM_LANE *l = NULL;
+  AES_CCM_REC *r = NULL;
+  int rv = 1;
+
+  /* S_0 for the tag then the keystream, all lanes in one pass */
+  for(j = 0; j < nl; j++) {
+    l = &lanes[j];
+    base[j] = n;
+    for(i = 0; i <= (l->ptlen + 15) / 16; i++) {
+      ccm_ctr(ks[n++],l->r,i);
+    }
+  }
+  rv = EVP_EncryptUpdate(a->ecb,ks[0],&outl,ks[0],n * 16);
+  /* Decrypt before the MAC, the MAC is over the plaintext */
+  for(j = 0; (1 == rv) && (j < nl); j++) {
+    l = &lanes[j];
+    r = l->r;
+    if(enc) {
+      l->pt = r->in;
+    } else {
+      ccm_xor(r->out,r->in,ks[base[j] + 1],l->ptlen);
+      l->pt = r->out;
+    }
+    ccm_format(l);
+    if(l->nblk > maxblk) {
+      maxblk = l->nblk;
+    }
+    memset(l->Y,0,sizeof(l->Y));
+  }
+  /* CBC-MAC, a block from each lane per AES call */
+  for(i = 0; (1 == rv) && (i < maxblk); i++) {
+    for(j = 0, k = 0; j < nl; j++) {
+      if(i < lanes[j].nblk) {
+        ccm_macblk(X[k++],&lanes[j],i);
+      }
+    }
+    rv = EVP_EncryptUpdate(a->ecb,X[0],&outl,X[0],k * 16);
+    for(j = 0, k = 0; (1 == rv) && (j < nl); j++) {
+      if(i < lanes[j].nblk) {
+        memcpy(lanes[j].Y,X[k++],16);
+      }
+    }
+  }
+  for(j = 0; (1 == rv) && (j < nl); j++) {
+    l = &lanes[j];
+    r = l->r;
+    ccm_xor(T,l->Y,ks[base[j]],r->taglen);
+    if(enc) {
+      /* After the MAC, out may be in */
+      ccm_xor(r->out,r->in,ks[base[j] + 1],l->ptlen);
+      memcpy(r->out + l->ptlen,T,r->taglen);
+      r->outlen = l->ptlen + r->taglen;
+      r->rv = 1;
+    } else if(0 == CRYPTO_memcmp(T,r->in + l->ptlen,r->taglen)) {
+      r->outlen = l->ptlen;
+      r->rv = 1;
+    } else {
+      r->rv = 0;
+    }
+  }
+  if(1 != rv) {
+    for(j = 0; j < nl; j++) {
+      lanes[j].r->rv = 0;
+    }
+  }
+  for(j = 0; j < nl; j++) {
+    r = lanes[j].r;
+    if((1 != r->rv) && !enc && (0 != lanes[j].ptlen)) {
+      /* Don't release unauthenticated plaintext */
+      OPENSSL_cleanse(r->out,lanes[j].ptlen);
+    }
+    OPENSSL_cleanse(lanes[j].hdr,sizeof(lanes[j].hdr));
+    OPENSSL_cleanse(lanes[j].Y,sizeof(lanes[j].Y));
+  }
+  OPENSSL_cleanse(ks,n * 16);
+  OPENSSL_cleanse(X,sizeof(X));
+  OPENSSL_cleanse(T,sizeof(T));
+  return rv;
+}
+
+/** @brief
+    AES CCM over many messages under one key, common code for
+    AES_CCM_SealBatch() and AES_CCM_OpenBatch()
+    @param enc 1 to encrypt, 0 to decrypt
+    @return 1 if every message succeeded, 0 otherwise
+*/
+static int AES_CCM_Batch(ICClib *pcb, AES_CCM_CTX *ain, int enc,
+                         AES_CCM_REC *recs, unsigned int nrecs)
+{
+  AES_CCM_CTX_t *a = (AES_CCM_CTX_t *)ain;
+  CCM_LANE lanes[CCM_LANES];
+  AES_CCM_REC *r = NULL;
+  unsigned int i;
+  int nl = 0;
+  int rv = 1;
 
+  if((NULL == a) || (NULL == a->cipher) || ((NULL == recs) && (0 != nrecs))) {
+    return 0;
+  }
+  if(1 != AES_CCM_BatchKey(a)) {
+    for(i = 0; i < nrecs; i++) {
+      recs[i].rv = 0;
+      recs[i].outlen = 0;
+    }
+    return 0;
+  }
+  for(i = 0; i < nrecs; i++) {
+    r = &recs[i];
+    r->outlen = 0;
+    if((NULL == r->nonce) || (NULL == r->out) ||
+       ((NULL == r->aad) && (0 != r->aadlen)) ||
+       ((NULL == r->in) && (0 != r->inlen)) ||
+       (!enc && (r->inlen < r->taglen)) ||
+       (r->aadlen > INT_MAX) || (r->inlen > INT_MAX)) {
+      r->rv = 0;
+    } else if(ccm_laneable(r,enc)) {
+      lanes[nl].r = r;
+      lanes[nl].ptlen = enc ? r->inlen : r->inlen - r->taglen;
+      if(++nl == CCM_LANES) {
+        AES_CCM_Lanes(a,enc,lanes,nl);
+        nl = 0;
+      }
+      continue;
+    } else {
+      r->rv = AES_CCM_Crypt(a,enc,r->nonce,r->nlen,r->aad,r->aadlen,
+                            r->in,r->inlen,r->out,&r->outlen,r->taglen);
+    }
+  }
+  if(0 != nl) {
+    AES_CCM_Lanes(a,enc,lanes,nl);
+  }
+  /* FIPS usage is reported per record, as the single shot calls would */
+  for(i = 0; i < nrecs; i++) {
+    if(1 != recs[i].rv) {
+      recs[i].outlen = 0;
+      rv = 0;
+    } else if(pcb && pcb->callback) {
+      pcb->callback("ICC_CCM_common",EVP_CIPHER_type(a->cipher),1);
+    }
+  }
+  return rv;
+}
+
+/** @brief
+    Encrypt and authenticate many messages under one key in one call
+    @param pcb The internal ICC_CTX
+    @param ain an AES_CCM_CTX with the key set by AES_CCM_Init()
+    @param recs the messages, each with its own nonce, aad and data
+    @param nrecs the number of messages
+    @return 1 if every message was sealed, 0 otherwise. Each record's
+    rv and outlen are set as AES_CCM_Seal() would for it
+    @note Short messages are run through an AES-ECB lane kernel,
+    CCM_LANES at a time, longer ones through the CCM cipher context.
+*/
+int AES_CCM_SealBatch(ICClib *pcb,AES_CCM_CTX *ain,
+                      AES_CCM_REC *recs,unsigned int nrecs)
+{
+  return AES_CCM_Batch(pcb,ain,1,recs,nrecs);
+}
+
+/** @brief
+    Decrypt and verify many messages under one key in one call
+    @param pcb The internal ICC_CTX
+    @param ain an AES_CCM_CTX with the key set by AES_CCM_Init()
+    @param recs the messages, each input is ciphertext then tag
+    @param nrecs the number of messages
+    @return 1 if every message verified, 0 otherwise. Each record's
+    rv and outlen are set as AES_CCM_Open() would for it
+    @note A message whose tag doesn't match has its output cleared
+*/
+int AES_CCM_OpenBatch(ICClib *pcb,AES_CCM_CTX *ain,
+                      AES_CCM_REC *recs,unsigned int nrecs)
+{
+  return AES_CCM_Batch(pcb,ain,0,recs,nrecs);
+}
@@ -15,6 +15,25 @@
 extern "C" {
 #endif
 
+/*! @brief The structure of the AES_CCM context */
+typedef struct AES_CCM_struct {
+  EVP_CIPHER_CTX *ctx;        /*!< OpenSSL's CCM cipher context, holds the expanded key */
+  const EVP_CIPHER *cipher;   /*!< The CCM cipher for the key length */
+  unsigned char key[32];      /*!< The key */
+  unsigned int klen;          /*!< Key length */
+  unsigned int keyed;         /*!< ctx holds the expanded key, a new nonce alone needn't redo it */
+  unsigned int nlen;          /*!< Nonce length ctx was last set up for */
+  unsigned int taglen;        /*!< Tag length ctx was last set up for */
+  int enc;                    /*!< Direction ctx was last set up for */
+  EVP_CIPHER_CTX *ecb;        /*!< AES-ECB with the key, for the batch calls */
+  unsigned int ecbkeyed;      /*!< ecb matches the current key */
+} AES_CCM_CTX_t;
+
+typedef struct AES_CCM_CTX_t AES_CCM_CTX;
+
+/*! @brief One message for the batch calls, public as ICC_AES_CCM_REC */
+typedef ICC_AES_CCM_REC AES_CCM_REC;
+
 int AES_CCM_Encrypt(ICClib *pcb,unsigned char *iv,unsigned int ivlen,
                     unsigned char *key,unsigned int keylen,
                     unsigned char *aad, unsigned long aadlen,
@@ -32,6 +51,31 @@ int AES_CCM_Decrypt(ICClib *pcb,unsigned char *iv,unsigned int ivlen,
                     unsigned int taglen
                     );
 
+AES_CCM_CTX *AES_CCM_CTX_new(void);
+
+void AES_CCM_CTX_free(AES_CCM_CTX *ctx);
+
+int AES_CCM_Init(AES_CCM_CTX *ain,unsigned char *key,unsigned int keylen);
+
+int AES_CCM_Seal(ICClib *pcb,AES_CCM_CTX *ain,
+		 unsigned char *nonce,unsigned int nlen,
+		 unsigned char *aad,unsigned long aadlen,
+		 unsigned char *data,unsigned long datalen,
+		 unsigned char *out,unsigned long *outlen,
+		 unsigned int taglen);
+
+int AES_CCM_Open(ICClib *pcb,AES_CCM_CTX *ain,
+		 unsigned char *nonce,unsigned int nlen,
+		 unsigned char *aad,unsigned long aadlen,
+		 unsigned char *data,unsigned long datalen,
+		 unsigned char *out,unsigned long *outlen,
+		 unsigned int taglen);
+
+int AES_CCM_SealBatch(ICClib *pcb,AES_CCM_CTX *ain,
+		      AES_CCM_REC *recs,unsigned int nrecs);
+
+int AES_CCM_OpenBatch(ICClib *pcb,AES_CCM_CTX *ain,
+		      AES_CCM_REC *recs,unsigned int nrecs);
 
 #ifdef __cplusplus
 }
@@ -16,6 +16,7 @@
 
 
 #include <string.h>
+#include <limits.h>
 
 
 #include "openssl/evp.h" 
@@ -23,6 +24,7 @@
 #include "openssl/rand.h"
 
 #include "icclib.h"
+#include "ghash.h"
 /*
 #include "aes_gcm.h"
 */
@@ -34,6 +36,9 @@
 static const EVP_CIPHER *gcm_128 = NULL;
 static const EVP_CIPHER *gcm_192 = NULL;
 static const EVP_CIPHER *gcm_256 = NULL;
+static const EVP_CIPHER *ecb_128 = NULL;
+static const EVP_CIPHER *ecb_192 = NULL;
+static const EVP_CIPHER *ecb_256 = NULL;
 
 #if __BIG_ENDIAN__
 # define htonll(x) (x)
@@ -210,6 +215,9 @@ int AES_GCM_CTX_ctrl(AES_GCM_CTX *ain, int mode, int accel, void *ptr)
   case AES_GCM_CTRL_GET_ACCEL:
     *(int *)ptr = 1; /* Stuck at 4bit tables, implemented in assembler */
     break;
+  case AES_GCM_CTRL_GHASH_IMPL: /* Which GHASH() would run here */
+    *(int *)ptr = GHASH_Impl();
+    break;
   case AES_GCM_CTRL_TLS12: /* TLS 1.2 IV rollover */
      a->flags |= AES_GCM_CTRL_TLS12;
      break;
@@ -248,6 +256,18 @@ void AES_GCM_CTX_free(AES_GCM_CTX *ctx)
     EVP_CIPHER_CTX_cleanup(a->IVctx);
     EVP_CIPHER_CTX_free(a->IVctx);
   }
+  if(NULL != a->ghash) {
+    OPENSSL_cleanse(a->ghash,sizeof(GHASH_KEY));
+    OPENSSL_free(a->ghash);
+  }
+  if(NULL != a->ecb) {
+    EVP_CIPHER_CTX_cleanup(a->ecb);
+    EVP_CIPHER_CTX_free(a->ecb);
+  }
+  if(NULL != a->hkey) {
+    OPENSSL_cleanse(a->hkey,sizeof(GHASH_KEY));
+    OPENSSL_free(a->hkey);
+  }
   memset(a,0,sizeof(AES_GCM_CTX_t));
   OPENSSL_free(ctx);
 }
@@ -265,16 +285,91 @@ static void XOR(unsigned char *a,unsigned char *b,int l)
     @param Hash is the input/output, (AES_BLOCK_SIZE long)
     @param X the input data
     @param Xlen is the length of the input data 0 <= X <= 2^64 BITS
-    @return 1 if O.K. 0 on error (X is too long)
     @note The last block of X will be 0 padded - so no partial blocks
     unless you want this.
     @note Y should be initialized to 0 if this is the first pass
     otherwise, Y is the output from the previous invocation and
     the GHASH can be chained.   
+    @note The expanded key is kept in gcm_ctx, chained calls with the
+    same H don't expand it again. With no gcm_ctx it's expanded per call.
 */
 void GHASH(AES_GCM_CTX *gcm_ctx,unsigned char *H, unsigned char *Hash, unsigned char *X,unsigned long Xlen)
 {
+  AES_GCM_CTX_t *a = (AES_GCM_CTX_t *)gcm_ctx;
+  GHASH_KEY tmp;
+  GHASH_KEY *k = &tmp;
 
+  if((NULL == H) || (NULL == Hash) || ((NULL == X) && (0 != Xlen))) {
+    return;
+  }
+  tmp.set = 0;
+  if(NULL != a) {
+    if(NULL == a->ghash) {
+      a->ghash = OPENSSL_malloc(sizeof(GHASH_KEY));
+      if(NULL != a->ghash) {
+        memset(a->ghash,0,sizeof(GHASH_KEY));
+      }
+    }
+    if(NULL != a->ghash) {
+      k = a->ghash;
+    }
+  }
+  if((0 == k->set) || (0 != CRYPTO_memcmp(k->H,H,GHASH_BLOCK))) {
+    GHASH_SetKey(k,H);
+  }
+  if(Xlen > 0) {
+    GHASH_Update(k,Hash,X,(size_t)Xlen);
+  }
+  if(&tmp == k) {
+    OPENSSL_cleanse(&tmp,sizeof(tmp));
+  }
+}
+
+/** @brief
+    (Re)start the cipher context for a message
+    @param a an AES_GCM_CTX_t with the key and cipher set
+    @param enc 1 to encrypt, 0 to decrypt
+    @param iv the IV for the message
+    @param ivlen the length of the IV
+    @return 1 if O.K., 0 otherwise
+    @note The key (AES schedule and GHASH table) is only expanded when
+    it's new to the cipher context. An IV or direction change reuses it.
+*/
+static int AES_GCM_StartIV(AES_GCM_CTX_t *a, int enc, unsigned char *iv,
+                           unsigned long ivlen)
+{
+  const EVP_CIPHER *c = NULL;
+  int rv = 1;
+
+  if ((NULL == a->ctx) || (NULL == a->cipher)) {
+    return 0;
+  }
+  /* By nid, the context may hold a different (fetched) instance */
+  c = EVP_CIPHER_CTX_cipher(a->ctx);
+  if ((NULL == c) || (EVP_CIPHER_nid(c) != EVP_CIPHER_nid(a->cipher))) {
+    rv = EVP_CipherInit_ex(a->ctx, a->cipher, NULL, NULL, NULL, enc);
+    a->keyed = 0;
+  }
+  if (1 == rv) {
+    EVP_CIPHER_CTX_ctrl(a->ctx, EVP_CTRL_GCM_SET_IVLEN, (int)ivlen, NULL);
+    rv = EVP_CipherInit_ex(a->ctx, NULL, NULL, a->keyed ? NULL : a->key,
+                           iv, enc);
+    a->keyed = (1 == rv) ? 1 : 0;
+  }
+  a->init = 1;
+  a->enc = enc;
+  return rv;
+}
+
+/** @brief
+    (Re)start the cipher context for a message with the current IV
+    @param a an AES_GCM_CTX_t with the key, cipher and IV set
+    @param enc 1 to encrypt, 0 to decrypt
+    @return 1 if O.K., 0 otherwise
+*/
+static int AES_GCM_Start(AES_GCM_CTX_t *a, int enc)
+{
+  return AES_GCM_StartIV(a, enc, a->iv, a->ivlen);
 }
 
 /** @brief
@@ -378,6 +473,8 @@ int AES_GCM_Init(ICClib *pcb, AES_GCM_CTX *ain, unsigned char *iv, unsigned long
   if ((NULL != key) && (klen > 0)) {
      a->klen = klen;
      memcpy(a->key, key, klen);
+     a->keyed = 0;
+     a->ecbkeyed = 0;
   }
   
   /* we need to have an iv before we create a context for the first time */
@@ -421,11 +518,10 @@ int AES_GCM_Init(ICClib *pcb, AES_GCM_CTX *ain, unsigned char *iv, unsigned long
   */
   if( 1 == rv) {
     if (a->iv && (1 == a->init)) {
-      if (a->enc) {
-        EVP_EncryptInit_ex(a->ctx, NULL, NULL, a->key, a->iv);
-      } else {
-        EVP_DecryptInit_ex(a->ctx, NULL, NULL, a->key, a->iv);
-     }
+      if (1 == EVP_CipherInit_ex(a->ctx, NULL, NULL, a->keyed ? NULL : a->key,
+                                 a->iv, a->enc ? 1 : 0)) {
+        a->keyed = 1;
+      }
     } else {
       /* EVP_EncryptInit_ex will happen in the AES_GCM_??cryptUpdate */
       a->init = 0;
@@ -468,13 +564,7 @@ int AES_GCM_EncryptUpdate(AES_GCM_CTX *ain, unsigned char *aad,
     *outlen = 0;
   }
   if (0 == a->init) {
-    if (NULL == EVP_CIPHER_CTX_cipher(a->ctx)) {
-      rv = EVP_EncryptInit_ex(a->ctx, a->cipher, NULL, NULL, NULL);
-    }
-    EVP_CIPHER_CTX_ctrl(a->ctx, EVP_CTRL_GCM_SET_IVLEN, a->ivlen, NULL);
-    rv = EVP_EncryptInit_ex(a->ctx, NULL, NULL, a->key, a->iv);
-    a->init = 1;
-    a->enc = 1;
+    rv = AES_GCM_Start(a, 1);
   }
   if (1 == rv) {
     if (NULL != aad) {
@@ -518,12 +608,7 @@ int AES_GCM_EncryptUpdate(AES_GCM_CTX *ain, unsigned char *aad,
       *outlen = 0;
     }
     if (0 == a->init) {
-      if (NULL == EVP_CIPHER_CTX_cipher(a->ctx)) {
-        rv = EVP_DecryptInit_ex(a->ctx, a->cipher, NULL, NULL, NULL);
-      }
-      EVP_CIPHER_CTX_ctrl(a->ctx, EVP_CTRL_GCM_SET_IVLEN, a->ivlen, NULL);
-      rv = EVP_DecryptInit_ex(a->ctx, NULL, NULL, a->key, a->iv);
-      a->init = 1;
+      rv = AES_GCM_Start(a, 0);
     }
     if (1 == rv) {
       if (NULL != aad) {
@@ -553,14 +638,7 @@ int AES_GCM_EncryptUpdate(AES_GCM_CTX *ain, unsigned char *aad,
     int outl = 0;
 
     if (0 == a->init) {
-      if (NULL == EVP_CIPHER_CTX_cipher(a->ctx)) {
-        rv = EVP_EncryptInit_ex(a->ctx, a->cipher, NULL, NULL, NULL);
-      }
-      EVP_CIPHER_CTX_ctrl(a->ctx, EVP_CTRL_GCM_SET_IVLEN, a->ivlen, NULL);
-      rv = EVP_EncryptInit_ex(a->ctx, NULL, NULL, a->key, a->iv);
-
-      a->init = 1;
-      a->enc = 1;
+      rv = AES_GCM_Start(a, 1);
     }
     outl = *outlen;
     EVP_EncryptFinal_ex(a->ctx, out, &outl);
@@ -588,13 +666,7 @@ int AES_GCM_EncryptUpdate(AES_GCM_CTX *ain, unsigned char *aad,
     int rv = 1;
 
     if (0 == a->init) {
-      if (NULL == EVP_CIPHER_CTX_cipher(a->ctx)) {
-        rv = EVP_DecryptInit_ex(a->ctx, a->cipher, NULL, NULL, NULL);
-      }
-      EVP_CIPHER_CTX_ctrl(a->ctx, EVP_CTRL_GCM_SET_IVLEN, a->ivlen, NULL);
-      rv = EVP_DecryptInit_ex(a->ctx, NULL, NULL, a->key, a->iv);
-      a->enc = 0;
-      a->init = 1;
+      rv = AES_GCM_Start(a, 0);
     }
     EVP_CIPHER_CTX_ctrl(a->ctx, EVP_CTRL_AEAD_SET_TAG, hlen, hash);
     outl = *outlen;
@@ -603,3 +675,655 @@ int AES_GCM_EncryptUpdate(AES_GCM_CTX *ain, unsigned char *aad,
     a->init = 2;
     return rv;
   }
+
+/** @brief
+    Process a whole message on a started cipher context, the common
+    tail of the one shot and batch calls
+    @param a an AES_GCM_CTX_t started for the message
+    @param enc 1 to encrypt, 0 to decrypt
+    @return 1 if O.K., 0 otherwise. On a decrypt failure out is cleared
+*/
+static int AES_GCM_Crypt(AES_GCM_CTX_t *a, int enc,
+                         unsigned char *aad, unsigned long aadlen,
+                         unsigned char *data, unsigned long datalen,
+                         unsigned char *out, unsigned char *tag,
+                         unsigned int taglen)
+{
+  int outl = 0;
+  int rv = 1;
+
+  if (0 != aadlen) {
+    rv = EVP_CipherUpdate(a->ctx, NULL, &outl, aad, (int)aadlen);
+  }
+  if ((1 == rv) && (0 != datalen)) {
+    rv = EVP_CipherUpdate(a->ctx, out, &outl, data, (int)datalen);
+  }
+  if (1 == rv) {
+    if (enc) {
+      rv = EVP_EncryptFinal_ex(a->ctx, out, &outl);
+      if (1 == rv) {
+        rv = (EVP_CIPHER_CTX_ctrl(a->ctx, EVP_CTRL_GCM_GET_TAG, taglen, tag) > 0) ? 1 : 0;
+      }
+    } else {
+      rv = (EVP_CIPHER_CTX_ctrl(a->ctx, EVP_CTRL_AEAD_SET_TAG, taglen, tag) > 0) ? 1 : 0;
+      if (1 == rv) {
+        rv = EVP_DecryptFinal_ex(a->ctx, out, &outl);
+      }
+    }
+  }
+  if ((1 != rv) && !enc && (0 != datalen)) {
+    /* Don't release unauthenticated plaintext */
+    OPENSSL_cleanse(out, datalen);
+  }
+  return rv;
+}
+
+/** @brief
+    One shot AES GCM encrypt or decrypt, common code for AES_GCM_Seal()
+    and AES_GCM_Open()
+    @param enc 1 to encrypt, 0 to decrypt
+    @return 1 if O.K., 0 or -1 (as AES_GCM_Init()) otherwise
+*/
+static int AES_GCM_OneShot(ICClib *pcb, AES_GCM_CTX *ain, int enc,
+                           unsigned char *iv, unsigned long ivlen,
+                           unsigned char *aad, unsigned long aadlen,
+                           unsigned char *data, unsigned long datalen,
+                           unsigned char *out, unsigned char *tag,
+                           unsigned int taglen)
+{
+  AES_GCM_CTX_t *a = (AES_GCM_CTX_t *)ain;
+  int rv = 0;
+
+  if ((NULL == a) || (NULL == iv) || (0 == ivlen) || (NULL == tag) ||
+      (taglen < 1) || (taglen > 16) ||
+      ((NULL == aad) && (0 != aadlen)) ||
+      (((NULL == data) || (NULL == out)) && (0 != datalen)) ||
+      (aadlen > INT_MAX) || (datalen > INT_MAX)) {
+    return 0;
+  }
+  /* IV checks, TLS rollover rules and the FIPS callback as a
+     separate AES_GCM_Init() would apply */
+  rv = AES_GCM_Init(pcb, ain, iv, ivlen, NULL, 0);
+  if ((1 == rv) && ((1 != a->init) || ((int)a->enc != enc))) {
+    rv = AES_GCM_Start(a, enc);
+  }
+  if (1 == rv) {
+    rv = AES_GCM_Crypt(a, enc, aad, aadlen, data, datalen, out, tag, taglen);
+  } else if (!enc && (0 != datalen)) {
+    /* Don't release unauthenticated plaintext */
+    OPENSSL_cleanse(out, datalen);
+  }
+  a->init = 2;
+  return rv;
+}
+
+/** @brief
+    Encrypt and authenticate a message in one call
+    @param pcb The internal ICC_CTX
+    @param ain an AES_GCM_CTX context with the key set
+    @param iv The IV for this message
+    @param ivlen the length of the IV
+    @param aad additional authentication data, may be NULL if aadlen is 0
+    @param aadlen the length of the aad
+    @param data the plaintext, may be NULL if datalen is 0
+    @param datalen the length of the plaintext
+    @param out the ciphertext, datalen bytes, may be data
+    @param tag a place to store the authentication tag
+    @param taglen the length of the tag, 1-16 bytes
+    @return 1 if O.K., 0 or -1 (as AES_GCM_Init()) otherwise
+    @note Set the key once with AES_GCM_Init(pcb,ain,NULL,0,key,klen).
+    The expanded key and GHASH table stay in the context between
+    messages, where Init/Update/Update/Final restarted the cipher
+    with the key. The IV is checked as AES_GCM_Init() checks it,
+    including the AES_GCM_CTRL_TLS12/TLS13 rollover rules.
+*/
+int AES_GCM_Seal(ICClib *pcb, AES_GCM_CTX *ain,
+                 unsigned char *iv, unsigned long ivlen,
+                 unsigned char *aad, unsigned long aadlen,
+                 unsigned char *data, unsigned long datalen,
+                 unsigned char *out, unsigned char *tag, unsigned int taglen)
+{
+  return AES_GCM_OneShot(pcb, ain, 1, iv, ivlen, aad, aadlen, data, datalen,
+                         out, tag, taglen);
+}
+
+/** @brief
+    Decrypt and verify a message in one call
+    @param pcb The internal ICC_CTX
+    @param ain an AES_GCM_CTX context with the key set
+    @param iv The IV for this message
+    @param ivlen the length of the IV
+    @param aad additional authentication data, may be NULL if aadlen is 0
+    @param aadlen the length of the aad
+    @param data the ciphertext, may be NULL if datalen is 0
+    @param datalen the length of the ciphertext
+    @param out the plaintext, datalen bytes, may be data
+    @param tag the authentication tag to check
+    @param taglen the length of the tag, 1-16 bytes
+    @return 1 if the tag matched, 0 or -1 (as AES_GCM_Init()) otherwise
+    @note as AES_GCM_Seal(). On failure out is cleared.
+*/
+int AES_GCM_Open(ICClib *pcb, AES_GCM_CTX *ain,
+                 unsigned char *iv, unsigned long ivlen,
+                 unsigned char *aad, unsigned long aadlen,
+                 unsigned char *data, unsigned long datalen,
+                 unsigned char *out, unsigned char *tag, unsigned int taglen)
+{
+  return AES_GCM_OneShot(pcb, ain, 0, iv, ivlen, aad, aadlen, data, datalen,
+                         out, tag, taglen);
+}
+
+/*! @brief keystream blocks per AES pass in the batch calls */
+#define GCM_BATCH_BLOCKS 128
+/*! @brief counter blocks needed for len bytes of data */
+#define GCM_NBLOCKS(len) (((len) + 15) / 16)
+/*! @brief records longer than this go through the cipher context,
+    they keep the AES pipeline full on their own and OpenSSL's
+    stitched AES/GHASH code beats separate passes from about here */
+#define GCM_BATCH_MAX 1024
+/*! @brief record r is done by the multi-record kernel */
+#define GCM_BATCHED(r) ((1 == (r)->rv) && ((r)->inlen <= GCM_BATCH_MAX))
+
+/** @brief
+    Key the AES-ECB context and the GHASH key the batch calls use,
+    once per AES key
+    @param a an AES_GCM_CTX_t with the key set
+    @return 1 if O.K., 0 otherwise
+*/
+static int AES_GCM_BatchKey(AES_GCM_CTX_t *a)
+{
+  const EVP_CIPHER *c = NULL;
+  unsigned char H[GHASH_BLOCK];
+  int outl = 0;
+  int rv = 0;
+
+  if (a->ecbkeyed) {
+    return 1;
+  }
+  switch (a->klen) {
+  case 16:
+    if (NULL == ecb_128) {
+      ecb_128 = EVP_get_cipherbyname("aes-128-ecb");
+    }
+    c = ecb_128;
+    break;
+  case 24:
+    if (NULL == ecb_192) {
+      ecb_192 = EVP_get_cipherbyname("aes-192-ecb");
+    }
+    c = ecb_192;
+    break;
+  case 32:
+    if (NULL == ecb_256) {
+      ecb_256 = EVP_get_cipherbyname("aes-256-ecb");
+    }
+    c = ecb_256;
+    break;
+  default:
+    break;
+  }
+  if (NULL == c) {
+    return 0;
+  }
+  if (NULL == a->ecb) {
+    a->ecb = EVP_CIPHER_CTX_new();
+  }
+  if (NULL == a->hkey) {
+    a->hkey = OPENSSL_malloc(sizeof(GHASH_KEY));
+    if (NULL != a->hkey) {
+      memset(a->hkey, 0, sizeof(GHASH_KEY));
+    }
+  }
+  if ((NULL != a->ecb) && (NULL != a->hkey) &&
+      (1 == EVP_EncryptInit_ex(a->ecb, c, NULL, a->key, NULL))) {
+    EVP_CIPHER_CTX_set_padding(a->ecb, 0);
+    /* H = E(K,0^128) */
+    memset(H, 0, sizeof(H));
+    if (1 == EVP_EncryptUpdate(a->ecb, H, &outl, H, sizeof(H))) {
+      GHASH_SetKey(a->hkey, H);
+      rv = 1;
+    }
+    OPENSSL_cleanse(H, sizeof(H));
+  }
+  a->ecbkeyed = rv;
+  return rv;
+}
+
+/*! @brief lb = [alen]64 || [clen]64, the lengths in bits */
+static void gcm_lenblock(unsigned char lb[16], uint64_t alen, uint64_t clen)
+{
+  int i;
+
+  alen <<= 3;
+  clen <<= 3;
+  for (i = 7; i >= 0; i--) {
+    lb[i] = (unsigned char)alen;
+    lb[i + 8] = (unsigned char)clen;
+    alen >>= 8;
+    clen >>= 8;
+  }
+}
+
+/*! @brief the pre-counter block J0 for an IV, SP800-38D 7.1 step 2 */
+static void gcm_j0(const GHASH_KEY *k, const unsigned char *iv,
+                   unsigned long ivlen, unsigned char j0[16])
+{
+  unsigned char lb[16];
+
+  if (12 == ivlen) {
+    memcpy(j0, iv, 12);
+    j0[12] = j0[13] = j0[14] = 0;
+    j0[15] = 1;
+  } else {
+    memset(j0, 0, 16);
+    GHASH_Update(k, j0, iv, (size_t)ivlen);
+    gcm_lenblock(lb, 0, ivlen);
+    GHASH_Update(k, j0, lb, sizeof(lb));
+  }
+}
+
+/*! @brief cb = inc32^n(j0), the n'th counter block after J0 */
+static void gcm_ctr(unsigned char cb[16], const unsigned char j0[16],
+                    unsigned long n)
+{
+  uint32_t c;
+
+  c = ((uint32_t)j0[12] << 24) | ((uint32_t)j0[13] << 16) |
+      ((uint32_t)j0[14] << 8) | (uint32_t)j0[15];
+  c += (uint32_t)n;
+  memcpy(cb, j0, 12);
+  cb[12] = (unsigned char)(c >> 24);
+  cb[13] = (unsigned char)(c >> 16);
+  cb[14] = (unsigned char)(c >> 8);
+  cb[15] = (unsigned char)c;
+}
+
+/*! @brief out = in ^ ks, a word at a time */
+static void gcm_xor(unsigned char *out, const unsigned char *in,
+                    const unsigned char *ks, size_t len)
+{
+  uint64_t x, y;
+  size_t i = 0;
+
+  for (; i + 8 <= len; i += 8) {
+    memcpy(&x, in + i, 8);
+    memcpy(&y, ks + i, 8);
+    x ^= y;
+    memcpy(out + i, &x, 8);
+  }
+  for (; i < len; i++) {
+    out[i] = in[i] ^ ks[i];
+  }
+}
+
+/** @brief
+    AES GCM over many records under one key, common code for
+    AES_GCM_SealBatch() and AES_GCM_OpenBatch()
+    @param enc 1 to encrypt, 0 to decrypt
+    @return 1 if every record succeeded, 0 otherwise
+    @note The counter blocks of consecutive records (J0 for the tag,
+    then the data counters) are packed into one buffer and encrypted
+    with a single AES-ECB pass, so the AES pipeline stays full across
+    record boundaries rather than draining at the end of each short
+    record. GHASH then runs over each record's share of the chunk
+    with the accelerated GHASH_Update(). Only one record is ever
+    part done at a chunk boundary, so no per record state is kept.
+*/
+static int AES_GCM_Batch(ICClib *pcb, AES_GCM_CTX *ain, int enc,
+                         AES_GCM_REC *recs, unsigned int nrecs)
+{
+  AES_GCM_CTX_t *a = (AES_GCM_CTX_t *)ain;
+  unsigned char ks[GCM_BATCH_BLOCKS][16]; /* counter blocks, then keystream */
+  unsigned char j0[16];   /* J0 of the record being filled */
+  unsigned char ekj0[16]; /* E(K,J0) of the record being processed */
+  unsigned char Y[16];    /* and its GHASH */
+  unsigned char lb[16];
+  AES_GCM_REC *r = NULL;
+  unsigned int fr = 0, cr = 0;  /* record being filled, processed */
+  unsigned long fb = 0, cb = 0; /* next counter of each, 0 is J0 */
+  unsigned long nb, m, off, len;
+  unsigned int i;
+  int n, k, outl = 0;
+  int todo = 0;
+  int rv = 1;
+
+  if ((NULL == a) || ((NULL == recs) && (0 != nrecs))) {
+    return 0;
+  }
+  /* Parameter and IV checks first, in record order, so the
+     AES_GCM_CTRL_TLS12/TLS13 rollover rules see the IVs, and the
+     FIPS callback sees one AES_GCM_Init per record, as a run of
+     AES_GCM_Seal()/AES_GCM_Open() calls would. init 0 keeps
+     AES_GCM_Init() off the GCM cipher context, the batch doesn't use it */
+  a->init = 0;
+  for (i = 0; i < nrecs; i++) {
+    r = &recs[i];
+    if ((NULL == r->iv) || (0 == r->ivlen) || (NULL == r->tag) ||
+        (r->taglen < 1) || (r->taglen > 16) ||
+        ((NULL == r->aad) && (0 != r->aadlen)) ||
+        (((NULL == r->in) || (NULL == r->out)) && (0 != r->inlen)) ||
+        (r->aadlen > INT_MAX) || (r->inlen > INT_MAX)) {
+      r->rv = 0;
+    } else {
+      r->rv = AES_GCM_Init(pcb, ain, r->iv, r->ivlen, NULL, 0);
+    }
+    if (1 == r->rv) {
+      todo++;
+    } else {
+      rv = 0;
+      if (!enc && (NULL != r->out) && (0 != r->inlen)) {
+        /* As AES_GCM_Open(), nothing unauthenticated is released */
+        OPENSSL_cleanse(r->out, r->inlen);
+      }
+    }
+  }
+  if (0 == todo) {
+    return rv;
+  }
+  if (1 != AES_GCM_BatchKey(a)) {
+    for (i = 0; i < nrecs; i++) {
+      recs[i].rv = 0;
+    }
+    return 0;
+  }
+  for (i = 0; i < nrecs; i++) {
+    r = &recs[i];
+    if ((1 == r->rv) && !GCM_BATCHED(r)) {
+      r->rv = AES_GCM_StartIV(a, enc, r->iv, r->ivlen);
+      if (1 == r->rv) {
+        r->rv = AES_GCM_Crypt(a, enc, r->aad, r->aadlen, r->in, r->inlen,
+                              r->out, r->tag, r->taglen);
+      } else if (!enc) {
+        OPENSSL_cleanse(r->out, r->inlen);
+      }
+      if (1 != r->rv) {
+        rv = 0;
+      }
+    }
+  }
+  for (;;) {
+    /* Counter blocks for the next chunk, across record boundaries */
+    n = 0;
+    while ((n < GCM_BATCH_BLOCKS) && (fr < nrecs)) {
+      r = &recs[fr];
+      if (!GCM_BATCHED(r)) {
+        fr++;
+        continue;
+      }
+      if (0 == fb) {
+        gcm_j0(a->hkey, r->iv, r->ivlen, j0);
+      }
+      gcm_ctr(ks[n++], j0, fb);
+      if (++fb > GCM_NBLOCKS(r->inlen)) {
+        fr++;
+        fb = 0;
+      }
+    }
+    if (0 == n) {
+      break;
+    }
+    if (1 != EVP_EncryptUpdate(a->ecb, ks[0], &outl, ks[0], n * 16)) {
+      for (i = cr; i < nrecs; i++) {
+        if (GCM_BATCHED(&recs[i])) {
+          recs[i].rv = 0;
+          if (!enc && (0 != recs[i].inlen)) {
+            OPENSSL_cleanse(recs[i].out, recs[i].inlen);
+          }
+        }
+      }
+      rv = 0;
+      break;
+    }
+    /* Apply the keystream, GHASH the ciphertext, finish the tags */
+    k = 0;
+    while ((k < n) && (cr < nrecs)) {
+      r = &recs[cr];
+      if (!GCM_BATCHED(r)) {
+        cr++;
+        continue;
+      }
+      nb = GCM_NBLOCKS(r->inlen);
+      if (0 == cb) {
+        memcpy(ekj0, ks[k++], 16);
+        memset(Y, 0, sizeof(Y));
+        if (0 != r->aadlen) {
+          GHASH_Update(a->hkey, Y, r->aad, (size_t)r->aadlen);
+        }
+        cb = 1;
+      }
+      if ((cb <= nb) && (k < n)) {
+        m = nb + 1 - cb;
+        if (m > (unsigned long)(n - k)) {
+          m = (unsigned long)(n - k);
+        }
+        off = (cb - 1) * 16;
+        len = m * 16;
+        if (len > r->inlen - off) {
+          len = r->inlen - off;
+        }
+        if (enc) {
+          gcm_xor(r->out + off, r->in + off, ks[k], len);
+          GHASH_Update(a->hkey, Y, r->out + off, len);
+        } else {
+          /* GHASH first, out may be in */
+          GHASH_Update(a->hkey, Y, r->in + off, len);
+          gcm_xor(r->out + off, r->in + off, ks[k], len);
+        }
+        k += (int)m;
+        cb += m;
+      }
+      if (cb > nb) {
+        gcm_lenblock(lb, r->aadlen, r->inlen);
+        GHASH_Update(a->hkey, Y, lb, sizeof(lb));
+        XOR(Y, ekj0, sizeof(Y));
+        if (enc) {
+          memcpy(r->tag, Y, r->taglen);
+        } else if (0 != CRYPTO_memcmp(Y, r->tag, r->taglen)) {
+          /* Don't release unauthenticated plaintext */
+          r->rv = 0;
+          rv = 0;
+          if (0 != r->inlen) {
+            OPENSSL_cleanse(r->out, r->inlen);
+          }
+        }
+        cr++;
+        cb = 0;
+      }
+    }
+  }
+  OPENSSL_cleanse(ks, sizeof(ks));
+  OPENSSL_cleanse(ekj0, sizeof(ekj0));
+  OPENSSL_cleanse(Y, sizeof(Y));
+  a->init = 2;
+  return rv;
+}
+
+/** @brief
+    Encrypt and authenticate many records under one key in one call
+    @param pcb The internal ICC_CTX
+    @param ain an AES_GCM_CTX context with the key set
+    @param recs the records, each with its own IV, aad, data and tag
+    @param nrecs the number of records
+    @return 1 if every record was sealed, 0 otherwise. Each record's rv
+    is set as AES_GCM_Seal() would return for it
+    @note The result is the same as AES_GCM_Seal() on each record in
+    turn, including the IV checks and AES_GCM_CTRL_TLS12/TLS13
+    rollover rules, which are applied in record order, and the
+    FIPS callback, once for each record that passes them. A record
+    that fails doesn't stop the others.
+    The AES work for the whole batch is pipelined across records,
+    which is where the gain is for short (TLS/QUIC sized) records.
+*/
+int AES_GCM_SealBatch(ICClib *pcb, AES_GCM_CTX *ain,
+                      AES_GCM_REC *recs, unsigned int nrecs)
+{
+  return AES_GCM_Batch(pcb, ain, 1, recs, nrecs);
+}
+
+/** @brief
+    Decrypt and verify many records under one key in one call
+    @param pcb The internal ICC_CTX
+    @param ain an AES_GCM_CTX context with the key set
+    @param recs the records, each with its own IV, aad, data and tag
+    @param nrecs the number of records
+    @return 1 if every record verified, 0 otherwise. Each record's rv
+    is set as AES_GCM_Open() would return for it
+    @note as AES_GCM_SealBatch(). A record whose tag doesn't match
+    has its output cleared.
+*/
+int AES_GCM_OpenBatch(ICClib *pcb, AES_GCM_CTX *ain,
+                      AES_GCM_REC *recs, unsigned int nrecs)
+{
+  return AES_GCM_Batch(pcb, ain, 0, recs, nrecs);
+}
+
+/** @brief
+    Scatter/gather AES GCM update, common code for
+    AES_GCM_EncryptUpdateV() and AES_GCM_DecryptUpdateV()
+    @param enc 1 to encrypt, 0 to decrypt
+    @return 1 if O.K., 0 otherwise
+    @note The input is walked against the output, each run where an
+    input and an output segment overlap goes straight to the cipher.
+    GCM takes any length per call, so nothing is copied to line up
+    segment or block boundaries.
+*/
+static int AES_GCM_UpdateV(AES_GCM_CTX_t *a, int enc,
+                           AES_GCM_IOV *aad, unsigned int naad,
+                           AES_GCM_IOV *in, unsigned int nin,
+                           AES_GCM_IOV *out, unsigned int nout,
+                           unsigned long *outlen)
+{
+  unsigned long itot = 0, otot = 0;
+  unsigned long ioff = 0, ooff = 0, n;
+  unsigned int i = 0, o = 0;
+  int outl = 0;
+  int rv = 1;
+
+  if (NULL != outlen) {
+    *outlen = 0;
+  }
+  if ((NULL == a) || (NULL == outlen) ||
+      ((NULL == aad) && (0 != naad)) ||
+      ((NULL == in) && (0 != nin)) ||
+      ((NULL == out) && (0 != nout))) {
+    return 0;
+  }
+  for (i = 0; i < naad; i++) {
+    if ((NULL == aad[i].base) && (0 != aad[i].len)) {
+      return 0;
+    }
+  }
+  for (i = 0; i < nin; i++) {
+    if ((NULL == in[i].base) && (0 != in[i].len)) {
+      return 0;
+    }
+    itot += in[i].len;
+  }
+  for (o = 0; o < nout; o++) {
+    if ((NULL == out[o].base) && (0 != out[o].len)) {
+      return 0;
+    }
+    otot += out[o].len;
+  }
+  /* Checked up front so a short output doesn't leave the
+     message half processed */
+  if (otot < itot) {
+    return 0;
+  }
+  if (0 == a->init) {
+    rv = AES_GCM_Start(a, enc);
+  }
+  for (i = 0; (1 == rv) && (i < naad); i++) {
+    for (ioff = 0; (1 == rv) && (ioff < aad[i].len); ioff += n) {
+      n = aad[i].len - ioff;
+      if (n > INT_MAX) {
+        n = INT_MAX;
+      }
+      rv = enc ? EVP_EncryptUpdate(a->ctx, NULL, &outl, aad[i].base + ioff, (int)n)
+               : EVP_DecryptUpdate(a->ctx, NULL, &outl, aad[i].base + ioff, (int)n);
+    }
+  }
+  i = 0;
+  o = 0;
+  ioff = 0;
+  while ((1 == rv) && (i < nin)) {
+    if (ioff == in[i].len) {
+      i++;
+      ioff = 0;
+      continue;
+    }
+    if (ooff == out[o].len) {
+      o++;
+      ooff = 0;
+      continue;
+    }
+    n = in[i].len - ioff;
+    if (n > out[o].len - ooff) {
+      n = out[o].len - ooff;
+    }
+    if (n > INT_MAX) {
+      n = INT_MAX;
+    }
+    outl = 0;
+    rv = enc ? EVP_EncryptUpdate(a->ctx, out[o].base + ooff, &outl,
+                                 in[i].base + ioff, (int)n)
+             : EVP_DecryptUpdate(a->ctx, out[o].base + ooff, &outl,
+                                 in[i].base + ioff, (int)n);
+    *outlen += (unsigned long)outl;
+    ioff += n;
+    ooff += n;
+  }
+  return rv;
+}
+
+/** @brief Perform an AES_GCM_CTX "updateEncrypt" operation on lists
+    of buffer segments
+    @param ain the (opaque) AES_GCM_CTX context
+    @param aad segments of additional authentication data, may be NULL
+    if naad is 0
+    @param naad the number of aad segments
+    @param in segments of data to encrypt, may be NULL if nin is 0
+    @param nin the number of input segments
+    @param out segments for the output, at least as long in total as
+    the input. May be the same list as in, for in place
+    @param nout the number of output segments
+    @param outlen a place to store the length of the output data
+    @return 1 if O.K., 0 otherwise
+    @note The same as AES_GCM_EncryptUpdate() on the concatenated aad
+    and input, the segments needn't be block sized and the input and
+    output segment boundaries needn't line up. The aad rules of
+    AES_GCM_EncryptUpdate() apply, once data has been supplied no more
+    aad may follow.
+*/
+int AES_GCM_EncryptUpdateV(AES_GCM_CTX *ain,
+                           AES_GCM_IOV *aad, unsigned int naad,
+                           AES_GCM_IOV *in, unsigned int nin,
+                           AES_GCM_IOV *out, unsigned int nout,
+                           unsigned long *outlen)
+{
+  return AES_GCM_UpdateV((AES_GCM_CTX_t *)ain, 1, aad, naad, in, nin,
+                         out, nout, outlen);
+}
+
+/** @brief Perform an AES_GCM_CTX "updateDecrypt" operation on lists
+    of buffer segments
+    @param ain the (opaque) AES_GCM_CTX context
+    @param aad segments of additional authentication data
+    @param naad the number of aad segments
+    @param in segments of data to decrypt
+    @param nin the number of input segments
+    @param out segments for the output, may be the same list as in
+    @param nout the number of output segments
+    @param outlen a place to store the length of the output data
+    @return 1 if O.K., 0 otherwise
+    @note as AES_GCM_EncryptUpdateV()
+*/
+int AES_GCM_DecryptUpdateV(AES_GCM_CTX *ain,
+                           AES_GCM_IOV *aad, unsigned int naad,
+                           AES_GCM_IOV *in, unsigned int nin,
+                           AES_GCM_IOV *out, unsigned int nout,
+                           unsigned long *outlen)
+{
+  return AES_GCM_UpdateV((AES_GCM_CTX_t *)ain, 0, aad, naad, in, nin,
+                         out, nout, outlen);
+}
@@ -21,6 +21,7 @@ extern "C" {
 #define AES_GCM_CTRL_GET_ACCEL 1
 #define AES_GCM_CTRL_TLS13 2
 #define AES_GCM_CTRL_TLS12 4
+#define AES_GCM_CTRL_GHASH_IMPL 8
 
 #define IVBLEN 16 /* Length of the fixed internal IV buffer */
 
@@ -46,17 +47,31 @@ typedef struct AES_GCM_struct {
   ** AES_GCM_EncryptFinal 0,1-> 2 */
   unsigned int enc;           /*!< 0 = decrypt */
   unsigned int flags;
+  unsigned int keyed;         /*!< ctx holds the expanded key, an IV change alone needn't redo it */
+  struct GHASH_KEY_t *ghash;  /*!< Expanded key for GHASH(), allocated on first use */
+  EVP_CIPHER_CTX *ecb;        /*!< AES-ECB with the key, keystream for the batch calls */
+  unsigned int ecbkeyed;      /*!< ecb and hkey match the current key */
+  struct GHASH_KEY_t *hkey;   /*!< GHASH key E(K,0) for the batch calls */
 } AES_GCM_CTX_t;
 
 
 typedef struct AES_GCM_CTX_t AES_GCM_CTX;
 
+/*! @brief One record for the batch calls, public as ICC_AES_GCM_REC */
+typedef ICC_AES_GCM_REC AES_GCM_REC;
+
+/*! @brief One buffer segment for the scatter/gather calls, public as ICC_AES_GCM_IOV */
+typedef ICC_AES_GCM_IOV AES_GCM_IOV;
+
 int AES_GCM_GenerateIV(AES_GCM_CTX *gcm_ctx,unsigned char out[8]);
 int AES_GCM_GenerateIV_NIST(AES_GCM_CTX *gcm_ctx,int ivlen,unsigned char *iv);
 AES_GCM_CTX *AES_GCM_CTX_new();
 void AES_GCM_CTX_free(AES_GCM_CTX *ctx);
 int AES_GCM_CTX_ctrl(AES_GCM_CTX *ain, int mode, int accel, void *ptr);
 
+void GHASH(AES_GCM_CTX *gcm_ctx,unsigned char *H, unsigned char *Hash,
+           unsigned char *X,unsigned long Xlen);
+
 int AES_GCM_Init(ICClib *pcb,AES_GCM_CTX *ain,
 		 unsigned char *iv,unsigned long ivlen,
 		 unsigned char *key, unsigned int klen );
@@ -79,6 +94,36 @@ int AES_GCM_DecryptFinal(AES_GCM_CTX *ain,
 			 unsigned char *out, unsigned long *outlen,
 			 unsigned char *hash,unsigned int hlen);
 
+int AES_GCM_Seal(ICClib *pcb,AES_GCM_CTX *ain,
+		 unsigned char *iv,unsigned long ivlen,
+		 unsigned char *aad,unsigned long aadlen,
+		 unsigned char *data,unsigned long datalen,
+		 unsigned char *out,unsigned char *tag,unsigned int taglen);
+
+int AES_GCM_Open(ICClib *pcb,AES_GCM_CTX *ain,
+		 unsigned char *iv,unsigned long ivlen,
+		 unsigned char *aad,unsigned long aadlen,
+		 unsigned char *data,unsigned long datalen,
+		 unsigned char *out,unsigned char *tag,unsigned int taglen);
+
+int AES_GCM_SealBatch(ICClib *pcb,AES_GCM_CTX *ain,
+		      AES_GCM_REC *recs,unsigned int nrecs);
+
+int AES_GCM_OpenBatch(ICClib *pcb,AES_GCM_CTX *ain,
+		      AES_GCM_REC *recs,unsigned int nrecs);
+
+int AES_GCM_EncryptUpdateV(AES_GCM_CTX *ain,
+			   AES_GCM_IOV *aad,unsigned int naad,
+			   AES_GCM_IOV *in,unsigned int nin,
+			   AES_GCM_IOV *out,unsigned int nout,
+			   unsigned long *outlen);
+
+int AES_GCM_DecryptUpdateV(AES_GCM_CTX *ain,
+			   AES_GCM_IOV *aad,unsigned int naad,
+			   AES_GCM_IOV *in,unsigned int nin,
+			   AES_GCM_IOV *out,unsigned int nout,
+			   unsigned long *outlen);
+
 #ifdef __cplusplus
 }
 #endif
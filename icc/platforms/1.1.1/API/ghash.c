@@ -0,0 +1,565 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: GCM GHASH (SP800-38D 6.4) behind the exported GHASH() API
+//
+*************************************************************************/
+
+/*
+  OpenSSL's GCM keeps it's GHASH internal, so GHASH() needs it's own.
+
+  - The portable path is Shoup's 4 bit table, n * H for each nibble
+    value n. The table entry is selected by reading all 16 entries
+    under a mask and the reduction constant is computed rather than
+    looked up, so no memory access depends on the data or the key.
+  - x86_64 with PCLMULQDQ does four blocks per reduction,
+    Y = (Y ^ X1).H^4 ^ X2.H^3 ^ X3.H^2 ^ X4.H
+    and with VPCLMULQDQ/AVX2 eight, two blocks per 256 bit lane pair.
+  - ARMv8 with PMULL does four blocks per reduction as x86_64.
+
+  The carry-less multiply paths work on byte reversed blocks, where
+  the 128x128 product shifted left one bit has the low order
+  coefficients in it's top half already in GCM bit order. See
+  "Intel Carry-Less Multiplication Instruction and its Usage for
+  Computing the GCM Mode", Gueron and Kounavis, algorithm 5.
+
+  The powers of H are computed once, portably, in GHASH_SetKey().
+*/
+
+#include <string.h>
+#include "ghash.h"
+
+#if defined(_WIN32) && !defined(__GNUC__)
+#define GH_U64(C) C##ui64
+#else
+#define GH_U64(C) C##ULL
+#endif
+
+#if defined(__x86_64__) && \
+  (defined(__clang__) || (defined(__GNUC__) && (__GNUC__ >= 5)))
+#define GHASH_X86 1
+#include <immintrin.h>
+/* The crypto capability vector, ICC_CAP_MASK is applied to this */
+extern unsigned int *OPENSSL_ia32cap_loc(void);
+/* OPENSSL_ia32cap_P[1] CPUID.1:ECX, bit 1 PCLMULQDQ, bit 9 SSSE3,
+     bit 28 AVX usable (OS saves YMM state)
+   OPENSSL_ia32cap_P[2] CPUID.7:EBX, bit 5 AVX2
+   OPENSSL_ia32cap_P[3] CPUID.7:ECX, bit 10 VPCLMULQDQ
+*/
+#define GH_PCLMULQDQ (1U << 1)
+#define GH_SSSE3 (1U << 9)
+#define GH_AVX (1U << 28)
+#define GH_AVX2 (1U << 5)
+#define GH_VPCLMULQDQ (1U << 10)
+#define GH_PCLMUL_TARGET __attribute__((target("pclmul,ssse3")))
+/* Helpers are inlined so the VPCLMULQDQ path doesn't mix in
+   legacy SSE encodings with the upper YMM state dirty */
+#define GH_INLINE __inline__ __attribute__((always_inline))
+#if defined(__clang__) || (__GNUC__ >= 8)
+#define GHASH_X86_VPCLMUL 1
+#define GH_VPCLMUL_TARGET __attribute__((target("vpclmulqdq,pclmul,avx2")))
+#endif
+
+#elif defined(__aarch64__) && defined(__AARCH64EL__) && \
+  (defined(__clang__) || (defined(__GNUC__) && (__GNUC__ >= 8)))
+#define GHASH_ARM64 1
+#include <arm_neon.h>
+#if defined(__linux__)
+#include <sys/auxv.h>
+#if !defined(HWCAP_PMULL)
+#define HWCAP_PMULL (1 << 4)
+#endif
+#endif
+#if defined(__clang__)
+#define GH_PMULL_TARGET __attribute__((target("aes")))
+#else
+#define GH_PMULL_TARGET __attribute__((target("+crypto")))
+#endif
+#endif
+
+/*! @brief x^128 = x^7 + x^2 + x + 1, in GCM bit order */
+#define GH_R GH_U64(0xE100000000000000)
+
+/*!
+  @brief load a block as two big endian 64 bit words
+*/
+static void gh_load(const unsigned char *p, uint64_t *hi, uint64_t *lo)
+{
+  uint64_t h = 0, l = 0;
+  int i;
+
+  for (i = 0; i < 8; i++) {
+    h = (h << 8) | p[i];
+    l = (l << 8) | p[i + 8];
+  }
+  *hi = h;
+  *lo = l;
+}
+
+static void gh_store(unsigned char *p, uint64_t hi, uint64_t lo)
+{
+  int i;
+
+  for (i = 7; i >= 0; i--) {
+    p[i] = (unsigned char)hi;
+    p[i + 8] = (unsigned char)lo;
+    hi >>= 8;
+    lo >>= 8;
+  }
+}
+
+/*!
+  @brief store a block byte reversed, as the carry-less multiply paths
+  hold it in a 128 bit little endian register
+*/
+static void gh_store_rev(unsigned char *p, uint64_t hi, uint64_t lo)
+{
+  int i;
+
+  for (i = 0; i < 8; i++) {
+    p[i] = (unsigned char)lo;
+    p[i + 8] = (unsigned char)hi;
+    lo >>= 8;
+    hi >>= 8;
+  }
+}
+
+/*!
+  @brief the reduction of the 4 bits shifted out by Z.x^4
+  @param r the bits shifted out
+  @return the value to xor into the top word
+  @note computed, not looked up, to keep memory access data independent
+*/
+static uint64_t gh_rem4(unsigned int r)
+{
+  return (((uint64_t)0 - (uint64_t)(r & 1)) & (GH_R >> 3)) ^
+         (((uint64_t)0 - (uint64_t)((r >> 1) & 1)) & (GH_R >> 2)) ^
+         (((uint64_t)0 - (uint64_t)((r >> 2) & 1)) & (GH_R >> 1)) ^
+         (((uint64_t)0 - (uint64_t)((r >> 3) & 1)) & GH_R);
+}
+
+/*!
+  @brief Z = Z.x^4 ^ n.H
+  @param k expanded key
+  @param zh,zl the accumulator
+  @param n the nibble
+  @note all 16 table entries are read for every nibble
+*/
+static void gh_step(const GHASH_KEY *k, uint64_t *zh, uint64_t *zl,
+                    unsigned int n)
+{
+  uint64_t h = *zh, l = *zl, m;
+  unsigned int r, j;
+
+  r = (unsigned int)(l & 0xf);
+  l = (l >> 4) | (h << 60);
+  h = (h >> 4) ^ gh_rem4(r);
+  for (j = 0; j < 16; j++) {
+    m = (uint64_t)0 - (uint64_t)(((j ^ n) - 1) >> 31);
+    h ^= k->Htable[j][0] & m;
+    l ^= k->Htable[j][1] & m;
+  }
+  *zh = h;
+  *zl = l;
+}
+
+/*!
+  @brief Y = Y.H with the 4 bit table
+*/
+static void gh_mul_table(const GHASH_KEY *k, uint64_t *yh, uint64_t *yl)
+{
+  uint64_t zh = 0, zl = 0, w = *yl;
+  unsigned int b;
+  int i;
+
+  /* Horner, last byte first, low nibble before high */
+  for (i = 0; i < 16; i++) {
+    if (8 == i) {
+      w = *yh;
+    }
+    b = (unsigned int)(w >> (8 * (i & 7))) & 0xff;
+    gh_step(k, &zh, &zl, b & 0xf);
+    gh_step(k, &zh, &zl, b >> 4);
+  }
+  *yh = zh;
+  *yl = zl;
+}
+
+static void gh_table(const GHASH_KEY *k, unsigned char *Y,
+                     const unsigned char *in, size_t len)
+{
+  uint64_t yh, yl, xh, xl;
+
+  gh_load(Y, &yh, &yl);
+  while (len >= GHASH_BLOCK) {
+    gh_load(in, &xh, &xl);
+    yh ^= xh;
+    yl ^= xl;
+    gh_mul_table(k, &yh, &yl);
+    in += GHASH_BLOCK;
+    len -= GHASH_BLOCK;
+  }
+  gh_store(Y, yh, yl);
+}
+
+#if defined(GHASH_X86)
+
+static GH_INLINE GH_PCLMUL_TARGET __m128i gh_bswap(__m128i x)
+{
+  return _mm_shuffle_epi8(x, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+                                          11, 12, 13, 14, 15));
+}
+
+/*!
+  @brief accumulate the unreduced 256 bit product a.b as lo, mid, hi
+*/
+static GH_INLINE GH_PCLMUL_TARGET void gh_clmul(__m128i a, __m128i b, __m128i *lo,
+                                      __m128i *mid, __m128i *hi)
+{
+  *lo = _mm_xor_si128(*lo, _mm_clmulepi64_si128(a, b, 0x00));
+  *hi = _mm_xor_si128(*hi, _mm_clmulepi64_si128(a, b, 0x11));
+  *mid = _mm_xor_si128(*mid,
+                       _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10),
+                                     _mm_clmulepi64_si128(a, b, 0x01)));
+}
+
+/*!
+  @brief shift the accumulated product left one bit and reduce it
+*/
+static GH_INLINE GH_PCLMUL_TARGET __m128i gh_reduce(__m128i lo, __m128i mid,
+                                          __m128i hi)
+{
+  __m128i t2, t3, t4, t5, t6, t7, t8, t9;
+
+  t3 = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+  t6 = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+  /* << 1 */
+  t7 = _mm_srli_epi32(t3, 31);
+  t8 = _mm_srli_epi32(t6, 31);
+  t3 = _mm_slli_epi32(t3, 1);
+  t6 = _mm_slli_epi32(t6, 1);
+  t9 = _mm_srli_si128(t7, 12);
+  t8 = _mm_slli_si128(t8, 4);
+  t7 = _mm_slli_si128(t7, 4);
+  t3 = _mm_or_si128(t3, t7);
+  t6 = _mm_or_si128(t6, t8);
+  t6 = _mm_or_si128(t6, t9);
+  /* First phase */
+  t7 = _mm_slli_epi32(t3, 31);
+  t8 = _mm_slli_epi32(t3, 30);
+  t9 = _mm_slli_epi32(t3, 25);
+  t7 = _mm_xor_si128(t7, t8);
+  t7 = _mm_xor_si128(t7, t9);
+  t8 = _mm_srli_si128(t7, 4);
+  t7 = _mm_slli_si128(t7, 12);
+  t3 = _mm_xor_si128(t3, t7);
+  /* Second phase */
+  t2 = _mm_srli_epi32(t3, 1);
+  t4 = _mm_srli_epi32(t3, 2);
+  t5 = _mm_srli_epi32(t3, 7);
+  t2 = _mm_xor_si128(t2, t4);
+  t2 = _mm_xor_si128(t2, t5);
+  t2 = _mm_xor_si128(t2, t8);
+  t3 = _mm_xor_si128(t3, t2);
+  return _mm_xor_si128(t6, t3);
+}
+
+static GH_PCLMUL_TARGET void gh_pclmul(const GHASH_KEY *k, unsigned char *Y,
+                                       const unsigned char *in, size_t len)
+{
+  __m128i y, h1, h2, h3, h4, lo, mid, hi;
+  const __m128i z = _mm_setzero_si128();
+
+  y = gh_bswap(_mm_loadu_si128((const __m128i *)Y));
+  h1 = _mm_loadu_si128((const __m128i *)k->Hp[0]);
+  h2 = _mm_loadu_si128((const __m128i *)k->Hp[1]);
+  h3 = _mm_loadu_si128((const __m128i *)k->Hp[2]);
+  h4 = _mm_loadu_si128((const __m128i *)k->Hp[3]);
+  while (len >= 4 * GHASH_BLOCK) {
+    lo = mid = hi = z;
+    gh_clmul(_mm_xor_si128(y, gh_bswap(_mm_loadu_si128((const __m128i *)in))),
+             h4, &lo, &mid, &hi);
+    gh_clmul(gh_bswap(_mm_loadu_si128((const __m128i *)(in + 16))), h3, &lo,
+             &mid, &hi);
+    gh_clmul(gh_bswap(_mm_loadu_si128((const __m128i *)(in + 32))), h2, &lo,
+             &mid, &hi);
+    gh_clmul(gh_bswap(_mm_loadu_si128((const __m128i *)(in + 48))), h1, &lo,
+             &mid, &hi);
+    y = gh_reduce(lo, mid, hi);
+    in += 4 * GHASH_BLOCK;
+    len -= 4 * GHASH_BLOCK;
+  }
+  while (len >= GHASH_BLOCK) {
+    lo = mid = hi = z;
+    gh_clmul(_mm_xor_si128(y, gh_bswap(_mm_loadu_si128((const __m128i *)in))),
+             h1, &lo, &mid, &hi);
+    y = gh_reduce(lo, mid, hi);
+    in += GHASH_BLOCK;
+    len -= GHASH_BLOCK;
+  }
+  _mm_storeu_si128((__m128i *)Y, gh_bswap(y));
+}
+
+#if defined(GHASH_X86_VPCLMUL)
+/*!
+  @brief eight blocks per reduction, two per 256 bit register,
+  the tail goes to gh_pclmul()
+*/
+static GH_VPCLMUL_TARGET void gh_vpclmul(const GHASH_KEY *k, unsigned char *Y,
+                                         const unsigned char *in, size_t len)
+{
+  const __m256i bs = _mm256_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
+                                     12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7,
+                                     8, 9, 10, 11, 12, 13, 14, 15);
+  const __m256i z = _mm256_setzero_si256();
+  __m256i p[4], x, lo, mid, hi;
+  __m128i y;
+  int j;
+
+  if (len >= 8 * GHASH_BLOCK) {
+    /* Lane 0 multiplies the earlier block, so the higher power */
+    for (j = 0; j < 4; j++) {
+      p[j] = _mm256_inserti128_si256(
+          _mm256_castsi128_si256(
+              _mm_loadu_si128((const __m128i *)k->Hp[7 - 2 * j])),
+          _mm_loadu_si128((const __m128i *)k->Hp[6 - 2 * j]), 1);
+    }
+    y = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)Y),
+                         _mm256_castsi256_si128(bs));
+    while (len >= 8 * GHASH_BLOCK) {
+      lo = mid = hi = z;
+      for (j = 0; j < 4; j++) {
+        x = _mm256_shuffle_epi8(
+            _mm256_loadu_si256((const __m256i *)(in + 32 * j)), bs);
+        if (0 == j) {
+          x = _mm256_xor_si256(x, _mm256_inserti128_si256(z, y, 0));
+        }
+        lo = _mm256_xor_si256(lo, _mm256_clmulepi64_epi128(x, p[j], 0x00));
+        hi = _mm256_xor_si256(hi, _mm256_clmulepi64_epi128(x, p[j], 0x11));
+        mid = _mm256_xor_si256(
+            mid, _mm256_xor_si256(_mm256_clmulepi64_epi128(x, p[j], 0x10),
+                                  _mm256_clmulepi64_epi128(x, p[j], 0x01)));
+      }
+      y = gh_reduce(_mm_xor_si128(_mm256_castsi256_si128(lo),
+                                  _mm256_extracti128_si256(lo, 1)),
+                    _mm_xor_si128(_mm256_castsi256_si128(mid),
+                                  _mm256_extracti128_si256(mid, 1)),
+                    _mm_xor_si128(_mm256_castsi256_si128(hi),
+                                  _mm256_extracti128_si256(hi, 1)));
+      in += 8 * GHASH_BLOCK;
+      len -= 8 * GHASH_BLOCK;
+    }
+    _mm_storeu_si128((__m128i *)Y,
+                     _mm_shuffle_epi8(y, _mm256_castsi256_si128(bs)));
+  }
+  gh_pclmul(k, Y, in, len);
+}
+#endif /* GHASH_X86_VPCLMUL */
+#endif /* GHASH_X86 */
+
+#if defined(GHASH_ARM64)
+
+static int gh_have_pmull(void)
+{
+#if defined(__APPLE__)
+  return 1;
+#elif defined(__linux__)
+  return (getauxval(AT_HWCAP) & HWCAP_PMULL) ? 1 : 0;
+#else
+  return 0;
+#endif
+}
+
+static GH_PMULL_TARGET uint64x2_t gh_bswap(uint64x2_t x)
+{
+  uint8x16_t r = vrev64q_u8(vreinterpretq_u8_u64(x));
+  return vreinterpretq_u64_u8(vextq_u8(r, r, 8));
+}
+
+static GH_PMULL_TARGET void gh_pmull(uint64x2_t a, uint64x2_t b,
+                                     uint64x2_t *lo, uint64x2_t *mid,
+                                     uint64x2_t *hi)
+{
+  poly64_t a0 = (poly64_t)vgetq_lane_u64(a, 0);
+  poly64_t a1 = (poly64_t)vgetq_lane_u64(a, 1);
+  poly64_t b0 = (poly64_t)vgetq_lane_u64(b, 0);
+  poly64_t b1 = (poly64_t)vgetq_lane_u64(b, 1);
+
+  *lo = veorq_u64(*lo, vreinterpretq_u64_p128(vmull_p64(a0, b0)));
+  *hi = veorq_u64(*hi, vreinterpretq_u64_p128(vmull_p64(a1, b1)));
+  *mid = veorq_u64(*mid,
+                   veorq_u64(vreinterpretq_u64_p128(vmull_p64(a0, b1)),
+                             vreinterpretq_u64_p128(vmull_p64(a1, b0))));
+}
+
+/*!
+  @brief shift the accumulated product left one bit and reduce it,
+  as gh_reduce() on x86_64 but in 64 bit words
+*/
+static GH_PMULL_TARGET uint64x2_t gh_reduce(uint64x2_t lo, uint64x2_t mid,
+                                            uint64x2_t hi)
+{
+  uint64_t q0, q1, q2, q3, dh, dl;
+
+  q0 = vgetq_lane_u64(lo, 0);
+  q1 = vgetq_lane_u64(lo, 1) ^ vgetq_lane_u64(mid, 0);
+  q2 = vgetq_lane_u64(hi, 0) ^ vgetq_lane_u64(mid, 1);
+  q3 = vgetq_lane_u64(hi, 1);
+  /* << 1, q3:q2 is now the low order half in GCM bit order */
+  q3 = (q3 << 1) | (q2 >> 63);
+  q2 = (q2 << 1) | (q1 >> 63);
+  q1 = (q1 << 1) | (q0 >> 63);
+  q0 <<= 1;
+  /* q1:q0 x^128 = q1:q0 (x^7 + x^2 + x + 1), first the bits
+     that multiplication pushes past x^127 */
+  dh = q1 ^ (q0 << 63) ^ (q0 << 62) ^ (q0 << 57);
+  dl = q0;
+  q3 ^= dh ^ (dh >> 1) ^ (dh >> 2) ^ (dh >> 7);
+  q2 ^= dl ^ ((dl >> 1) | (dh << 63)) ^ ((dl >> 2) | (dh << 62)) ^
+        ((dl >> 7) | (dh << 57));
+  return vcombine_u64(vcreate_u64(q2), vcreate_u64(q3));
+}
+
+static GH_PMULL_TARGET void gh_pmull4(const GHASH_KEY *k, unsigned char *Y,
+                                      const unsigned char *in, size_t len)
+{
+  uint64x2_t y, h1, h2, h3, h4, lo, mid, hi;
+  const uint64x2_t z = vdupq_n_u64(0);
+
+  y = gh_bswap(vld1q_u64((const uint64_t *)Y));
+  h1 = vreinterpretq_u64_u8(vld1q_u8(k->Hp[0]));
+  h2 = vreinterpretq_u64_u8(vld1q_u8(k->Hp[1]));
+  h3 = vreinterpretq_u64_u8(vld1q_u8(k->Hp[2]));
+  h4 = vreinterpretq_u64_u8(vld1q_u8(k->Hp[3]));
+  while (len >= 4 * GHASH_BLOCK) {
+    lo = mid = hi = z;
+    gh_pmull(veorq_u64(y, gh_bswap(vreinterpretq_u64_u8(vld1q_u8(in)))), h4,
+             &lo, &mid, &hi);
+    gh_pmull(gh_bswap(vreinterpretq_u64_u8(vld1q_u8(in + 16))), h3, &lo, &mid,
+             &hi);
+    gh_pmull(gh_bswap(vreinterpretq_u64_u8(vld1q_u8(in + 32))), h2, &lo, &mid,
+             &hi);
+    gh_pmull(gh_bswap(vreinterpretq_u64_u8(vld1q_u8(in + 48))), h1, &lo, &mid,
+             &hi);
+    y = gh_reduce(lo, mid, hi);
+    in += 4 * GHASH_BLOCK;
+    len -= 4 * GHASH_BLOCK;
+  }
+  while (len >= GHASH_BLOCK) {
+    lo = mid = hi = z;
+    gh_pmull(veorq_u64(y, gh_bswap(vreinterpretq_u64_u8(vld1q_u8(in)))), h1,
+             &lo, &mid, &hi);
+    y = gh_reduce(lo, mid, hi);
+    in += GHASH_BLOCK;
+    len -= GHASH_BLOCK;
+  }
+  vst1q_u8(Y, vreinterpretq_u8_u64(gh_bswap(y)));
+}
+#endif /* GHASH_ARM64 */
+
+int GHASH_Impl(void)
+{
+  int rv = GHASH_IMPL_TABLE;
+#if defined(GHASH_X86)
+  unsigned int *cap = OPENSSL_ia32cap_loc();
+
+  if ((NULL != cap) && (cap[1] & GH_PCLMULQDQ) && (cap[1] & GH_SSSE3)) {
+    rv = GHASH_IMPL_PCLMUL;
+#if defined(GHASH_X86_VPCLMUL)
+    if ((cap[1] & GH_AVX) && (cap[2] & GH_AVX2) && (cap[3] & GH_VPCLMULQDQ)) {
+      rv = GHASH_IMPL_VPCLMUL;
+    }
+#endif
+  }
+#elif defined(GHASH_ARM64)
+  if (gh_have_pmull()) {
+    rv = GHASH_IMPL_PMULL;
+  }
+#endif
+  return rv;
+}
+
+void GHASH_SetKey(GHASH_KEY *k, const unsigned char *H)
+{
+  uint64_t hi, lo;
+  int i, j;
+
+  memcpy(k->H, H, GHASH_BLOCK);
+  gh_load(H, &hi, &lo);
+  memset(k->Htable, 0, sizeof(k->Htable));
+  /* Htable[8] is H, the high bit of the nibble is x^0 */
+  for (i = 8; i > 0; i >>= 1) {
+    k->Htable[i][0] = hi;
+    k->Htable[i][1] = lo;
+    /* H.x */
+    j = (int)(lo & 1);
+    lo = (lo >> 1) | (hi << 63);
+    hi = (hi >> 1) ^ (((uint64_t)0 - (uint64_t)j) & GH_R);
+  }
+  for (i = 2; i < 16; i <<= 1) {
+    for (j = 1; j < i; j++) {
+      k->Htable[i + j][0] = k->Htable[i][0] ^ k->Htable[j][0];
+      k->Htable[i + j][1] = k->Htable[i][1] ^ k->Htable[j][1];
+    }
+  }
+  gh_load(H, &hi, &lo);
+  gh_store_rev(k->Hp[0], hi, lo);
+  for (i = 1; i < GHASH_POWERS; i++) {
+    gh_mul_table(k, &hi, &lo);
+    gh_store_rev(k->Hp[i], hi, lo);
+  }
+  hi = lo = 0;
+  k->impl = GHASH_Impl();
+  k->set = 1;
+}
+
+/*!
+  @brief GHASH whole blocks with the key's implementation
+*/
+static void gh_blocks(const GHASH_KEY *k, unsigned char *Y,
+                      const unsigned char *in, size_t len)
+{
+  switch (k->impl) {
+#if defined(GHASH_X86)
+  case GHASH_IMPL_PCLMUL:
+    gh_pclmul(k, Y, in, len);
+    break;
+#if defined(GHASH_X86_VPCLMUL)
+  case GHASH_IMPL_VPCLMUL:
+    gh_vpclmul(k, Y, in, len);
+    break;
+#endif
+#endif
+#if defined(GHASH_ARM64)
+  case GHASH_IMPL_PMULL:
+    gh_pmull4(k, Y, in, len);
+    break;
+#endif
+  default:
+    gh_table(k, Y, in, len);
+    break;
+  }
+}
+
+void GHASH_Update(const GHASH_KEY *k, unsigned char *Y,
+                  const unsigned char *in, size_t len)
+{
+  unsigned char last[GHASH_BLOCK];
+  size_t full = len & ~(size_t)(GHASH_BLOCK - 1);
+
+  if (full > 0) {
+    gh_blocks(k, Y, in, full);
+  }
+  if (len > full) {
+    memset(last, 0, sizeof(last));
+    memcpy(last, in + full, len - full);
+    gh_blocks(k, Y, last, GHASH_BLOCK);
+    memset(last, 0, sizeof(last));
+  }
+}
@@ -0,0 +1,63 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description: GCM GHASH (SP800-38D 6.4) behind the exported GHASH() API
+//
+*************************************************************************/
+
+#ifndef HEADER_GHASH_H
+#define HEADER_GHASH_H
+
+#include "openssl/e_os2.h"
+
+#define GHASH_BLOCK 16   /*!< GHASH block and key size */
+#define GHASH_POWERS 8   /*!< Powers of H kept for the carry-less multiply paths */
+
+/*! @brief GHASH implementations, in AES_GCM_CTRL_GHASH_IMPL order */
+#define GHASH_IMPL_TABLE 0   /*!< Portable, constant time, 4 bit table */
+#define GHASH_IMPL_PCLMUL 1  /*!< x86_64 PCLMULQDQ, 4 blocks per reduction */
+#define GHASH_IMPL_VPCLMUL 2 /*!< x86_64 VPCLMULQDQ/AVX2, 8 blocks per reduction */
+#define GHASH_IMPL_PMULL 3   /*!< ARMv8 PMULL, 4 blocks per reduction */
+
+/*! @brief an expanded GHASH key */
+typedef struct GHASH_KEY_t {
+  uint64_t Htable[16][2];                     /*!< n * H for each 4 bit n, hi/lo */
+  unsigned char Hp[GHASH_POWERS][GHASH_BLOCK]; /*!< H^1..H^8, byte reversed */
+  unsigned char H[GHASH_BLOCK];               /*!< The key as supplied */
+  int impl;                                   /*!< GHASH_IMPL_xxx used */
+  int set;                                    /*!< A key has been set */
+} GHASH_KEY;
+
+/*!
+  @brief the GHASH implementation this CPU would use
+  @return GHASH_IMPL_xxx
+  @note re-evaluated on each call so capability masking
+        (ICC_CAP_MASK) takes effect
+*/
+int GHASH_Impl(void);
+
+/*!
+  @brief expand a GHASH key
+  @param k the key structure to fill
+  @param H the hash key, E(K,0^128) for GCM
+*/
+void GHASH_SetKey(GHASH_KEY *k, const unsigned char *H);
+
+/*!
+  @brief GHASH a data stream
+  @param k an expanded key
+  @param Y the running hash, 0 at first use, updated in place
+  @param in the data
+  @param len the length of the data, a partial last block is 0 padded
+  @note calls chain, provided all but the last have whole blocks
+*/
+void GHASH_Update(const GHASH_KEY *k, unsigned char *Y,
+                  const unsigned char *in, size_t len);
+
+#endif
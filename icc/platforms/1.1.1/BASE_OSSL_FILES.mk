@@ -5,16 +5,20 @@
 # in the one shared lib this is easier maintenance
 #
 OSSL_XTRA_OBJ = aes_gcm$(OBJSUFX) \
-		aes_ccm$(OBJSUFX)
+		aes_ccm$(OBJSUFX) \
+		ghash$(OBJSUFX)
 
 #		icc_cmac$(OBJSUFX)
 
-aes_gcm$(OBJSUFX): platforms/$(OPENSSL_LIBVER)/API/aes_gcm.c platforms/$(OPENSSL_LIBVER)/API/aes_gcm.h platforms/$(OPENSSL_LIBVER)/API/aes_ccm.h
+aes_gcm$(OBJSUFX): platforms/$(OPENSSL_LIBVER)/API/aes_gcm.c platforms/$(OPENSSL_LIBVER)/API/aes_gcm.h platforms/$(OPENSSL_LIBVER)/API/aes_ccm.h platforms/$(OPENSSL_LIBVER)/API/ghash.h
 	$(CC) $(CFLAGS) -I./ -I$(OSSLINC_DIR) -Iplatforms/$(OPENSSL_LIBVER)/API platforms/$(OPENSSL_LIBVER)/API/aes_gcm.c $(OUT)$@
 
 aes_ccm$(OBJSUFX): platforms/$(OPENSSL_LIBVER)/API/aes_ccm.c platforms/$(OPENSSL_LIBVER)/API/aes_ccm.h platforms/$(OPENSSL_LIBVER)/API/aes_gcm.h
 	$(CC) $(CFLAGS) -I./ -I$(OSSLINC_DIR) -Iplatforms/$(OPENSSL_LIBVER)/API platforms/$(OPENSSL_LIBVER)/API/aes_ccm.c $(OUT)$@
 
+ghash$(OBJSUFX): platforms/$(OPENSSL_LIBVER)/API/ghash.c platforms/$(OPENSSL_LIBVER)/API/ghash.h
+	$(CC) $(CFLAGS) -I./ -I$(OSSLINC_DIR) -Iplatforms/$(OPENSSL_LIBVER)/API platforms/$(OPENSSL_LIBVER)/API/ghash.c $(OUT)$@
+
 #aes_gcm.c: platforms/$(OPENSSL_LIBVER)/API/aes_gcm.c
 #	$(CP) platforms/$(OPENSSL_LIBVER)/API/aes_gcm.c $@
 
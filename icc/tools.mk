@@ -18,6 +18,12 @@ TOOLS =	 \
 	smalltest4$(EXESUFX) \
 	GenRndData2$(EXESUFX) \
 	GenRndDataFIPS$(EXESUFX) \
+	EstBench$(EXESUFX) \
+	TimerCal$(EXESUFX) \
+	trng_bench$(EXESUFX) \
+	drbg_bench$(EXESUFX) \
+	ghash_bench$(EXESUFX) \
+	gcm_bench$(EXESUFX) \
 	sha256x$(EXESUFX)
 
 # Disabled. Tried, didn't work
@@ -28,13 +34,13 @@ TOOLS =	 \
 # RNG data collection code.
 #
 GENRND_OBJS = GenRndData$(OBJSUFX) platform$(OBJSUFX) \
-	timer_entropy$(OBJSUFX) nist_algs$(OBJSUFX) \
+	timer_entropy$(OBJSUFX) timer_cache$(OBJSUFX) nist_algs$(OBJSUFX) \
 	noise_to_entropy$(OBJSUFX) \
 	TRNG_ALT4$(OBJSUFX) looper$(OBJSUFX) \
 	$(ASMOBJS)
 
 GENRNDFIPS_OBJS =  GenRndDataFIPS$(OBJSUFX) platform$(OBJSUFX) \
-	timer_entropy$(OBJSUFX) nist_algs$(OBJSUFX) \
+	timer_entropy$(OBJSUFX) timer_cache$(OBJSUFX) nist_algs$(OBJSUFX) \
 	noise_to_entropy$(OBJSUFX) timer_fips$(OBJSUFX) \
 	TRNG_FIPS$(OBJSUFX) looper$(OBJSUFX) \
 	$(ASMOBJS)
@@ -113,6 +119,66 @@ GenRndDataFIPS.exe : $(GENRNDFIPS_OBJS)
 	-$(MT) -manifest $@.manifest  -outputresource:$@\;1
 
 
+#- TRNG long term entropy estimator comparison, deflate vs MCV
+
+ESTBENCH_OBJS = EstBench$(OBJSUFX) entropy_estimator$(OBJSUFX)
+
+EstBench$(OBJSUFX): tools/EstBench.c $(TRNG_DIR)/entropy_estimator.h $(TRNG_DIR)/entropy_to_NRBGi.h
+	-$(CC) $(CFLAGS) -I./ -I../$(ZLIB) -I$(OSSLINC_DIR) -I$(OSSL_DIR) -I$(SDK_DIR) -I$(API_DIR) tools/EstBench.c
+
+EstBench$(EXESUFX): $(ESTBENCH_OBJS) $(STLPRFX)zlib$(STLSUFX)
+	-$(LD) $(LDFLAGS) $(ESTBENCH_OBJS) $(STLPRFX)zlib$(STLSUFX) $(LDLIBS)
+
+#- Regenerate the TRNG timer calibration cache (ICC_TIMER_CACHE)
+
+TIMERCAL_OBJS = TimerCal$(OBJSUFX) platform$(OBJSUFX) \
+	timer_entropy$(OBJSUFX) timer_cache$(OBJSUFX) nist_algs$(OBJSUFX) \
+	noise_to_entropy$(OBJSUFX) timer_fips$(OBJSUFX) \
+	TRNG_FIPS$(OBJSUFX) looper$(OBJSUFX) \
+	$(ASMOBJS)
+
+TimerCal$(OBJSUFX): tools/TimerCal.c $(TRNG_DIR)/timer_cache.h $(TRNG_DIR)/timer_fips.h
+	-$(CC) $(CFLAGS) -I./  -I$(ZLIB_DIR) -I$(OSSLINC_DIR) -I$(OSSL_DIR) -I$(SDK_DIR) tools/TimerCal.c  $(ASM_TWEAKS)
+
+TimerCal$(EXESUFX): $(TIMERCAL_OBJS)
+	-$(LD) $(LDFLAGS) $(TIMERCAL_OBJS) $(LDLIBS)
+
+#- End to end TRNG seed throughput/latency per TRNG type and thread count
+#  JSON results, used to size ICC_RNG_INSTANCES.
+#  Links the library objects directly as it needs the TRNG internals
+
+trng_bench$(OBJSUFX): tools/trng_bench.c $(TRNG_DIR)/ICC_NRBG.h $(TRNG_DIR)/entropy_to_NRBGi.h \
+	$(TRNG_DIR)/noise_to_entropy.h tools/bench_clock.h
+	-$(CC) $(CFLAGS) -I./ -I../$(ZLIB) -I$(OSSLINC_DIR) -I$(OSSL_DIR) -I$(SDK_DIR) -I$(API_DIR) tools/trng_bench.c
+
+trng_bench$(EXESUFX): trng_bench$(OBJSUFX) icclib$(OBJSUFX) $(LIBOBJS) $(STLPRFX)zlib$(STLSUFX) tmp/tmp/dummyfile
+	-$(LD) $(LDFLAGS) trng_bench$(OBJSUFX) icclib$(OBJSUFX) $(LIBOBJS) $(STLPRFX)zlib$(STLSUFX) \
+		tmp/tmp/*$(OBJSUFX) $(LDLIBS)
+
+#- SP800-90 DRBG and RNG pool throughput/latency per mode, request size
+#  and thread count. JSON results. Uses the public API like GenRndData2
+
+drbg_bench$(OBJSUFX): tools/drbg_bench.c $(SDK_DIR)/icc.h $(SDK_DIR)/icc_a.h $(SDK_DIR)/iccglobals.h \
+	tools/bench_clock.h
+	-$(CC) $(CFLAGS) -I $(SDK_DIR) tools/drbg_bench.c
+
+drbg_bench$(EXESUFX): drbg_bench$(OBJSUFX) $(ICCLIB)
+	-$(LD) $(LDFLAGS) drbg_bench$(OBJSUFX) $(ICCLIB) $(LDLIBS)
+
+ghash_bench$(OBJSUFX): tools/ghash_bench.c $(SDK_DIR)/icc.h $(SDK_DIR)/icc_a.h $(SDK_DIR)/iccglobals.h \
+	tools/bench_clock.h
+	-$(CC) $(CFLAGS) -I $(SDK_DIR) tools/ghash_bench.c
+
+ghash_bench$(EXESUFX): ghash_bench$(OBJSUFX) $(ICCLIB)
+	-$(LD) $(LDFLAGS) ghash_bench$(OBJSUFX) $(ICCLIB) $(LDLIBS)
+
+gcm_bench$(OBJSUFX): tools/gcm_bench.c $(SDK_DIR)/icc.h $(SDK_DIR)/icc_a.h $(SDK_DIR)/iccglobals.h \
+	tools/bench_clock.h
+	-$(CC) $(CFLAGS) -I $(SDK_DIR) tools/gcm_bench.c
+
+gcm_bench$(EXESUFX): gcm_bench$(OBJSUFX) $(ICCLIB)
+	-$(LD) $(LDFLAGS) gcm_bench$(OBJSUFX) $(ICCLIB) $(LDLIBS)
+
 #	
 #- Build an exectuable version of libicclib.so so we can debug the POST code
 #
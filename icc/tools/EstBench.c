@@ -0,0 +1,112 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description:
+//           Compares the TRNG long term entropy estimators.
+//           Throughput when fed seed sized requests, memory held per
+//           TRNG instance, and that both trip on low entropy input.
+//
+//           EstBench [MB]
+//
+*************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "TRNG/entropy_to_NRBGi.h"
+
+#define SEEDLEN 48 /* A typical DRBG seed request */
+
+unsigned int icc_failure = 0;
+
+void *ICC_Calloc(size_t n, size_t sz, const char *file, int line) {
+  return calloc(n, sz);
+}
+
+void ICC_Free(void *ptr) { free(ptr); }
+
+/* Stand in for conditioned TRNG output */
+static unsigned long long xs = 0x9E3779B97F4A7C15ULL;
+
+static void fill(unsigned char *buf, int len, int good)
+{
+  int i;
+  for (i = 0; i < len; i++) {
+    if (good) {
+      xs ^= xs << 13;
+      xs ^= xs >> 7;
+      xs ^= xs << 17;
+      buf[i] = (unsigned char)(xs >> 24);
+    } else {
+      buf[i] = (unsigned char)("ABAB"[i & 3]);
+    }
+  }
+}
+
+static void run(const char *name, int mb)
+{
+  TRNG *T = NULL;
+  unsigned char buf[SEEDLEN];
+  clock_t t0, t1;
+  double secs = 0.0;
+  long i, n;
+  int ok = 0;
+  int est = 0;
+  int size = 0;
+
+  SetEntropyEstimator(name);
+  T = (TRNG *)calloc(1, sizeof(TRNG));
+  if ((NULL == T) || (TRNG_OK != InitEntropyEstimator(T))) {
+    printf("%-8s init failed\n", name);
+    free(T);
+    return;
+  }
+  n = ((long)mb * 1024 * 1024) / SEEDLEN;
+  t0 = clock();
+  for (i = 0; i < n; i++) {
+    fill(buf, SEEDLEN, 1);
+    EntropyEstimator(T, buf, SEEDLEN);
+    ok += EntropyOK(T) ? 0 : 1;
+  }
+  t1 = clock();
+  secs = (double)(t1 - t0) / CLOCKS_PER_SEC;
+  est = GetEntropy(T);
+  size = EntropyEstimatorSize(T);
+  printf("%-8s %8.1f MB/s %6.0f ns/seed  %6d bytes/instance  estimate %3d%%  false fails %d\n",
+         name, (secs > 0.0) ? (mb / secs) : 0.0,
+         (secs * 1e9) / (double)n, size, est, ok);
+  /* Now starve it */
+  for (i = 0; i < 4096 / SEEDLEN; i++) {
+    fill(buf, SEEDLEN, 0);
+    EntropyEstimator(T, buf, SEEDLEN);
+  }
+  printf("%-8s low entropy input: estimate %3d%% %s\n", name, GetEntropy(T),
+         EntropyOK(T) ? "NOT DETECTED" : "detected");
+  CleanupEntropyEstimator(T);
+  free(T);
+}
+
+int main(int argc, char *argv[])
+{
+  int mb = 64;
+
+  if (argc > 1) {
+    mb = atoi(argv[1]);
+    if (mb <= 0) {
+      mb = 64;
+    }
+  }
+  printf("%d MB in %d byte requests\n", mb, SEEDLEN);
+  run("DEFLATE", mb);
+  run("MCV", mb);
+  return 0;
+}
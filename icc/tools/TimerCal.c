@@ -0,0 +1,147 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description:
+//           Regenerates the TRNG timer calibration cache used via
+//           ICC_TIMER_CACHE. Runs the full calibration and lets the
+//           TRNG_FIPS loop tuner settle, saves the result, then
+//           checks the quick startup path accepts the file.
+//
+//           TimerCal [cachefile]
+//           default cachefile is $ICC_TIMER_CACHE
+//
+//           Rerun after a CPU, kernel or ICC change, the file is
+//           ignored (full calibration) until then.
+//
+*************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "TRNG/noise_to_entropy.h"
+#include "TRNG/TRNG_FIPS.h"
+#include "TRNG/timer_fips.h"
+#include "TRNG/timer_cache.h"
+
+#define SETTLE 32 /* Blocks generated so the loop tuner settles */
+
+unsigned int icc_failure = 0;
+
+extern int shift_done;
+extern int cal_loops;
+extern int Shift(void);
+
+void SetFatalError(const char *msg, const char *file, int line) {
+  fprintf(stderr, "%s: %s,%d\n", msg, file, line);
+  exit(1);
+}
+void SetRNGError(const char *msg, const char *file, int line) {
+  SetFatalError(msg,file,line);
+}
+
+void *ICC_Calloc(size_t n, size_t sz, const char *file, int line) {
+  return calloc(n, sz);
+}
+
+void ICC_Free(void *ptr) { free(ptr); }
+
+unsigned int Personalize(unsigned char *buffer)
+{
+  time_t t;
+  if(NULL != buffer) {
+    time(&t);
+    strcpy((char *)buffer,ctime(&t));
+  }
+  return 80;
+}
+
+static E_SOURCE trng;
+
+static ENTROPY_IMPL MYTRNG = {
+  "TRNG_FIPS",
+  TRNG_FIPS,
+  4,
+  TRNG_FIPS_getbytes,
+  TRNG_FIPS_Init,
+  TRNG_FIPS_Cleanup,
+  TRNG_FIPS_preinit
+};
+
+static double ms(clock_t t0, clock_t t1)
+{
+  return (1000.0 * (double)(t1 - t0)) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char *argv[])
+{
+  const char *path = NULL;
+  unsigned char buffer[256];
+  char key[512];
+  clock_t t0, t1;
+  int shft = 0, lps = 0;
+  int i = 0;
+
+  path = (argc > 1) ? argv[1] : getenv("ICC_TIMER_CACHE");
+  if ((NULL == path) || ('\0' == path[0])) {
+    fprintf(stderr, "Usage %s cachefile\n", argv[0]);
+    fprintf(stderr, "      or set ICC_TIMER_CACHE\n");
+    exit(1);
+  }
+  if (!TimerCacheKey(key, sizeof(key))) {
+    fprintf(stderr, "Timer calibration caching isn't supported on this platform\n");
+    exit(1);
+  }
+  printf("Key     %s\n", key);
+
+  /* Full calibration, no cache set */
+  SetTimerCache(NULL);
+  t0 = clock();
+  CalcShift(0);
+  t1 = clock();
+  shift_done = 1;
+  shft = Shift();
+  printf("Full calibration  %8.2f ms, shift %d\n", ms(t0, t1), shft);
+
+  memcpy(&trng.impl, &MYTRNG, sizeof(trng.impl));
+  ht_Init(&(trng.hti), 50);
+  if (NULL != trng.impl.preinit) {
+    trng.impl.preinit(0);
+  }
+  if (TRNG_OK != trng.impl.init(&trng, NULL, 0)) {
+    fprintf(stderr, "Could not initialize TRNG, exiting\n");
+    exit(1);
+  }
+  for (i = 0; i < SETTLE; i++) {
+    trng.impl.gb(&trng, buffer, sizeof(buffer));
+  }
+  lps = (int)fips_loops();
+  if (NULL != trng.impl.cleanup) {
+    trng.impl.cleanup(&trng);
+  }
+  printf("Loop tuner settled on %d\n", lps);
+
+  if (!TimerCacheWrite(path, shft, lps)) {
+    fprintf(stderr, "Could not write %s\n", path);
+    exit(1);
+  }
+  /* Now what a process using the file will see */
+  SetTimerCache(path);
+  cal_loops = -1;
+  t0 = clock();
+  CalcShift(0);
+  t1 = clock();
+  printf("Cached startup    %8.2f ms, shift %d, loops %d, %s\n", ms(t0, t1),
+         Shift(), cal_loops,
+         (cal_loops == lps) ? "accepted" : "spot check failed, full calibration used");
+  printf("Wrote %s\n", path);
+  return 0;
+}
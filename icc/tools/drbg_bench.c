@@ -0,0 +1,483 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description:
+//           SP800-90 DRBG throughput/latency via the public API.
+//           For each RNG mode (as GenRndData2), prediction resistance
+//           off/on, thread count and request size, every thread
+//           instantiates it's own RNG_CTX and times RNG_Generate().
+//           Reports ops/s, bytes/s, instantiate and reseed cost
+//           the memory held by each context (SP800_90_GETSIZE) and
+//           the last DRBG self test time (SP800_90_GETTESTTIME).
+//
+//           The POOL pseudo mode times RAND_bytes(), the global
+//           RNG pool, sized with -i (ICC_RNG_INSTANCES) and using
+//           the PRNG selected with -g (ICC_RANDOM_GENERATOR).
+//           Those are process wide and fixed at startup, so compare
+//           pool configurations by running once per setting.
+//           Likewise ICC_TRNG_POOL, DRBG's sharing seed sources,
+//           and ICC_RNG_TEST_THREAD, background periodic self tests.
+//
+//           drbg_bench pathToICC [-n ops] [-t 1,2,4] [-s 16,1024,...]
+//                      [-m AES-256-ECB,...,POOL] [-P 0|1]
+//                      [-g PRNG] [-i instances] [-o results.json]
+//
+*************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#define strcasecmp(x,y) _stricmp(x,y)
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#include "icc.h"
+#include "bench_clock.h"
+
+/* The SP800-90 modes, less the ETAP_ and NOISE_ test taps */
+static const char *alglist[] =
+  {
+    "DSS_3_1_SHA","DSS_3_2_SHA","DSS_3_1_SHArev","DSS_3_2_SHArev",
+    "DSS_3_1_SHAgp","DSS_3_1_SHArevgp",
+    "AES-128-ECB","AES-192-ECB","AES-256-ECB",
+    "AES-128-ECB-NODF","AES-192-ECB-NODF","AES-256-ECB-NODF",
+    "SHA1","SHA224","SHA256","SHA384","SHA512",
+    "HMAC-SHA1","HMAC-SHA224","HMAC-SHA256","HMAC-SHA384","HMAC-SHA512",
+    "TRNG_OS","TRNG_HW","TRNG_FIPS",
+    NULL
+  };
+
+#define POOL "POOL"     /* RAND_bytes(), the global pool */
+#define MAX_THREADS 64
+#define MAX_SIZES 16
+#define MAX_MODES 32
+#define RESEEDS 4       /* Timed reseeds per thread */
+
+static int dsizes[] = {16, 64, 256, 1024, 4096, 16384, 65536};
+#define NDSIZES (int)(sizeof(dsizes) / sizeof(dsizes[0]))
+
+static ICC_CTX *ICC_ctx = NULL;
+
+typedef struct {
+  ICC_PRNG *rng;        /* NULL for the pool */
+  int pr;               /* Prediction resistance */
+  int size;
+  int n;
+  unsigned char *buf;
+  double gen;           /* ns, the timed requests */
+  double inst;          /* ns, RNG_CTX_new + RNG_CTX_Init */
+  double reseed;        /* ns, mean of RESEEDS reseeds */
+  unsigned long reseeds;/* Reseeds the DRBG asked for while generating */
+  unsigned int bytes;   /* Context footprint, SP800_90_GETSIZE */
+  unsigned int test_us; /* Last self test run, SP800_90_GETTESTTIME */
+  int ok;
+  const char *err;
+} JOB;
+
+typedef struct {
+  const char *mode;
+  int pr;
+  int threads;
+  int size;
+  double ops;
+  double bps;
+  double inst;
+  double reseed;
+  unsigned long reseeds;
+  unsigned int bytes;
+  unsigned int test_us;
+  int failed;
+  const char *err;
+} RESULT;
+
+/*!
+  @brief one RNG_Generate() request, split at the per call limit
+  @return 1 on success
+*/
+static int generate(ICC_PRNG_CTX *ctx, JOB *job, unsigned int maxd)
+{
+  SP800_90STATE state = SP800_90RUN;
+  int left = job->size;
+  int k = 0;
+  int rv = 1;
+
+  while (rv && (left > 0)) {
+    k = ((maxd > 0) && ((unsigned int)left > maxd)) ? (int)maxd : left;
+    state = ICC_RNG_Generate(ICC_ctx, ctx, job->buf, k, NULL, 0);
+    switch (state) {
+    case SP800_90RUN:
+      break;
+    case SP800_90RESEED:
+      job->reseeds++;
+      ICC_RNG_ReSeed(ICC_ctx, ctx, NULL, 0);
+      break;
+    default:
+      ICC_RNG_CTX_ctrl(ICC_ctx, ctx, SP800_90_GETLASTERROR, 0, &(job->err));
+      rv = 0;
+      break;
+    }
+    left -= k;
+  }
+  return rv;
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI worker(LPVOID arg)
+#else
+static void *worker(void *arg)
+#endif
+{
+  JOB *job = (JOB *)arg;
+  ICC_PRNG_CTX *ctx = NULL;
+  SP800_90STATE state = SP800_90UNINIT;
+  unsigned int maxd = 0;
+  double t0;
+  int i;
+
+  if (NULL == job->rng) {
+    job->ok = 1;
+    t0 = now_ns();
+    for (i = 0; (i < job->n) && job->ok; i++) {
+      if (1 != ICC_RAND_bytes(ICC_ctx, job->buf, job->size)) {
+        job->ok = 0;
+        job->err = "RAND_bytes failed";
+      }
+    }
+    job->gen = now_ns() - t0;
+  } else {
+    t0 = now_ns();
+    ctx = ICC_RNG_CTX_new(ICC_ctx);
+    if (NULL != ctx) {
+      state = ICC_RNG_CTX_Init(ICC_ctx, ctx, job->rng, NULL, 0, 0, job->pr);
+    }
+    job->inst = now_ns() - t0;
+    if ((SP800_90INIT == state) || (SP800_90RUN == state) ||
+        (SP800_90RESEED == state)) {
+      ICC_RNG_CTX_ctrl(ICC_ctx, ctx, SP800_90_GETMAXDATA, 0, &maxd);
+      ICC_RNG_CTX_ctrl(ICC_ctx, ctx, SP800_90_GETSIZE, 0, &(job->bytes));
+      ICC_RNG_CTX_ctrl(ICC_ctx, ctx, SP800_90_GETTESTTIME, 0, &(job->test_us));
+      job->ok = 1;
+      t0 = now_ns();
+      for (i = 0; (i < job->n) && job->ok; i++) {
+        job->ok = generate(ctx, job, maxd);
+      }
+      job->gen = now_ns() - t0;
+      if (job->ok) {
+        t0 = now_ns();
+        for (i = 0; i < RESEEDS; i++) {
+          ICC_RNG_ReSeed(ICC_ctx, ctx, NULL, 0);
+        }
+        job->reseed = (now_ns() - t0) / RESEEDS;
+      }
+    } else if (NULL != ctx) {
+      ICC_RNG_CTX_ctrl(ICC_ctx, ctx, SP800_90_GETLASTERROR, 0, &(job->err));
+    }
+    if (NULL != ctx) {
+      ICC_RNG_CTX_free(ICC_ctx, ctx);
+    }
+  }
+#if defined(_WIN32)
+  return 0;
+#else
+  return NULL;
+#endif
+}
+
+static void run(const char *mode, ICC_PRNG *rng, int pr, int threads,
+                int size, int n, RESULT *r)
+{
+  JOB job[MAX_THREADS];
+#if defined(_WIN32)
+  HANDLE tid[MAX_THREADS];
+#else
+  pthread_t tid[MAX_THREADS];
+#endif
+  int i;
+
+  memset(r, 0, sizeof(RESULT));
+  r->mode = mode;
+  r->pr = pr;
+  r->threads = threads;
+  r->size = size;
+  for (i = 0; i < threads; i++) {
+    memset(&job[i], 0, sizeof(JOB));
+    job[i].rng = rng;
+    job[i].pr = pr;
+    job[i].size = size;
+    job[i].n = n;
+    job[i].buf = (unsigned char *)malloc(size);
+  }
+  for (i = 0; i < threads; i++) {
+#if defined(_WIN32)
+    tid[i] = CreateThread(NULL, 0, worker, &job[i], 0, NULL);
+#else
+    pthread_create(&tid[i], NULL, worker, &job[i]);
+#endif
+  }
+  for (i = 0; i < threads; i++) {
+#if defined(_WIN32)
+    WaitForSingleObject(tid[i], INFINITE);
+    CloseHandle(tid[i]);
+#else
+    pthread_join(tid[i], NULL);
+#endif
+  }
+  for (i = 0; i < threads; i++) {
+    if (!job[i].ok) {
+      r->failed++;
+      if (NULL == r->err) {
+        r->err = job[i].err;
+      }
+    } else if (job[i].gen > 0.0) {
+      /* Aggregate rate, each thread over it's own generate time */
+      r->ops += ((double)n * 1e9) / job[i].gen;
+    }
+    r->inst += job[i].inst / threads;
+    r->reseed += job[i].reseed / threads;
+    r->reseeds += job[i].reseeds;
+    if (job[i].bytes > r->bytes) {
+      r->bytes = job[i].bytes;
+    }
+    if (job[i].test_us > r->test_us) {
+      r->test_us = job[i].test_us;
+    }
+    free(job[i].buf);
+  }
+  if (0 == r->failed) {
+    r->bps = r->ops * size;
+  } else {
+    r->ops = 0.0;
+  }
+}
+
+static void usage(const char *me)
+{
+  int i;
+  fprintf(stderr, "Usage: %s pathToICC [-n ops] [-t 1,2,4] [-s 16,1024,...] [-m mode,...] [-P 0|1]\n", me);
+  fprintf(stderr, "       [-g PRNG] [-i instances] [-o results.json]\n");
+  fprintf(stderr, "       pathToICC is the path to the ICC libraries passed to ICC_Init()\n");
+  fprintf(stderr, "       -n requests timed per thread (default 200)\n");
+  fprintf(stderr, "       -t thread counts (default 1,2,4)\n");
+  fprintf(stderr, "       -s request sizes (default 16 to 65536)\n");
+  fprintf(stderr, "       -m modes (default all available and %s)\n", POOL);
+  fprintf(stderr, "       -P prediction resistance, 0 or 1 (default both)\n");
+  fprintf(stderr, "       -g pool PRNG (ICC_RANDOM_GENERATOR)\n");
+  fprintf(stderr, "       -i pool size (ICC_RNG_INSTANCES)\n");
+  fprintf(stderr, "       -o JSON output file (default drbg_bench.json)\n");
+  fprintf(stderr, "       modes:\n");
+  for (i = 0; NULL != alglist[i]; i++) {
+    fprintf(stderr, "         %s\n", alglist[i]);
+  }
+  fprintf(stderr, "         %s\n", POOL);
+  exit(1);
+}
+
+/*!
+  @brief parse a comma separated list of positive integers
+  @return number of entries
+*/
+static int intlist(char *s, int *out, int max, int hi)
+{
+  char *p = NULL;
+  int n = 0, v;
+
+  for (p = strtok(s, ","); (NULL != p) && (n < max); p = strtok(NULL, ",")) {
+    v = atoi(p);
+    if ((v > 0) && (v <= hi)) {
+      out[n++] = v;
+    }
+  }
+  return n;
+}
+
+int main(int argc, char *argv[])
+{
+  ICC_STATUS stat, *status = &stat;
+  char *path = NULL;
+  int tlist[MAX_THREADS];
+  int nt = 0;
+  int slist[MAX_SIZES];
+  int ns = 0;
+  const char *modes[MAX_MODES];
+  int nm = 0;
+  int prlo = 0, prhi = 1;
+  int n = 200;
+  int instances = 0;
+  const char *gen = NULL;
+  const char *out = "drbg_bench.json";
+  char prng[20];
+  RESULT *res = NULL;
+  int nres = 0;
+  ICC_PRNG *rng = NULL;
+  FILE *fp = NULL;
+  char *p = NULL;
+  int i, j, s, t, pr;
+
+  if (argc < 2) {
+    usage(argv[0]);
+  }
+  path = argv[1];
+  for (i = 2; i < argc; i++) {
+    if ((0 == strcmp(argv[i], "-n")) && (i + 1 < argc)) {
+      n = atoi(argv[++i]);
+    } else if ((0 == strcmp(argv[i], "-t")) && (i + 1 < argc)) {
+      nt = intlist(argv[++i], tlist, MAX_THREADS, MAX_THREADS);
+    } else if ((0 == strcmp(argv[i], "-s")) && (i + 1 < argc)) {
+      ns = intlist(argv[++i], slist, MAX_SIZES, 1024 * 1024);
+    } else if ((0 == strcmp(argv[i], "-m")) && (i + 1 < argc)) {
+      for (p = strtok(argv[++i], ","); (NULL != p) && (nm < MAX_MODES); p = strtok(NULL, ",")) {
+        for (j = 0; NULL != alglist[j]; j++) {
+          if (0 == strcasecmp(p, alglist[j])) {
+            modes[nm++] = alglist[j];
+            break;
+          }
+        }
+        if (NULL == alglist[j]) {
+          if (0 != strcasecmp(p, POOL)) {
+            fprintf(stderr, "Unknown mode %s\n", p);
+            usage(argv[0]);
+          }
+          modes[nm++] = POOL;
+        }
+      }
+    } else if ((0 == strcmp(argv[i], "-P")) && (i + 1 < argc)) {
+      prlo = prhi = (0 != atoi(argv[++i])) ? 1 : 0;
+    } else if ((0 == strcmp(argv[i], "-g")) && (i + 1 < argc)) {
+      gen = argv[++i];
+    } else if ((0 == strcmp(argv[i], "-i")) && (i + 1 < argc)) {
+      instances = atoi(argv[++i]);
+    } else if ((0 == strcmp(argv[i], "-o")) && (i + 1 < argc)) {
+      out = argv[++i];
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (n <= 0) {
+    usage(argv[0]);
+  }
+  if (0 == nt) {
+    tlist[nt++] = 1;
+    tlist[nt++] = 2;
+    tlist[nt++] = 4;
+  }
+  if (0 == ns) {
+    for (ns = 0; ns < NDSIZES; ns++) {
+      slist[ns] = dsizes[ns];
+    }
+  }
+  if (0 == nm) {
+    for (j = 0; (NULL != alglist[j]) && (nm < MAX_MODES - 1); j++) {
+      modes[nm++] = alglist[j];
+    }
+    modes[nm++] = POOL;
+  }
+
+  /* Pool settings are global and must be set before ICC_Init() */
+  memset(status, 0, sizeof(ICC_STATUS));
+  if (NULL != gen) {
+    ICC_SetValue(NULL, status, ICC_RANDOM_GENERATOR, (const void *)gen);
+  }
+  if (instances > 0) {
+    ICC_SetValue(NULL, status, ICC_RNG_INSTANCES, (const void *)&instances);
+  }
+  ICC_ctx = ICC_Init(status, path);
+  if (NULL == ICC_ctx) {
+    fprintf(stderr, "Could not initialize ICC [%s], exiting\n", status->desc);
+    exit(1);
+  }
+  ICC_SetValue(ICC_ctx, status, ICC_FIPS_APPROVED_MODE, "off");
+  if (ICC_ERROR == ICC_Attach(ICC_ctx, status)) {
+    fprintf(stderr, "Could not initialize ICC [%s], exiting\n", status->desc);
+    ICC_Cleanup(ICC_ctx, status);
+    exit(1);
+  }
+  memset(prng, 0, sizeof(prng));
+  ICC_GetValue(ICC_ctx, status, ICC_RANDOM_GENERATOR, prng, sizeof(prng) - 1);
+  ICC_GetValue(ICC_ctx, status, ICC_RNG_INSTANCES, &instances, sizeof(instances));
+  printf("Pool: %s x %d%s%s%s%s\n", prng, instances,
+         (NULL != getenv("ICC_RNG_PER_THREAD")) ? ", ICC_RNG_PER_THREAD set" : "",
+         (NULL != getenv("ICC_TRNG_POOL")) ? ", ICC_TRNG_POOL=" : "",
+         (NULL != getenv("ICC_TRNG_POOL")) ? getenv("ICC_TRNG_POOL") : "",
+         (NULL != getenv("ICC_RNG_TEST_THREAD")) ? ", ICC_RNG_TEST_THREAD set" : "");
+
+  res = (RESULT *)calloc((size_t)nm * 2 * nt * ns, sizeof(RESULT));
+  if (NULL == res) {
+    ICC_Cleanup(ICC_ctx, status);
+    return 1;
+  }
+  printf("%-17s %2s %4s %6s %12s %12s %10s %10s %7s %7s %8s\n", "mode", "pr",
+         "thr", "size", "ops/s", "bytes/s", "inst us", "reseed us", "reseeds",
+         "ctx B", "test us");
+  for (i = 0; i < nm; i++) {
+    rng = NULL;
+    if (0 != strcmp(POOL, modes[i])) {
+      rng = ICC_get_RNGbyname(ICC_ctx, modes[i]);
+      if (NULL == rng) {
+        printf("%-17s not available\n", modes[i]);
+        continue;
+      }
+    }
+    for (pr = prlo; pr <= prhi; pr++) {
+      /* The pool has no prediction resistance setting */
+      if ((NULL == rng) && (pr != prlo)) {
+        break;
+      }
+      for (t = 0; t < nt; t++) {
+        for (s = 0; s < ns; s++) {
+          RESULT *r = &res[nres++];
+          run(modes[i], rng, (NULL == rng) ? 0 : pr, tlist[t], slist[s], n, r);
+          if (r->failed) {
+            printf("%-17s %2d %4d %6d FAILED in %d thread(s) %s\n", r->mode,
+                   r->pr, r->threads, r->size, r->failed,
+                   (NULL != r->err) ? r->err : "");
+          } else {
+            printf("%-17s %2d %4d %6d %12.0f %12.0f %10.1f %10.1f %7lu %7u %8u\n",
+                   r->mode, r->pr, r->threads, r->size, r->ops, r->bps,
+                   r->inst / 1e3, r->reseed / 1e3, r->reseeds, r->bytes,
+                   r->test_us);
+          }
+        }
+      }
+    }
+  }
+
+  fp = fopen(out, "w");
+  if (NULL == fp) {
+    fprintf(stderr, "Could not open %s\n", out);
+    free(res);
+    ICC_Cleanup(ICC_ctx, status);
+    return 1;
+  }
+  fprintf(fp, "{\n  \"requests_per_thread\": %d,\n  \"pool_prng\": \"%s\",\n"
+          "  \"pool_instances\": %d,\n  \"results\": [", n, prng, instances);
+  for (i = 0; i < nres; i++) {
+    fprintf(fp,
+            "%s\n    {\"mode\": \"%s\", \"prediction_resistance\": %s, "
+            "\"threads\": %d, \"request_bytes\": %d, \"ok\": %s, "
+            "\"ops_per_sec\": %.0f, \"bytes_per_sec\": %.0f, "
+            "\"instantiate_ns\": %.0f, \"reseed_ns\": %.0f, \"reseeds\": %lu, "
+            "\"context_bytes\": %u, \"selftest_us\": %u}",
+            (i > 0) ? "," : "", res[i].mode, res[i].pr ? "true" : "false",
+            res[i].threads, res[i].size, res[i].failed ? "false" : "true",
+            res[i].ops, res[i].bps, res[i].inst, res[i].reseed,
+            res[i].reseeds, res[i].bytes, res[i].test_us);
+  }
+  fprintf(fp, "\n  ]\n}\n");
+  fclose(fp);
+  printf("Wrote %s\n", out);
+  free(res);
+  ICC_Cleanup(ICC_ctx, status);
+  return 0;
+}
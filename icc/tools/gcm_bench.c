@@ -0,0 +1,300 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description:
+//           AES-GCM per record latency via the public API.
+//           One context, one key, a new IV per record as TLS does.
+//           For each record size and method reports ns per record
+//           and MB/s.
+//           steps - AES_GCM_Init (IV) + EncryptUpdate (AAD)
+//                   + EncryptUpdate (data) + EncryptFinal
+//           seal  - AES_GCM_Seal
+//           open  - AES_GCM_Open, of records sealed beforehand
+//           batch - AES_GCM_SealBatch, BATCH records per call
+//
+//           gcm_bench pathToICC [-n records] [-k 16|24|32]
+//                     [-s 16,64,...] [-o results.json]
+//
+*************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "icc.h"
+#include "bench_clock.h"
+
+#define MAX_SIZES 16
+#define AADLEN 13     /* TLS 1.2 record AAD */
+#define NMETHODS 4
+#define BATCH 32     /* records per AES_GCM_SealBatch() call */
+
+static int dsizes[] = {16, 64, 256, 512, 1024, 16384};
+#define NDSIZES (int)(sizeof(dsizes) / sizeof(dsizes[0]))
+
+static const char *methods[NMETHODS] = {"steps", "seal", "open", "batch"};
+
+static ICC_CTX *ICC_ctx = NULL;
+
+typedef struct {
+  int size;
+  double ns[NMETHODS];  /* ns per record, < 0 on failure */
+} RESULT;
+
+/*!
+  @brief step the IV, the low 8 bytes are a big endian counter
+*/
+static void next_iv(unsigned char iv[12])
+{
+  int i;
+  for (i = 11; i >= 4; i--) {
+    if (0 != ++iv[i]) {
+      break;
+    }
+  }
+}
+
+/*!
+  @brief time n records of size bytes with one method
+  @return ns per record, -1.0 on failure
+*/
+static double bench(int method, unsigned char *key, int klen, int size,
+                    int n, unsigned char *in, unsigned char *out)
+{
+  ICC_AES_GCM_CTX *gcm_ctx = NULL;
+  unsigned char aad[AADLEN];
+  unsigned char iv[12];
+  unsigned char ivs[2][12];
+  unsigned char tag[16];
+  unsigned char tags[2][16];
+  ICC_AES_GCM_REC recs[BATCH];
+  unsigned char bivs[BATCH][12];
+  unsigned char btags[BATCH][16];
+  unsigned long outl = 0;
+  double t0, t = -1.0;
+  int ok = 1;
+  int i, j;
+
+  memset(aad, 0x17, sizeof(aad));
+  memset(iv, 0, sizeof(iv));
+  gcm_ctx = ICC_AES_GCM_CTX_new(ICC_ctx);
+  if (NULL == gcm_ctx) {
+    return -1.0;
+  }
+  ICC_AES_GCM_Init(ICC_ctx, gcm_ctx, NULL, 0, key, klen);
+  if (2 == method) {
+    /* A sender, to give us two records to open. The IV check only
+       refuses a repeat of the previous IV, so we can alternate */
+    ICC_AES_GCM_CTX *snd = ICC_AES_GCM_CTX_new(ICC_ctx);
+    ok = 0;
+    if (NULL != snd) {
+      ICC_AES_GCM_Init(ICC_ctx, snd, NULL, 0, key, klen);
+      ok = 1;
+      for (i = 0; ok && (i < 2); i++) {
+        next_iv(iv);
+        memcpy(ivs[i], iv, sizeof(iv));
+        ok = (1 == ICC_AES_GCM_Seal(ICC_ctx, snd, iv, sizeof(iv), aad, AADLEN,
+                                    in, size, out + i * (size + 16), tags[i], 16));
+      }
+      ICC_AES_GCM_CTX_free(ICC_ctx, snd);
+    }
+  }
+  t0 = now_ns();
+  for (i = 0; ok && (i < n); i++) {
+    switch (method) {
+    case 0:
+      next_iv(iv);
+      ok = (1 == ICC_AES_GCM_Init(ICC_ctx, gcm_ctx, iv, sizeof(iv), NULL, 0)) &&
+           (1 == ICC_AES_GCM_EncryptUpdate(ICC_ctx, gcm_ctx, aad, AADLEN, NULL, 0, NULL, &outl)) &&
+           (1 == ICC_AES_GCM_EncryptUpdate(ICC_ctx, gcm_ctx, NULL, 0, in, size, out, &outl));
+      if (ok) {
+        outl = 0;
+        ok = (1 == ICC_AES_GCM_EncryptFinal(ICC_ctx, gcm_ctx, out + size, &outl, tag));
+      }
+      break;
+    case 3:
+      /* Whole batches, n rounded up */
+      for (j = 0; j < BATCH; j++) {
+        next_iv(iv);
+        memcpy(bivs[j], iv, sizeof(iv));
+        recs[j].iv = bivs[j];
+        recs[j].ivlen = sizeof(iv);
+        recs[j].aad = aad;
+        recs[j].aadlen = AADLEN;
+        recs[j].in = in;
+        recs[j].out = out;
+        recs[j].inlen = size;
+        recs[j].tag = btags[j];
+        recs[j].taglen = 16;
+      }
+      ok = (1 == ICC_AES_GCM_SealBatch(ICC_ctx, gcm_ctx, recs, BATCH));
+      i += BATCH - 1;
+      break;
+    case 1:
+      next_iv(iv);
+      ok = (1 == ICC_AES_GCM_Seal(ICC_ctx, gcm_ctx, iv, sizeof(iv), aad, AADLEN,
+                                  in, size, out, tag, 16));
+      break;
+    default:
+      ok = (1 == ICC_AES_GCM_Open(ICC_ctx, gcm_ctx, ivs[i & 1], sizeof(iv), aad, AADLEN,
+                                  out + (i & 1) * (size + 16), size, in + size,
+                                  tags[i & 1], 16));
+      break;
+    }
+  }
+  if (ok) {
+    t = (now_ns() - t0) / (double)i;
+  }
+  if (NULL != gcm_ctx) {
+    ICC_AES_GCM_CTX_free(ICC_ctx, gcm_ctx);
+  }
+  return t;
+}
+
+static void usage(const char *me)
+{
+  fprintf(stderr, "Usage: %s pathToICC [-n records] [-k 16|24|32] [-s 16,64,...] [-o results.json]\n", me);
+  fprintf(stderr, "       pathToICC is the path to the ICC libraries passed to ICC_Init()\n");
+  fprintf(stderr, "       -n records timed per size and method (default 100000)\n");
+  fprintf(stderr, "       -k key length (default 16)\n");
+  fprintf(stderr, "       -s record sizes (default 16 to 16384)\n");
+  fprintf(stderr, "       -o JSON output file (default gcm_bench.json)\n");
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  ICC_STATUS stat, *status = &stat;
+  char *path = NULL;
+  int slist[MAX_SIZES];
+  int ns = 0;
+  int n = 100000;
+  int klen = 16;
+  const char *out = "gcm_bench.json";
+  RESULT res[MAX_SIZES];
+  unsigned char key[32];
+  unsigned char *in = NULL;
+  unsigned char *ct = NULL;
+  int maxsize = 0;
+  FILE *fp = NULL;
+  char *p = NULL;
+  int i, m, v;
+
+  if (argc < 2) {
+    usage(argv[0]);
+  }
+  path = argv[1];
+  for (i = 2; i < argc; i++) {
+    if ((0 == strcmp(argv[i], "-n")) && (i + 1 < argc)) {
+      n = atoi(argv[++i]);
+    } else if ((0 == strcmp(argv[i], "-k")) && (i + 1 < argc)) {
+      klen = atoi(argv[++i]);
+    } else if ((0 == strcmp(argv[i], "-s")) && (i + 1 < argc)) {
+      for (p = strtok(argv[++i], ","); (NULL != p) && (ns < MAX_SIZES); p = strtok(NULL, ",")) {
+        v = atoi(p);
+        if ((v > 0) && (v <= 1024 * 1024)) {
+          slist[ns++] = v;
+        }
+      }
+    } else if ((0 == strcmp(argv[i], "-o")) && (i + 1 < argc)) {
+      out = argv[++i];
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if ((n <= 0) || ((16 != klen) && (24 != klen) && (32 != klen))) {
+    usage(argv[0]);
+  }
+  if (0 == ns) {
+    for (ns = 0; ns < NDSIZES; ns++) {
+      slist[ns] = dsizes[ns];
+    }
+  }
+  for (i = 0; i < ns; i++) {
+    if (slist[i] > maxsize) {
+      maxsize = slist[i];
+    }
+  }
+
+  memset(status, 0, sizeof(ICC_STATUS));
+  ICC_ctx = ICC_Init(status, path);
+  if (NULL == ICC_ctx) {
+    fprintf(stderr, "Could not initialize ICC [%s], exiting\n", status->desc);
+    exit(1);
+  }
+  if (ICC_ERROR == ICC_Attach(ICC_ctx, status)) {
+    fprintf(stderr, "Could not initialize ICC [%s], exiting\n", status->desc);
+    ICC_Cleanup(ICC_ctx, status);
+    exit(1);
+  }
+  /* Room for the plaintext and, for open, the recovered plaintext,
+     and two records of ciphertext */
+  in = (unsigned char *)malloc(2 * maxsize + 16);
+  ct = (unsigned char *)malloc(2 * (maxsize + 16));
+  if ((NULL == in) || (NULL == ct)) {
+    fprintf(stderr, "Out of memory\n");
+    ICC_Cleanup(ICC_ctx, status);
+    exit(1);
+  }
+  memset(in, 0x5a, 2 * maxsize + 16);
+  for (i = 0; i < (int)sizeof(key); i++) {
+    key[i] = (unsigned char)(i * 13 + 1);
+  }
+
+  printf("AES-%d-GCM, %d byte AAD\n", klen * 8, AADLEN);
+  printf("%8s", "size");
+  for (m = 0; m < NMETHODS; m++) {
+    printf(" %10s %9s", methods[m], "MB/s");
+  }
+  printf("\n");
+  for (i = 0; i < ns; i++) {
+    res[i].size = slist[i];
+    printf("%8d", slist[i]);
+    for (m = 0; m < NMETHODS; m++) {
+      res[i].ns[m] = bench(m, key, klen, slist[i], n, in, ct);
+      if (res[i].ns[m] < 0.0) {
+        printf(" %10s %9s", "FAILED", "");
+      } else {
+        printf(" %10.1f %9.1f", res[i].ns[m],
+               (double)slist[i] * 1e3 / res[i].ns[m]);
+      }
+    }
+    printf("\n");
+  }
+
+  fp = fopen(out, "w");
+  if (NULL == fp) {
+    fprintf(stderr, "Could not open %s\n", out);
+  } else {
+    fprintf(fp, "{\n  \"key_bits\": %d,\n  \"aad_bytes\": %d,\n  \"records\": %d,\n  \"results\": [",
+            klen * 8, AADLEN, n);
+    for (i = 0; i < ns; i++) {
+      for (m = 0; m < NMETHODS; m++) {
+        fprintf(fp, "%s\n    {\"method\": \"%s\", \"bytes\": %d, \"ok\": %s, \"ns_per_record\": %.1f}",
+                ((i > 0) || (m > 0)) ? "," : "", methods[m], res[i].size,
+                (res[i].ns[m] < 0.0) ? "false" : "true",
+                (res[i].ns[m] < 0.0) ? 0.0 : res[i].ns[m]);
+      }
+    }
+    fprintf(fp, "\n  ]\n}\n");
+    fclose(fp);
+    printf("Wrote %s\n", out);
+  }
+  free(in);
+  free(ct);
+  ICC_Cleanup(ICC_ctx, status);
+  return 0;
+}
@@ -0,0 +1,206 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description:
+//           GHASH throughput via the public API, ICC_GHASH().
+//           For each data size, times chained calls with the key
+//           cached in an AES_GCM context, and calls with no context
+//           which expand the key every time.
+//           Reports GB/s and ns per call, and the implementation
+//           in use (AES_GCM_CTRL_GHASH_IMPL). ICC_CAP_MASK can be
+//           used to compare implementations on one machine.
+//
+//           ghash_bench pathToICC [-n ms] [-s 16,64,...] [-o results.json]
+//
+*************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "icc.h"
+#include "bench_clock.h"
+
+#define MAX_SIZES 16
+
+static int dsizes[] = {16, 64, 256, 1024, 4096, 16384, 65536};
+#define NDSIZES (int)(sizeof(dsizes) / sizeof(dsizes[0]))
+
+static const char *impls[] = {"4 bit table", "PCLMULQDQ", "VPCLMULQDQ", "PMULL"};
+
+static ICC_CTX *ICC_ctx = NULL;
+
+typedef struct {
+  int size;
+  double gbs;     /* GB/s, key cached */
+  double ns;      /* ns per call, key cached */
+  double gbs_nc;  /* GB/s, no context */
+  double ns_nc;   /* ns per call, no context */
+} RESULT;
+
+/*!
+  @brief call ICC_GHASH() for at least ms milliseconds
+  @return ns per call
+*/
+static double bench(ICC_AES_GCM_CTX *gcm_ctx, unsigned char *H,
+                    unsigned char *buf, int size, int ms)
+{
+  unsigned char Y[16];
+  double t0, t;
+  long calls = 0;
+  int i;
+
+  memset(Y, 0, sizeof(Y));
+  /* Warm up, and allocate/expand the cached key */
+  ICC_GHASH(ICC_ctx, gcm_ctx, H, Y, buf, size);
+  t0 = now_ns();
+  do {
+    for (i = 0; i < 64; i++) {
+      ICC_GHASH(ICC_ctx, gcm_ctx, H, Y, buf, size);
+    }
+    calls += 64;
+    t = now_ns() - t0;
+  } while (t < (double)ms * 1e6);
+  return t / (double)calls;
+}
+
+static void usage(const char *me)
+{
+  fprintf(stderr, "Usage: %s pathToICC [-n ms] [-s 16,64,...] [-o results.json]\n", me);
+  fprintf(stderr, "       pathToICC is the path to the ICC libraries passed to ICC_Init()\n");
+  fprintf(stderr, "       -n milliseconds timed per size (default 500)\n");
+  fprintf(stderr, "       -s data sizes (default 16 to 65536)\n");
+  fprintf(stderr, "       -o JSON output file (default ghash_bench.json)\n");
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  ICC_STATUS stat, *status = &stat;
+  ICC_AES_GCM_CTX *gcm_ctx = NULL;
+  char *path = NULL;
+  int slist[MAX_SIZES];
+  int ns = 0;
+  int ms = 500;
+  const char *out = "ghash_bench.json";
+  RESULT res[MAX_SIZES];
+  unsigned char H[16];
+  unsigned char *buf = NULL;
+  int maxsize = 0;
+  int impl = 0;
+  FILE *fp = NULL;
+  char *p = NULL;
+  int i, v;
+
+  if (argc < 2) {
+    usage(argv[0]);
+  }
+  path = argv[1];
+  for (i = 2; i < argc; i++) {
+    if ((0 == strcmp(argv[i], "-n")) && (i + 1 < argc)) {
+      ms = atoi(argv[++i]);
+    } else if ((0 == strcmp(argv[i], "-s")) && (i + 1 < argc)) {
+      for (p = strtok(argv[++i], ","); (NULL != p) && (ns < MAX_SIZES); p = strtok(NULL, ",")) {
+        v = atoi(p);
+        if ((v > 0) && (v <= 16 * 1024 * 1024)) {
+          slist[ns++] = v;
+        }
+      }
+    } else if ((0 == strcmp(argv[i], "-o")) && (i + 1 < argc)) {
+      out = argv[++i];
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (ms <= 0) {
+    usage(argv[0]);
+  }
+  if (0 == ns) {
+    for (ns = 0; ns < NDSIZES; ns++) {
+      slist[ns] = dsizes[ns];
+    }
+  }
+  for (i = 0; i < ns; i++) {
+    if (slist[i] > maxsize) {
+      maxsize = slist[i];
+    }
+  }
+
+  memset(status, 0, sizeof(ICC_STATUS));
+  ICC_ctx = ICC_Init(status, path);
+  if (NULL == ICC_ctx) {
+    fprintf(stderr, "Could not initialize ICC [%s], exiting\n", status->desc);
+    exit(1);
+  }
+  ICC_SetValue(ICC_ctx, status, ICC_FIPS_APPROVED_MODE, "off");
+  if (ICC_ERROR == ICC_Attach(ICC_ctx, status)) {
+    fprintf(stderr, "Could not initialize ICC [%s], exiting\n", status->desc);
+    ICC_Cleanup(ICC_ctx, status);
+    exit(1);
+  }
+  gcm_ctx = ICC_AES_GCM_CTX_new(ICC_ctx);
+  buf = (unsigned char *)malloc(maxsize);
+  if ((NULL == gcm_ctx) || (NULL == buf)) {
+    fprintf(stderr, "Out of memory\n");
+    ICC_Cleanup(ICC_ctx, status);
+    exit(1);
+  }
+  for (i = 0; i < maxsize; i++) {
+    buf[i] = (unsigned char)(i * 7 + 3);
+  }
+  for (i = 0; i < (int)sizeof(H); i++) {
+    H[i] = (unsigned char)(0xa5 ^ (i * 29));
+  }
+  ICC_AES_GCM_CTX_ctrl(ICC_ctx, gcm_ctx, ICC_AES_GCM_CTRL_GHASH_IMPL, 0, &impl);
+  printf("GHASH implementation: %s%s%s\n",
+         ((impl >= 0) && (impl < 4)) ? impls[impl] : "unknown",
+         (NULL != getenv("ICC_CAP_MASK")) ? ", ICC_CAP_MASK=" : "",
+         (NULL != getenv("ICC_CAP_MASK")) ? getenv("ICC_CAP_MASK") : "");
+
+  printf("%8s %10s %10s %12s %12s\n", "size", "GB/s", "ns/call", "GB/s noctx",
+         "ns/call");
+  for (i = 0; i < ns; i++) {
+    res[i].size = slist[i];
+    res[i].ns = bench(gcm_ctx, H, buf, slist[i], ms);
+    res[i].ns_nc = bench(NULL, H, buf, slist[i], ms);
+    res[i].gbs = (double)slist[i] / res[i].ns;
+    res[i].gbs_nc = (double)slist[i] / res[i].ns_nc;
+    printf("%8d %10.3f %10.1f %12.3f %12.1f\n", res[i].size, res[i].gbs,
+           res[i].ns, res[i].gbs_nc, res[i].ns_nc);
+  }
+
+  fp = fopen(out, "w");
+  if (NULL == fp) {
+    fprintf(stderr, "Could not open %s\n", out);
+  } else {
+    fprintf(fp, "{\n  \"implementation\": \"%s\",\n  \"results\": [",
+            ((impl >= 0) && (impl < 4)) ? impls[impl] : "unknown");
+    for (i = 0; i < ns; i++) {
+      fprintf(fp,
+              "%s\n    {\"bytes\": %d, \"gb_per_sec\": %.3f, \"ns_per_call\": %.1f, "
+              "\"nokey_gb_per_sec\": %.3f, \"nokey_ns_per_call\": %.1f}",
+              (i > 0) ? "," : "", res[i].size, res[i].gbs, res[i].ns,
+              res[i].gbs_nc, res[i].ns_nc);
+    }
+    fprintf(fp, "\n  ]\n}\n");
+    fclose(fp);
+    printf("Wrote %s\n", out);
+  }
+  free(buf);
+  ICC_AES_GCM_CTX_free(ICC_ctx, gcm_ctx);
+  ICC_Cleanup(ICC_ctx, status);
+  return 0;
+}
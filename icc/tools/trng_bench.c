@@ -0,0 +1,303 @@
+/*************************************************************************
+// Copyright IBM Corp. 2023
+//
+// Licensed under the Apache License 2.0 (the "License").  You may not use
+// this file except in compliance with the License.  You can obtain a copy
+// in the file LICENSE in the source distribution.
+*************************************************************************/
+
+/*************************************************************************
+// Description:
+//           End to end TRNG seed throughput. For each TRNG type,
+//           thread count and seed size, every thread runs it's own
+//           TRNG instance through TRNG_GenerateRandomSeed() as ICC
+//           does when seeding a DRBG.
+//           Reports bytes/s, p50/p99 latency per seed, health test
+//           retries and the long term entropy estimate, to stdout
+//           and as JSON. Used to size ICC_RNG_INSTANCES per host class.
+//
+//           trng_bench [-n seeds] [-t 1,2,4,8] [-T TRNG_OS,...]
+//                      [-s samplers] [-o results.json]
+//
+*************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "platform.h"
+#include "TRNG/ICC_NRBG.h"
+#include "TRNG/entropy_to_NRBGi.h"
+#include "bench_clock.h"
+
+#if defined(_WIN32)
+#define strcasecmp(x,y) _stricmp(x,y)
+#else
+#include <time.h>
+#endif
+
+extern int TRNG_count(void);
+
+#define MAX_THREADS 64
+#define MAX_TYPES 8
+
+static const int sizes[] = {32, 64, 512}; /* Seed sizes we time */
+#define NSIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+typedef struct {
+  TRNG_TYPE type;
+  int size;
+  int n;
+  double *lat;          /* ns per seed */
+  unsigned int htretry; /* Noise blocks dropped by the health tests */
+  unsigned int cretry;  /* Conditioned blocks regenerated */
+  int entropy;          /* Long term estimate at the end, % */
+  int ok;
+} JOB;
+
+typedef struct {
+  const char *name;
+  int threads;
+  int size;
+  double bps;
+  double p50;
+  double p99;
+  unsigned long htretry;
+  unsigned long cretry;
+  int emin;
+  int failed;
+} RESULT;
+
+#if defined(_WIN32)
+static DWORD WINAPI worker(LPVOID arg)
+#else
+static void *worker(void *arg)
+#endif
+{
+  JOB *job = (JOB *)arg;
+  TRNG *T = NULL;
+  unsigned char buf[512];
+  double t0;
+  int i;
+
+  T = TRNG_new(job->type);
+  if (NULL != T) {
+    /* Instantiation cost isn't what we are measuring */
+    if (TRNG_OK == TRNG_GenerateRandomSeed(T, job->size, buf)) {
+      job->ok = 1;
+      for (i = 0; (i < job->n) && job->ok; i++) {
+        t0 = now_ns();
+        if (TRNG_OK != TRNG_GenerateRandomSeed(T, job->size, buf)) {
+          job->ok = 0;
+        }
+        job->lat[i] = now_ns() - t0;
+      }
+    }
+    job->htretry = T->econd.htretry;
+    job->cretry = T->cretry;
+    job->entropy = GetEntropy(T);
+    TRNG_free(T);
+  }
+  memset(buf, 0, sizeof(buf));
+#if defined(_WIN32)
+  return 0;
+#else
+  return NULL;
+#endif
+}
+
+static int cmpd(const void *a, const void *b)
+{
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static void run(TRNG_TYPE type, int threads, int size, int n, RESULT *r)
+{
+  JOB job[MAX_THREADS];
+#if defined(_WIN32)
+  HANDLE tid[MAX_THREADS];
+#else
+  pthread_t tid[MAX_THREADS];
+#endif
+  double *all = NULL;
+  double t0, t1;
+  int i, k = 0;
+
+  memset(r, 0, sizeof(RESULT));
+  r->name = GetTRNGNameR(type);
+  r->threads = threads;
+  r->size = size;
+  r->emin = 100;
+  all = (double *)calloc((size_t)threads * n, sizeof(double));
+  for (i = 0; i < threads; i++) {
+    memset(&job[i], 0, sizeof(JOB));
+    job[i].type = type;
+    job[i].size = size;
+    job[i].n = n;
+    job[i].lat = all + (size_t)i * n;
+  }
+  t0 = now_ns();
+  for (i = 0; i < threads; i++) {
+#if defined(_WIN32)
+    tid[i] = CreateThread(NULL, 0, worker, &job[i], 0, NULL);
+#else
+    pthread_create(&tid[i], NULL, worker, &job[i]);
+#endif
+  }
+  for (i = 0; i < threads; i++) {
+#if defined(_WIN32)
+    WaitForSingleObject(tid[i], INFINITE);
+    CloseHandle(tid[i]);
+#else
+    pthread_join(tid[i], NULL);
+#endif
+  }
+  t1 = now_ns();
+  for (i = 0; i < threads; i++) {
+    if (!job[i].ok) {
+      r->failed++;
+    } else {
+      k++;
+    }
+    r->htretry += job[i].htretry;
+    r->cretry += job[i].cretry;
+    if (job[i].entropy < r->emin) {
+      r->emin = job[i].entropy;
+    }
+  }
+  if (0 == r->failed) {
+    qsort(all, (size_t)threads * n, sizeof(double), cmpd);
+    r->p50 = all[((size_t)threads * n) / 2];
+    r->p99 = all[((size_t)threads * n * 99) / 100];
+    r->bps = ((double)k * n * size) / ((t1 - t0) / 1e9);
+  }
+  free(all);
+}
+
+static void usage(const char *me)
+{
+  fprintf(stderr, "Usage: %s [-n seeds] [-t 1,2,4,8] [-T TRNG_OS,TRNG_FIPS,...] [-s samplers] [-o results.json]\n", me);
+  fprintf(stderr, "       -n seeds timed per thread (default 200)\n");
+  fprintf(stderr, "       -t thread counts (default 1,2,4)\n");
+  fprintf(stderr, "       -T TRNG types (default all available)\n");
+  fprintf(stderr, "       -s TRNG_FIPS noise samplers per instance (ICC_TRNG_SAMPLERS)\n");
+  fprintf(stderr, "       -o JSON output file (default trng_bench.json)\n");
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  int tlist[MAX_THREADS];
+  int nt = 0;
+  TRNG_TYPE types[MAX_TYPES];
+  int ntypes = 0;
+  int n = 200;
+  const char *out = "trng_bench.json";
+  RESULT *res = NULL;
+  int nres = 0;
+  FILE *fp = NULL;
+  char *p = NULL;
+  TRNG *T = NULL;
+  int i, j, s, t;
+
+  for (i = 1; i < argc; i++) {
+    if ((0 == strcmp(argv[i], "-n")) && (i + 1 < argc)) {
+      n = atoi(argv[++i]);
+    } else if ((0 == strcmp(argv[i], "-t")) && (i + 1 < argc)) {
+      for (p = strtok(argv[++i], ","); (NULL != p) && (nt < MAX_THREADS); p = strtok(NULL, ",")) {
+        t = atoi(p);
+        if ((t > 0) && (t <= MAX_THREADS)) {
+          tlist[nt++] = t;
+        }
+      }
+    } else if ((0 == strcmp(argv[i], "-T")) && (i + 1 < argc)) {
+      for (p = strtok(argv[++i], ","); (NULL != p) && (ntypes < MAX_TYPES); p = strtok(NULL, ",")) {
+        for (j = 0; j < TRNG_count(); j++) {
+          if (0 == strcasecmp(p, GetTRNGNameR((TRNG_TYPE)j))) {
+            types[ntypes++] = (TRNG_TYPE)j;
+            break;
+          }
+        }
+        if (j == TRNG_count()) {
+          fprintf(stderr, "Unknown TRNG type %s\n", p);
+          usage(argv[0]);
+        }
+      }
+    } else if ((0 == strcmp(argv[i], "-s")) && (i + 1 < argc)) {
+      if (!SetTRNGSamplers(atoi(argv[++i]))) {
+        usage(argv[0]);
+      }
+    } else if ((0 == strcmp(argv[i], "-o")) && (i + 1 < argc)) {
+      out = argv[++i];
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (n <= 0) {
+    usage(argv[0]);
+  }
+  if (0 == nt) {
+    tlist[nt++] = 1;
+    tlist[nt++] = 2;
+    tlist[nt++] = 4;
+  }
+  if (0 == ntypes) {
+    for (j = 0; (j < TRNG_count()) && (ntypes < MAX_TYPES); j++) {
+      types[ntypes++] = (TRNG_TYPE)j;
+    }
+  }
+  res = (RESULT *)calloc((size_t)ntypes * nt * NSIZES, sizeof(RESULT));
+  if (NULL == res) {
+    return 1;
+  }
+  printf("%-10s %4s %5s %12s %12s %12s %8s %8s %5s\n", "TRNG", "thr", "size",
+         "bytes/s", "p50 ns", "p99 ns", "htretry", "cretry", "ent%");
+  for (i = 0; i < ntypes; i++) {
+    /* Skip sources this machine doesn't have, i.e. TRNG_HW */
+    T = TRNG_new(types[i]);
+    if (NULL == T) {
+      printf("%-10s not available\n", GetTRNGNameR(types[i]));
+      continue;
+    }
+    TRNG_free(T);
+    for (t = 0; t < nt; t++) {
+      for (s = 0; s < (int)NSIZES; s++) {
+        RESULT *r = &res[nres++];
+        run(types[i], tlist[t], sizes[s], n, r);
+        if (r->failed) {
+          printf("%-10s %4d %5d FAILED in %d thread(s)\n", r->name, r->threads,
+                 r->size, r->failed);
+        } else {
+          printf("%-10s %4d %5d %12.0f %12.0f %12.0f %8lu %8lu %5d\n", r->name,
+                 r->threads, r->size, r->bps, r->p50, r->p99, r->htretry,
+                 r->cretry, r->emin);
+        }
+      }
+    }
+  }
+
+  fp = fopen(out, "w");
+  if (NULL == fp) {
+    fprintf(stderr, "Could not open %s\n", out);
+    return 1;
+  }
+  fprintf(fp, "{\n  \"seeds_per_thread\": %d,\n  \"trng_samplers\": %d,\n  \"results\": [", n,
+          GetTRNGSamplers());
+  for (i = 0; i < nres; i++) {
+    fprintf(fp,
+            "%s\n    {\"trng\": \"%s\", \"threads\": %d, \"seed_bytes\": %d, "
+            "\"ok\": %s, \"bytes_per_sec\": %.0f, \"p50_ns\": %.0f, \"p99_ns\": %.0f, "
+            "\"health_retries\": %lu, \"conditioner_retries\": %lu, \"entropy_pct\": %d}",
+            (i > 0) ? "," : "", res[i].name, res[i].threads, res[i].size,
+            res[i].failed ? "false" : "true", res[i].bps, res[i].p50, res[i].p99,
+            res[i].htretry, res[i].cretry, res[i].emin);
+  }
+  fprintf(fp, "\n  ]\n}\n");
+  fclose(fp);
+  printf("Wrote %s\n", out);
+  free(res);
+  return 0;
+}